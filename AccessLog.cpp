@@ -0,0 +1,354 @@
+#include "AccessLog.h"
+#include "Logger.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <charconv>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+
+static_assert(sizeof(AccessRecord) == 256, "access records are meant to fill four cache lines");
+
+// Only the owning thread writes these, so a plain load and store replaces a locked read-modify-write
+static void add(std::atomic<uint64_t>& value, uint64_t amount) {
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+// Function to copy as much of text as fits into a record field
+template <size_t N>
+static size_t copyField(char (&field)[N], std::string_view text) {
+    size_t length = std::min(text.size(), N);
+    std::memcpy(field, text.data(), length);
+    return length;
+}
+
+static int32_t clampMs(long milliseconds) {
+    return static_cast<int32_t>(std::clamp<long>(milliseconds, INT32_MIN, INT32_MAX));
+}
+
+AccessLog::AccessLog()
+    : running(false),
+      fd(-1),
+      fileBytes(0),
+      stopping(false),
+      written(0),
+      writeErrors(0) {}
+
+AccessLog::~AccessLog() {
+    running.store(false, std::memory_order_relaxed);
+    if (writer.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(writerMutex);
+            stopping = true;
+        }
+        writerWake.notify_one();
+        writer.join();
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool AccessLog::start(const AccessLogConfig& newConfig) {
+    if (writer.joinable()) {
+        return false;
+    }
+    config = newConfig;
+    config.ringRecords = std::bit_ceil(std::max<size_t>(config.ringRecords, 2));
+    config.sampleEvery = std::max(config.sampleEvery, 1u);
+    if (!openFile()) {
+        return false;
+    }
+    running.store(true, std::memory_order_release);
+    writer = std::thread([this]() { runWriter(); });
+    return true;
+}
+
+// Function to find the ring of the calling thread, adding it on first use.
+// There is one access log per process, so the thread_local needs no owner.
+AccessLog::Ring& AccessLog::localRing() {
+    thread_local Ring* ring = nullptr;
+    if (ring == nullptr) {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        rings.push_back(std::make_unique<Ring>(config.ringRecords));
+        ring = rings.back().get();
+    }
+    return *ring;
+}
+
+// Function to take the calling thread's next free slot; null when the record
+// is sampled out or the ring is full. publish() hands the filled slot on.
+AccessRecord* AccessLog::claim(bool sampled) {
+    if (!running.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    Ring& ring = localRing();
+    if (sampled && config.sampleEvery > 1 && ++ring.sampleCounter % config.sampleEvery != 0) {
+        add(ring.sampledOut, 1);
+        return nullptr;
+    }
+
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) > ring.mask) {
+        add(ring.dropped, 1);
+        return nullptr;
+    }
+    AccessRecord& record = ring.slots[head & ring.mask];
+    record.unixMicros = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    return &record;
+}
+
+void AccessLog::publish() {
+    Ring& ring = localRing();
+    ring.head.store(ring.head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void AccessLog::append(std::string_view client, std::string_view method, std::string_view path, int statusCode,
+                       long waitingTime, long processingTime, long totalTime, std::string_view message) {
+    // Errors are always kept
+    AccessRecord* record = claim(statusCode < 400);
+    if (record == nullptr) {
+        return;
+    }
+    record->kind = AccessRecord::Kind::Request;
+    record->statusCode = statusCode;
+    record->waitingMs = clampMs(waitingTime);
+    record->processingMs = clampMs(processingTime);
+    record->totalMs = clampMs(totalTime);
+    record->clientLength = static_cast<uint8_t>(copyField(record->client, client));
+    record->methodLength = static_cast<uint8_t>(copyField(record->method, method));
+    record->messageLength = static_cast<uint8_t>(copyField(record->message, message));
+    copyField(record->path, path);
+    record->pathLength = static_cast<uint16_t>(std::min<size_t>(path.size(), UINT16_MAX));
+    publish();
+}
+
+void AccessLog::appendConnection(std::string_view client, int requestsServed, long connectionTime) {
+    AccessRecord* record = claim(true);
+    if (record == nullptr) {
+        return;
+    }
+    record->kind = AccessRecord::Kind::Connection;
+    record->statusCode = requestsServed;
+    record->totalMs = clampMs(connectionTime);
+    record->clientLength = static_cast<uint8_t>(copyField(record->client, client));
+    publish();
+}
+
+AccessLogStats AccessLog::stats() const {
+    AccessLogStats stats{written.load(std::memory_order_relaxed), 0, 0, writeErrors.load(std::memory_order_relaxed)};
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    for (const auto& ring : rings) {
+        stats.dropped += ring->dropped.load(std::memory_order_relaxed);
+        stats.sampledOut += ring->sampledOut.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+// Background thread draining the rings every flushInterval, and once more when stopping
+void AccessLog::runWriter() {
+    std::vector<std::string> chunks;
+    std::unique_lock<std::mutex> lock(writerMutex);
+    while (!stopping) {
+        writerWake.wait_for(lock, config.flushInterval);
+        lock.unlock();
+        drain(chunks);
+        lock.lock();
+    }
+    lock.unlock();
+    drain(chunks);
+}
+
+// Function to append a value escaped for a double-quoted field
+static void appendQuoted(std::string& line, std::string_view value) {
+    line.push_back('"');
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            line.push_back('\\');
+            line.push_back(c);
+        } else if (static_cast<unsigned char>(c) < 0x20 || c == 0x7f) {
+            line.push_back('?');
+        } else {
+            line.push_back(c);
+        }
+    }
+    line.push_back('"');
+}
+
+static void appendNumber(std::string& line, int64_t value) {
+    char buffer[24];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    line.append(buffer, result.ptr);
+}
+
+// Function to format one record as a line of key=value fields. The date
+// only changes once a second, so it is kept between records.
+static void formatRecord(std::string& line, const AccessRecord& record, int64_t& cachedSecond, char (&date)[24]) {
+    int64_t second = record.unixMicros / 1000000;
+    if (second != cachedSecond) {
+        time_t seconds = static_cast<time_t>(second);
+        struct tm utc;
+        gmtime_r(&seconds, &utc);
+        strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", &utc);
+        cachedSecond = second;
+    }
+    // Six zero-padded digits of microseconds, filled from the right
+    char micros[7] = {'.', '0', '0', '0', '0', '0', '0'};
+    int64_t fraction = record.unixMicros % 1000000;
+    for (size_t digit = sizeof(micros) - 1; digit > 0 && fraction > 0; --digit, fraction /= 10) {
+        micros[digit] = static_cast<char>('0' + fraction % 10);
+    }
+
+    line.append(date).append(micros, sizeof(micros)).append("Z client=");
+    line.append(record.client, record.clientLength);
+    if (record.kind == AccessRecord::Kind::Connection) {
+        line.append(" connection_closed requests=");
+        appendNumber(line, record.statusCode);
+        line.append(" connection_ms=");
+        appendNumber(line, record.totalMs);
+        line.push_back('\n');
+        return;
+    }
+    line.append(" method=");
+    appendQuoted(line, std::string_view(record.method, record.methodLength));
+    line.append(" path=");
+    appendQuoted(line, std::string_view(record.path, std::min<size_t>(record.pathLength, sizeof(record.path))));
+    if (record.pathLength > sizeof(record.path)) {
+        line.insert(line.size() - 1, "...");
+    }
+    line.append(" status=");
+    appendNumber(line, record.statusCode);
+    line.append(" waiting_ms=");
+    appendNumber(line, record.waitingMs);
+    line.append(" processing_ms=");
+    appendNumber(line, record.processingMs);
+    line.append(" total_ms=");
+    appendNumber(line, record.totalMs);
+    line.append(" result=");
+    appendQuoted(line, std::string_view(record.message, record.messageLength));
+    line.push_back('\n');
+}
+
+// Function to format what every ring holds, one chunk per ring, and write them together
+void AccessLog::drain(std::vector<std::string>& chunks) {
+    drainRings.clear();
+    {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        for (const auto& ring : rings) {
+            drainRings.push_back(ring.get());
+        }
+    }
+    if (chunks.size() < drainRings.size()) {
+        chunks.resize(drainRings.size());
+    }
+
+    int64_t cachedSecond = -1;
+    char date[24] = {};
+    size_t bytes = 0;
+    uint64_t records = 0;
+    for (size_t i = 0; i < drainRings.size(); ++i) {
+        Ring& ring = *drainRings[i];
+        std::string& chunk = chunks[i];
+        chunk.clear();
+        uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+        uint64_t head = ring.head.load(std::memory_order_acquire);
+        for (uint64_t position = tail; position != head; ++position) {
+            formatRecord(chunk, ring.slots[position & ring.mask], cachedSecond, date);
+        }
+        // The slots are formatted, so the thread may reuse them
+        ring.tail.store(head, std::memory_order_release);
+        bytes += chunk.size();
+        records += head - tail;
+    }
+    if (bytes == 0) {
+        return;
+    }
+    writeBatch(chunks, bytes);
+    written.fetch_add(records, std::memory_order_relaxed);
+}
+
+// Function to write the chunks with as few writev() calls as IOV_MAX allows,
+// rotating first when they would take the file past maxFileBytes
+void AccessLog::writeBatch(const std::vector<std::string>& chunks, size_t bytes) {
+    if (fileBytes > 0 && fileBytes + bytes > config.maxFileBytes) {
+        rotate();
+    }
+    if (fd < 0) {
+        writeErrors.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    std::vector<struct iovec>& vectors = drainVectors;
+    vectors.clear();
+    for (const std::string& chunk : chunks) {
+        if (!chunk.empty()) {
+            vectors.push_back({const_cast<char*>(chunk.data()), chunk.size()});
+        }
+    }
+
+    size_t first = 0;
+    while (first < vectors.size()) {
+        int count = static_cast<int>(std::min<size_t>(vectors.size() - first, IOV_MAX));
+        ssize_t wrote = writev(fd, &vectors[first], count);
+        if (wrote < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            writeErrors.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        fileBytes += static_cast<size_t>(wrote);
+
+        // Skip what was written; a short write resumes inside the vector it stopped in
+        size_t left = static_cast<size_t>(wrote);
+        while (first < vectors.size() && left >= vectors[first].iov_len) {
+            left -= vectors[first].iov_len;
+            ++first;
+        }
+        if (left > 0) {
+            vectors[first].iov_base = static_cast<char*>(vectors[first].iov_base) + left;
+            vectors[first].iov_len -= left;
+        }
+    }
+}
+
+bool AccessLog::openFile() {
+    std::error_code error;
+    std::filesystem::path parent = std::filesystem::path(config.path).parent_path();
+    if (!parent.empty()) {
+        std::filesystem::create_directories(parent, error);
+    }
+    fd = open(config.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        logError("Cannot open access log " + config.path, strerror(errno));
+        return false;
+    }
+    struct stat status;
+    fileBytes = fstat(fd, &status) == 0 ? static_cast<size_t>(status.st_size) : 0;
+    return true;
+}
+
+// Function to shift path.1 .. path.(maxFiles - 1) up by one, move the current
+// file to path.1 and start a new one
+void AccessLog::rotate() {
+    close(fd);
+    fd = -1;
+    for (int i = config.maxFiles - 1; i >= 1; --i) {
+        std::string from = config.path + "." + std::to_string(i);
+        std::string to = config.path + "." + std::to_string(i + 1);
+        rename(from.c_str(), to.c_str());
+    }
+    if (config.maxFiles > 0) {
+        std::string first = config.path + ".1";
+        rename(config.path.c_str(), first.c_str());
+    } else {
+        unlink(config.path.c_str());
+    }
+    openFile();
+}
@@ -0,0 +1,115 @@
+#ifndef ACCESS_LOG_H
+#define ACCESS_LOG_H
+
+#include <sys/uio.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+struct AccessLogConfig {
+    std::string path = "logs/access.log";
+    size_t maxFileBytes = 5 * 1024 * 1024;   // rotated past this size, like logs/server.log
+    int maxFiles = 3;                        // rotated files kept besides the current one
+    size_t ringRecords = 4096;               // per thread; rounded up to a power of two
+    unsigned sampleEvery = 1;                // keep one in N successful requests; errors are always kept
+    std::chrono::milliseconds flushInterval{50};
+};
+
+struct AccessLogStats {
+    uint64_t written;
+    uint64_t dropped;       // the thread's ring was full when the request finished
+    uint64_t sampledOut;
+    uint64_t writeErrors;
+};
+
+// One request, or one closed connection, as the thread serving it leaves it:
+// 256 bytes copied in place, so logging allocates nothing. Fields too long
+// for their slot are cut short.
+struct AccessRecord {
+    enum class Kind : uint8_t { Request, Connection };
+
+    int64_t unixMicros;
+    int32_t statusCode;       // Connection: requests served
+    int32_t waitingMs;
+    int32_t processingMs;
+    int32_t totalMs;          // Connection: how long it was open
+    uint16_t pathLength;      // of the original path; more than fits means it was cut
+    Kind kind;
+    uint8_t clientLength;
+    uint8_t methodLength;
+    uint8_t messageLength;
+    char client[40];
+    char method[16];
+    char message[48];
+    char path[122];
+};
+
+// Access log written off the request path. Each thread appends records to a
+// single-producer ring of its own; a background writer drains every ring each
+// flushInterval, formats the records as text and writes the batch with one
+// writev(). A full ring drops the record and counts it rather than block.
+class AccessLog {
+public:
+    AccessLog();
+    ~AccessLog();
+
+    // Open the file and start the writer; requests before this are not logged
+    bool start(const AccessLogConfig& config);
+
+    void append(std::string_view client, std::string_view method, std::string_view path, int statusCode,
+                long waitingTime, long processingTime, long totalTime, std::string_view message);
+    void appendConnection(std::string_view client, int requestsServed, long connectionTime);
+
+    AccessLogStats stats() const;
+
+private:
+    struct Ring {
+        explicit Ring(size_t capacity) : slots(capacity), mask(capacity - 1) {}
+
+        std::vector<AccessRecord> slots;
+        const size_t mask;
+        alignas(64) std::atomic<uint64_t> head{0};   // Written by the owning thread
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<uint64_t> sampledOut{0};
+        uint64_t sampleCounter = 0;
+        alignas(64) std::atomic<uint64_t> tail{0};   // Written by the writer
+    };
+
+    AccessLogConfig config;
+    std::atomic<bool> running;
+    int fd;
+    size_t fileBytes;
+
+    mutable std::mutex ringsMutex;   // Guards the ring list, not the records in it
+    std::vector<std::unique_ptr<Ring>> rings;
+
+    std::mutex writerMutex;
+    std::condition_variable writerWake;
+    bool stopping;
+    std::thread writer;
+
+    // Writer thread only; kept between drains so that draining allocates nothing
+    std::vector<Ring*> drainRings;
+    std::vector<struct iovec> drainVectors;
+
+    std::atomic<uint64_t> written;
+    std::atomic<uint64_t> writeErrors;
+
+    Ring& localRing();
+    AccessRecord* claim(bool sampled);
+    void publish();
+    void runWriter();
+    void drain(std::vector<std::string>& chunks);
+    void writeBatch(const std::vector<std::string>& chunks, size_t bytes);
+    bool openFile();
+    void rotate();
+};
+
+#endif // ACCESS_LOG_H
@@ -0,0 +1,635 @@
+#include "AsyncClient.h"
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+#include "AsyncSocket.h"
+#include "Logger.h"
+#include "RequestArena.h"
+#include "RequestException.h"
+#include "Server.h"
+#include "SpliceRelay.h"
+
+using Clock = std::chrono::high_resolution_clock;
+
+// Function to get the milliseconds elapsed since start
+static long millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+}
+
+// Suspends a miss while another request fetches the same key, until that fetch
+// finishes or coalesceTimeout passes. Resumes immediately, as the leader, when
+// no fetch was in flight; await_resume says which of the two happened.
+struct FetchAwaiter {
+    // Shared with the cache callback and the timer; whichever fires first resumes
+    struct Waiter {
+        std::coroutine_handle<> handle;
+        bool resumed = false;
+
+        void wake() {
+            if (!resumed) {
+                resumed = true;
+                handle.resume();
+            }
+        }
+    };
+
+    EventLoop& loop;
+    std::string_view key;
+    bool leader = false;
+    EventLoop::TimerId timer = 0;
+    std::shared_ptr<Waiter> waiter = std::make_shared<Waiter>();
+
+    bool await_ready() const { return false; }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+        waiter->handle = handle;
+        std::shared_ptr<Waiter> state = waiter;
+        EventLoop* owner = &loop;
+        // finishFetch runs on whichever thread the leader is on; hop back to ours
+        leader = cache.beginFetch(key, [state, owner]() {
+            owner->post([state]() { state->wake(); });
+        });
+        if (leader) {
+            return false;
+        }
+        timer = loop.runAfter(getServerConfig().coalesceTimeout, [state]() { state->wake(); });
+        return true;
+    }
+
+    bool await_resume() {
+        if (timer != 0) {
+            loop.cancelTimer(timer);
+        }
+        return leader;
+    }
+};
+
+// Function to create a non-blocking backend socket for AsyncSocket::connect
+static int createBackendSocket(int family) {
+    int backendSocket = socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (backendSocket < 0) {
+        logError("Failed to create socket for backend", strerror(errno));
+        return -1;
+    }
+
+    // Requests are small and latency-bound; do not wait to coalesce them
+    int opt = 1;
+    setsockopt(backendSocket, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    return backendSocket;
+}
+
+// Function to read until a complete request is buffered (pipelined bytes stay in pending)
+static Async<ReadStatus> readNextRequestAsync(AsyncSocket& client, std::string& pending,
+                                              HttpRequestParser& parser, RequestInfo& reqInfo) {
+    char buffer[4096];
+    while (true) {
+        auto parseStart = MetricsRegistry::Clock::now();
+        auto result = parser.parse(pending, reqInfo);
+        if (result == HttpRequestParser::Result::Complete) {
+            metrics.record(Stage::Parse, parseStart);
+            co_return ReadStatus::Complete;
+        }
+        if (result == HttpRequestParser::Result::Error) {
+            co_return ReadStatus::Malformed;
+        }
+
+        ssize_t bytesReceived = co_await client.read(buffer, sizeof(buffer));
+        if (bytesReceived > 0) {
+            pending.append(buffer, bytesReceived);
+        } else if (bytesReceived == 0) {
+            co_return ReadStatus::Closed;
+        } else {
+            co_return errno == ETIMEDOUT ? ReadStatus::TimedOut : ReadStatus::Error;
+        }
+    }
+}
+
+// Function to forward one response from a backend connection to the client
+// while it arrives; see streamFromBackend for the framing rules. Returns false
+// when the backend failed; the connection must then be discarded.
+static Async<bool> streamFromBackendAsync(AsyncSocket& backend, AsyncSocket& client,
+                                          BackendRelay& relay, bool& reusable, BackendDeadline& deadline) {
+    HttpResponseParser& parser = relay.parser;
+    bool caching = relay.cacheable;
+    std::string outgoing;
+    SpliceRelay splice;
+    char buffer[16384];
+    bool answered = false;
+
+    while (true) {
+        if (!caching && parser.bodyIsOpaque()) {
+            size_t remaining = parser.bodyRemaining();
+            size_t before = remaining;
+            auto status = splice.pump(backend.fd(), client.fd(), remaining);
+            parser.skipBody(before - remaining);
+
+            switch (status) {
+                case SpliceRelay::Status::Done:
+                    reusable = parser.keepAlive();
+                    co_return true;
+                case SpliceRelay::Status::WaitReadable:
+                    backend.setTimeout(deadline.remaining());
+                    if (co_await backend.waitReadable()) {
+                        continue;
+                    }
+                    co_return false;
+                case SpliceRelay::Status::WaitWritable:
+                    if (co_await client.waitWritable()) {
+                        continue;
+                    }
+                    co_return false;
+                case SpliceRelay::Status::Eof:
+                    reusable = false;
+                    co_return parser.finishOnEof() == HttpResponseParser::Result::Complete;
+                default:
+                    perror("[DEBUG] Error relaying backend response");
+                    co_return false;
+            }
+        }
+
+        backend.setTimeout(deadline.remaining());
+        ssize_t bytesReceived = co_await backend.read(buffer, sizeof(buffer));
+        if (bytesReceived > 0) {
+            if (!answered) {
+                answered = true;
+                metrics.record(Stage::BackendFirstByte, deadline.phaseStarted());
+                deadline.startPhase(std::chrono::milliseconds(0));
+            }
+            size_t used = 0;
+            auto result = parser.feed(std::string_view(buffer, bytesReceived), used);
+            if (result == HttpResponseParser::Result::Error) {
+                co_return false;
+            }
+
+            std::string_view bytes(buffer, used);
+            if (caching) {
+                caching = responseFitsCache(parser);
+                if (caching) {
+                    relay.cacheCopy.append(bytes);
+                } else {
+                    std::string().swap(relay.cacheCopy);
+                }
+            }
+
+            outgoing.append(bytes);
+            if (parser.headersComplete()) {
+                if (!co_await client.writeAll(outgoing)) {
+                    relay.status = BackendRelay::Status::Interrupted;
+                    co_return false;
+                }
+                relay.clientStarted = true;
+                outgoing.clear();
+            }
+
+            if (result == HttpResponseParser::Result::Complete) {
+                // Bytes past the framed message mean the backend misbehaved; do not reuse it
+                reusable = parser.keepAlive() && used == static_cast<size_t>(bytesReceived);
+                co_return true;
+            }
+            continue;
+        }
+        if (bytesReceived == 0) {
+            reusable = false;
+            co_return parser.finishOnEof() == HttpResponseParser::Result::Complete;
+        }
+        perror("[DEBUG] Error receiving backend response");
+        co_return false;
+    }
+}
+
+// Function to lease a connection to the chosen backend, connecting within the
+// connect timeout when none is idle, and send it the request. The deadline
+// then moves on to waiting for the first byte of the response.
+static Async<SendStatus> sendOnBackendAsync(EventLoop& loop, const Upstream& upstream, const RequestInfo& request,
+                                            BackendDeadline& deadline, std::unique_ptr<AsyncSocket>& backend,
+                                            bool& reused) {
+    const UpstreamConfig& policy = upstreams.settings();
+
+    // Prefer an idle keep-alive connection over a new handshake
+    int backendSocket = -1;
+    auto acquired = backendPool.acquire(upstream.key, backendSocket);
+    if (acquired == BackendPool::AcquireResult::Exhausted) {
+        co_return SendStatus::Exhausted;
+    }
+
+    reused = acquired == BackendPool::AcquireResult::Reused;
+    SocketAddress backendAddress;
+    if (!reused) {
+        backendSocket = resolveBackendAddress(upstream, backendAddress) ? createBackendSocket(backendAddress.family()) : -1;
+        if (backendSocket < 0) {
+            backendPool.cancel(upstream.key);
+            co_return SendStatus::ConnectFailed;
+        }
+    }
+
+    backend = std::make_unique<AsyncSocket>(loop, backendSocket);
+    if (!reused) {
+        deadline.startPhase(policy.connectTimeout);
+        backend->setTimeout(deadline.remaining());
+        if (!co_await backend->connect(backendAddress)) {
+            perror("[DEBUG] Backend connection failed");
+            backendPool.cancel(upstream.key);
+            backend.reset();
+            co_return SendStatus::ConnectFailed;
+        }
+        backendPool.connected(upstream.key);
+        metrics.record(Stage::BackendConnect, deadline.phaseStarted());
+    }
+
+    deadline.startPhase(policy.firstByteTimeout);
+    backend->setTimeout(deadline.remaining());
+    char scratch[512];   // the request only lives until it is written; the frame holds it
+    std::pmr::monotonic_buffer_resource memory(scratch, sizeof(scratch));
+    std::pmr::string backendRequest = buildBackendRequest(upstream, request, &memory);
+    if (!co_await backend->writeAll(backendRequest)) {
+        backendPool.release(upstream.key, backend->release(), false);
+        backend.reset();
+        co_return SendStatus::SendFailed;
+    }
+    co_return SendStatus::Sent;
+}
+
+// Function to check without waiting whether a socket has bytes, EOF or an error to read
+static bool readableNow(int fd) {
+    char byte;
+    ssize_t rc = recv(fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    return rc >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+}
+
+// Two hedged attempts waiting for their backends to answer. The request
+// resumes once one of them has, or both gave up; when waitAll is set it only
+// resumes once both waits ended, so neither socket is closed under them.
+struct HedgeRace {
+    std::coroutine_handle<> waiter;
+    int winner = -1;
+    int running = 2;
+    bool waitAll = false;
+
+    bool settled() const { return running == 0 || (!waitAll && winner >= 0); }
+
+    void finish(int attempt, bool ready) {
+        --running;
+        if (ready && winner < 0) {
+            winner = attempt;
+        }
+        if (waiter && settled()) {
+            std::exchange(waiter, nullptr).resume();
+        }
+    }
+};
+
+struct RaceAwaiter {
+    HedgeRace& race;
+
+    bool await_ready() const { return race.settled(); }
+    void await_suspend(std::coroutine_handle<> handle) { race.waiter = handle; }
+    void await_resume() const {}
+};
+
+// Function to report to the race once the attempt's backend has answered
+static Async<void> awaitAnswer(AsyncSocket& backend, std::shared_ptr<HedgeRace> race, int attempt) {
+    bool ready = readableNow(backend.fd()) || co_await backend.waitReadable();
+    race->finish(attempt, ready);
+}
+
+// Function to hedge a request whose backend has not started answering within
+// the hedge delay: it is sent to another backend as well, the connection that
+// answers first is kept and the other one shut down and closed
+static Async<void> hedgeIfSlowAsync(EventLoop& loop, UpstreamRequest& upstream, std::unique_ptr<AsyncSocket>& backend,
+                                    bool& reused, const RequestInfo& request, BackendDeadline& deadline) {
+    std::chrono::milliseconds delay = upstreams.hedgeDelay();
+    if (delay.count() == 0 || !methodIsIdempotent(request.method) || readableNow(backend->fd())) {
+        co_return;
+    }
+    std::chrono::milliseconds left = deadline.remaining();
+    if (left.count() > 0 && left <= delay) {
+        co_return;   // the deadline ends first anyway
+    }
+    backend->setTimeout(delay);
+    if (co_await backend->waitReadable() || errno != ETIMEDOUT || !upstreams.allowRetry()) {
+        co_return;
+    }
+
+    UpstreamRequest hedge = upstreams.choose(&*upstream);
+    if (&*hedge == &*upstream) {
+        co_return;   // nowhere else to send it
+    }
+    BackendDeadline hedgeDeadline = deadline;
+    std::unique_ptr<AsyncSocket> hedgeBackend;
+    bool hedgeReused = false;
+    SendStatus sent = co_await sendOnBackendAsync(loop, *hedge, request, hedgeDeadline, hedgeBackend, hedgeReused);
+    if (sent != SendStatus::Sent) {
+        if (sent != SendStatus::Exhausted) {
+            hedge.fail();
+        }
+        co_return;
+    }
+
+    auto race = std::make_shared<HedgeRace>();
+    backend->setTimeout(deadline.remaining());
+    hedgeBackend->setTimeout(hedgeDeadline.remaining());
+    awaitAnswer(*backend, race, 0).detach();
+    awaitAnswer(*hedgeBackend, race, 1).detach();
+    RaceAwaiter firstAnswer{*race};
+    co_await firstAnswer;
+
+    bool hedgeWon = race->winner == 1;
+    if (race->running > 0) {
+        shutdown((hedgeWon ? backend : hedgeBackend)->fd(), SHUT_RDWR);
+        race->waitAll = true;
+        RaceAwaiter bothDone{*race};
+        co_await bothDone;
+    }
+
+    upstreams.countHedge(hedgeWon);
+    if (hedgeWon) {
+        backendPool.release(upstream->key, backend->release(), false);
+        upstream = std::move(hedge);
+        backend = std::move(hedgeBackend);
+        reused = hedgeReused;
+        deadline = hedgeDeadline;
+    } else {
+        backendPool.release(hedge->key, hedgeBackend->release(), false);
+    }
+}
+
+// Function to stream the backend's response for a request straight to the client
+static Async<void> relayFromBackendAsync(AsyncSocket& client, const RequestInfo& request, BackendRelay& relay) {
+    std::string_view method = request.method;
+    EventLoop& loop = client.eventLoop();
+    BackendDeadline deadline(upstreams.settings());
+    UpstreamRequest upstream = upstreams.choose();
+    int retries = 0;
+    SendStatus sent;
+
+    while (true) {
+        std::unique_ptr<AsyncSocket> backend;
+        bool reused = false;
+        relay.parser.reset(method == "HEAD");
+        relay.cacheCopy.clear();
+        sent = co_await sendOnBackendAsync(loop, *upstream, request, deadline, backend, reused);
+        if (sent == SendStatus::Exhausted) {
+            relay.errorStatus = 503;
+            relay.errorMessage = "Backend Connection Limit Reached";
+            co_return;
+        }
+
+        if (sent == SendStatus::Sent) {
+            co_await hedgeIfSlowAsync(loop, upstream, backend, reused, request, deadline);
+            bool reusable = false;
+            if (co_await streamFromBackendAsync(*backend, client, relay, reusable, deadline)) {
+                backendPool.release(upstream->key, backend->release(), reusable);
+                upstream.finish(relay.parser.statusCode());
+                relay.status = BackendRelay::Status::Relayed;
+                co_return;
+            }
+
+            backendPool.release(upstream->key, backend->release(), false);
+            if (relay.clientStarted || relay.status == BackendRelay::Status::Interrupted) {
+                // A client that went away says nothing about the backend
+                if (relay.status != BackendRelay::Status::Interrupted) {
+                    upstream.fail();
+                }
+                relay.status = BackendRelay::Status::Interrupted;
+                co_return;
+            }
+        }
+
+        // The backend may close an idle keep-alive socket just as we reuse it; retry on another one
+        if (reused && relay.parser.messageLength() == 0 && !deadline.expired()) {
+            continue;
+        }
+
+        // Nothing reached the client yet, so another backend may still answer
+        const Upstream* failed = &*upstream;
+        upstream.fail();
+        if (!mayRetryBackend(method, retries, deadline)) {
+            break;
+        }
+        ++retries;
+        upstream = upstreams.choose(failed);
+    }
+
+    if (deadline.expired()) {
+        relay.errorStatus = 504;
+        relay.errorMessage = "Backend Timeout";
+    } else if (sent == SendStatus::ConnectFailed) {
+        relay.errorStatus = 502;
+        relay.errorMessage = "Backend Connection Failed";
+    } else {
+        std::cerr << "[DEBUG] No response from backend." << std::endl;
+        relay.errorStatus = 502;
+        relay.errorMessage = "Invalid Response";
+    }
+}
+
+// Function to serve one buffered request; returns whether the connection may be reused
+static Async<bool> serveRequestAsync(AsyncSocket& client, const struct sockaddr_in& clientAddress,
+                                     const std::string& clientIP, const RequestInfo& reqInfo, RequestArena& arena,
+                                     long waitingTime, Clock::time_point processingTimeStart) {
+    try {
+        // reqInfo views into the connection's buffer, which is untouched until the request is served
+        std::string_view method = reqInfo.method;
+        std::string_view path = reqInfo.path;
+        bool keepAlive = reqInfo.keepAlive;
+        bool headRequest = reqInfo.method == "HEAD";
+
+        // The metrics page is served by the proxy itself, outside the rate limits
+        if (isMetricsRequest(reqInfo)) {
+            std::string metricsResponse = generateMetricsResponse();
+            if (!co_await client.writeAll(metricsResponse)) {
+                throw std::runtime_error("Failed to send metrics");
+            }
+            long processingTime = millisecondsSince(processingTimeStart);
+            logRequest(clientIP, method, path, 200, waitingTime, processingTime,
+                       processingTime + waitingTime, "Served Metrics");
+            co_return keepAlive;
+        }
+
+        // Check if request is in cache to avoid unnecessary backend calls
+        std::pmr::string cacheKey = HttpCache::primaryKey(reqInfo.method, getBackendKey(), reqInfo.path,
+                                                          arena.resource());
+        auto lookupStart = MetricsRegistry::Clock::now();
+        HttpCache::Lookup cached = cache.lookup(reqInfo, cacheKey);
+        metrics.record(Stage::CacheLookup, lookupStart);
+        metrics.count(cached.response ? Counter::CacheHits : Counter::CacheMisses);
+        if (cached.revalidate) {
+            revalidateInBackground(reqInfo, cacheKey);
+        }
+
+        // Rate Limiting: hits and backend fetches draw on separate budgets of the route's policy
+        auto charge = cached.response ? RateLimitPolicies::Charge::CacheHit : RateLimitPolicies::Charge::BackendFetch;
+        if (!rateLimits.allow(rateLimits.match(reqInfo.method, reqInfo.path), charge, clientAddress)) {
+            std::string ratelimitResponse = generateErrorResponse(
+                429,
+                "Too many requests. Please slow down and try again later."
+            );
+            metrics.count(Counter::RateLimited);
+            auto sendStart = MetricsRegistry::Clock::now();
+            bool sent = co_await client.writeAll(ratelimitResponse);
+            metrics.record(Stage::Send, sendStart);
+
+            long processingTime = millisecondsSince(processingTimeStart);
+            logRequest(clientIP, "RATE_LIMITED", "N/A", 429, waitingTime, processingTime,
+                       processingTime + waitingTime, rateLimitMessage(charge));
+
+            // The request was read whole, so the connection stays usable
+            co_return keepAlive && sent;
+        }
+
+        // Concurrent misses for one key share a single backend fetch: the
+        // first one fetches, the rest wait for it and look the key up again
+        FetchGuard fetch{cacheKey, false};
+        if (!cached.response && HttpCache::requestAllowsLookup(reqInfo) && HttpCache::requestAllowsStore(reqInfo)) {
+            // A named awaiter: GCC 12 destroys a temporary co_await operand twice
+            FetchAwaiter waitForFetch{client.eventLoop(), cacheKey};
+            fetch.leader = co_await waitForFetch;
+            if (!fetch.leader) {
+                lookupStart = MetricsRegistry::Clock::now();
+                cached = cache.lookup(reqInfo, cacheKey);
+                metrics.record(Stage::CacheLookup, lookupStart);
+                if (cached.revalidate) {
+                    revalidateInBackground(reqInfo, cacheKey);
+                }
+            }
+        }
+        CachedResponse cachedResponse = std::move(cached.response);
+        if (cachedResponse) {
+            // Cache hit: Send cached response
+            auto sendStart = MetricsRegistry::Clock::now();
+            if (!co_await client.writeAll(*cachedResponse)) {
+                throw std::runtime_error("Failed to send cached response");
+            }
+            metrics.record(Stage::Send, sendStart);
+
+            long processingTime = millisecondsSince(processingTimeStart);
+            logRequest(clientIP, method, path, 200, waitingTime, processingTime,
+                       processingTime + waitingTime, "Served from Cache");
+
+            co_return keepAlive && responseIsSelfDelimited(*cachedResponse, headRequest);
+        }
+
+        // Stream the backend response to the client as it arrives
+        BackendRelay relay;
+        relay.cacheable = HttpCache::requestAllowsStore(reqInfo);
+        auto backendStart = MetricsRegistry::Clock::now();
+        co_await relayFromBackendAsync(client, reqInfo, relay);
+        metrics.record(Stage::BackendTotal, backendStart);
+
+        long processingTime = millisecondsSince(processingTimeStart);
+        if (relay.status == BackendRelay::Status::Failed) {
+            throw RequestException(relay.errorMessage, relay.errorStatus, waitingTime, processingTime);
+        }
+        if (relay.status == BackendRelay::Status::Interrupted) {
+            // Part of the response is already out; the only way to signal the error is to close
+            logRequest(clientIP, method, path, 502, waitingTime, processingTime, processingTime + waitingTime,
+                       "Backend Response Interrupted");
+            co_return false;
+        }
+
+        // Cache the backend response if HTTP allows it and it was small enough to keep
+        if (!relay.cacheCopy.empty()) {
+            cache.store(reqInfo, cacheKey, std::move(relay.cacheCopy));
+        }
+
+        logRequest(clientIP, method, path, relay.parser.statusCode(), waitingTime, processingTime,
+                   processingTime + waitingTime, "Served from Backend");
+
+        // A response delimited by EOF forces the client connection to close as well
+        co_return keepAlive && !relay.parser.delimitedByClose();
+    }
+    catch (const RequestException& e) {
+        // Error pages are small; a best-effort send cannot block the loop
+        std::string errorResponse = generateErrorResponse(e.getStatusCode(), e.what());
+        auto sendStart = MetricsRegistry::Clock::now();
+        send(client.fd(), errorResponse.c_str(), errorResponse.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        metrics.record(Stage::Send, sendStart);
+        logRequest(clientIP, "CLIENT_ERROR", "N/A", e.getStatusCode(), e.getWaitingTime(),
+                   e.getProcessingTime(), e.getTotalTime(), e.what());
+    }
+    catch (const std::exception& e) {
+        std::string errorResponse = generateErrorResponse(500, "Internal Server Error");
+        send(client.fd(), errorResponse.c_str(), errorResponse.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        logRequest(clientIP, "FATAL", "N/A", 500, 0, 0, 0, e.what());
+    }
+
+    // Errors always end the connection
+    co_return false;
+}
+
+// Function to serve one client connection as a coroutine
+Async<void> handleClientAsync(EventLoop& loop, int clientSocket, struct sockaddr_in clientAddress,
+                              Clock::time_point acceptedAt) {
+    const ServerConfig& config = getServerConfig();
+    AsyncSocket client(loop, clientSocket);
+
+    auto waitingTimeFinished = Clock::now();
+    long waitingTime = std::chrono::duration_cast<std::chrono::milliseconds>(waitingTimeFinished - acceptedAt).count();
+    metrics.record(Stage::QueueWait, waitingTimeFinished - acceptedAt);
+    std::string clientIP = getClientIP(clientAddress);
+
+    std::string pending;      // Received bytes not served yet; may hold pipelined requests
+    HttpRequestParser parser;
+    RequestInfo reqInfo;
+    RequestArena arena;       // Scratch memory of the request being served
+    int requestsServed = 0;
+
+    // Serve requests in order on the same socket until the client or a limit closes it
+    while (true) {
+        auto processingTimeStart = Clock::now();
+
+        // Only the wait for a request is bounded, as the blocking model's poll() is
+        client.setTimeout(config.keepAliveTimeout);
+        ReadStatus status = co_await readNextRequestAsync(client, pending, parser, reqInfo);
+        client.setTimeout(std::chrono::milliseconds(0));
+
+        if (status != ReadStatus::Complete) {
+            // An idle keep-alive connection closing between requests is not an error
+            bool betweenRequests = requestsServed > 0 && pending.empty();
+            long processingTime = millisecondsSince(processingTimeStart);
+
+            if (status == ReadStatus::Malformed) {
+                std::string errorResponse = generateErrorResponse(parser.errorStatus(), "Invalid Request Format");
+                co_await client.writeAll(errorResponse);
+                logRequest(clientIP, "CLIENT_ERROR", "N/A", parser.errorStatus(), waitingTime, processingTime,
+                           waitingTime + processingTime, "Invalid Request Format");
+            } else if (status == ReadStatus::Error) {
+                logRequest(clientIP, "ERROR", "N/A", 500, waitingTime, processingTime,
+                           waitingTime + processingTime, "Socket Receive Error");
+                perror("Error receiving client data");
+            } else if (!betweenRequests) {
+                logRequest(clientIP, "DISCONNECT", "N/A", 499, waitingTime, processingTime, waitingTime + processingTime,
+                           status == ReadStatus::TimedOut ? "Client Request Timeout" : "Client Closed Connection");
+            }
+            break;
+        }
+
+        // Pipelined requests are answered one at a time, in the order they arrived
+        if (requestsServed > 0) {
+            processingTimeStart = Clock::now();
+        }
+        bool keepAlive = co_await serveRequestAsync(client, clientAddress, clientIP, reqInfo, arena,
+                                                    waitingTime, processingTimeStart);
+        ++requestsServed;
+
+        // reqInfo views into pending stay valid until the request is consumed here
+        pending.erase(0, reqInfo.length);
+        parser.reset();
+        arena.reset();
+        waitingTime = 0;
+
+        if (!keepAlive || requestsServed >= config.maxKeepAliveRequests) {
+            break;
+        }
+    }
+
+    recordConnection(clientIP, requestsServed, millisecondsSince(waitingTimeFinished));
+}
@@ -0,0 +1,16 @@
+#ifndef ASYNCCLIENT_H
+#define ASYNCCLIENT_H
+
+#include <netinet/in.h>
+#include <chrono>
+#include "Coroutine.h"
+#include "EventLoop.h"
+
+// Serve one client connection as a coroutine on `loop`: the same linear
+// read request -> cache -> backend -> respond sequence as handleClient, but
+// every socket wait suspends the coroutine instead of blocking the thread,
+// so one worker keeps many client and backend exchanges in flight.
+Async<void> handleClientAsync(EventLoop& loop, int clientSocket, struct sockaddr_in clientAddress,
+                              std::chrono::high_resolution_clock::time_point acceptedAt);
+
+#endif // ASYNCCLIENT_H
@@ -0,0 +1,277 @@
+#include "AsyncSocket.h"
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include "IoUring.h"
+
+// Suspends until the thread's IoUring engine completes one operation. A linked
+// timeout bounds it when the socket has one; the operation then ends with -ECANCELED.
+struct UringOperation final : IoUring::Completion {
+    IoUring& uring;
+    struct io_uring_sqe request{};
+    std::chrono::milliseconds timeout;
+    struct __kernel_timespec deadline{};
+    std::coroutine_handle<> waiter;
+    int32_t result = 0;
+    uint32_t flags = 0;
+
+    UringOperation(IoUring& uring, uint8_t opcode, int fd, std::chrono::milliseconds timeout)
+        : uring(uring), timeout(timeout) {
+        request.opcode = opcode;
+        request.fd = fd;
+    }
+
+    bool await_ready() const { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        waiter = handle;
+        if (timeout.count() > 0) {
+            deadline.tv_sec = timeout.count() / 1000;
+            deadline.tv_nsec = (timeout.count() % 1000) * 1000000;
+            uring.queue(request, this, &deadline);
+        } else {
+            uring.queue(request, this);
+        }
+    }
+
+    int32_t await_resume() const { return result; }
+
+    void complete(int32_t completionResult, uint32_t completionFlags) override {
+        result = completionResult;
+        flags = completionFlags;
+        waiter.resume();
+    }
+};
+
+// Function to map a failed completion to errno; only the linked timeout cancels operations
+static int uringErrno(int32_t result) {
+    return result == -ECANCELED ? ETIMEDOUT : -result;
+}
+
+// Function to wait for poll events on fd through the ring
+static Async<bool> pollWithRing(IoUring& uring, int fd, uint32_t events, std::chrono::milliseconds timeout) {
+    UringOperation poll(uring, IORING_OP_POLL_ADD, fd, timeout);
+    poll.request.poll32_events = events;
+    int32_t result = co_await poll;
+    if (result < 0) {
+        errno = uringErrno(result);
+        co_return false;
+    }
+    co_return true;
+}
+
+AsyncSocket::AsyncSocket(EventLoop& loop, int fd)
+    : loop(loop), uring(IoUring::current()), socketFd(fd), registered(false),
+      readiness(std::make_shared<Readiness>()) {
+    if (uring) {
+        return;   // completions, not readiness, drive this socket
+    }
+    std::shared_ptr<Readiness> state = readiness;
+    registered = loop.add(fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, [state](uint32_t events) {
+        // Resuming may finish the coroutine and free the socket; `state` stays alive through the capture
+        if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+            state->readable = true;
+            if (auto reader = std::exchange(state->reader, nullptr)) {
+                reader.resume();
+            }
+        }
+        if (events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) {
+            state->writable = true;
+            if (auto writer = std::exchange(state->writer, nullptr)) {
+                writer.resume();
+            }
+        }
+    });
+}
+
+AsyncSocket::~AsyncSocket() {
+    if (socketFd >= 0) {
+        if (registered) {
+            loop.remove(socketFd);
+        }
+        close(socketFd);
+    }
+}
+
+int AsyncSocket::release() {
+    if (registered) {
+        loop.remove(socketFd);
+        registered = false;
+    }
+    return std::exchange(socketFd, -1);
+}
+
+bool AsyncSocket::ReadyAwaiter::await_ready() const {
+    if (!socket.registered) {
+        return true;  // await_resume reports the failure
+    }
+    return forWrite ? socket.readiness->writable : socket.readiness->readable;
+}
+
+void AsyncSocket::ReadyAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    (forWrite ? socket.readiness->writer : socket.readiness->reader) = handle;
+    if (socket.waitTimeout.count() > 0) {
+        timer = socket.loop.runAfter(socket.waitTimeout, [this, handle]() {
+            timedOut = true;
+            timer = 0;
+            (forWrite ? socket.readiness->writer : socket.readiness->reader) = nullptr;
+            handle.resume();
+        });
+    }
+}
+
+bool AsyncSocket::ReadyAwaiter::await_resume() {
+    if (timer != 0) {
+        socket.loop.cancelTimer(timer);
+    }
+    if (!socket.registered) {
+        errno = EBADF;
+        return false;
+    }
+    if (timedOut) {
+        errno = ETIMEDOUT;
+        return false;
+    }
+    return true;
+}
+
+Async<bool> AsyncSocket::waitReadable() {
+    if (uring) {
+        co_return co_await pollWithRing(*uring, socketFd, POLLIN | POLLRDHUP, waitTimeout);
+    }
+    readiness->readable = false;
+    co_return co_await readable();
+}
+
+Async<bool> AsyncSocket::waitWritable() {
+    if (uring) {
+        co_return co_await pollWithRing(*uring, socketFd, POLLOUT, waitTimeout);
+    }
+    readiness->writable = false;
+    co_return co_await writable();
+}
+
+Async<bool> AsyncSocket::connect(const SocketAddress& address) {
+    if (uring) {
+        UringOperation connecting(*uring, IORING_OP_CONNECT, socketFd, waitTimeout);
+        connecting.request.addr = reinterpret_cast<uint64_t>(address.get());
+        connecting.request.off = address.length;
+        int32_t result = co_await connecting;
+        if (result < 0) {
+            errno = uringErrno(result);
+            co_return false;
+        }
+        co_return true;
+    }
+
+    int rc = ::connect(socketFd, address.get(), address.length);
+    if (rc == 0) {
+        co_return true;
+    }
+    if (errno != EINPROGRESS) {
+        co_return false;
+    }
+
+    // The connect completes when the socket turns writable
+    readiness->writable = false;
+    if (!co_await writable()) {
+        co_return false;
+    }
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (getsockopt(socketFd, SOL_SOCKET, SO_ERROR, &error, &length) < 0) {
+        co_return false;
+    }
+    if (error != 0) {
+        errno = error;
+        co_return false;
+    }
+    co_return true;
+}
+
+Async<ssize_t> AsyncSocket::read(char* buffer, size_t size) {
+    if (uring) {
+        // The kernel picks a provided buffer only once data is there; fall back to
+        // the caller's buffer when the ring has run dry
+        UringOperation receive(*uring, IORING_OP_RECV, socketFd, waitTimeout);
+        receive.request.len = static_cast<uint32_t>(std::min(size, uring->bufferSize()));
+        receive.request.flags = IOSQE_BUFFER_SELECT;
+        receive.request.buf_group = IoUring::bufferGroup;
+        int32_t received = co_await receive;
+        if (received == -ENOBUFS) {
+            UringOperation direct(*uring, IORING_OP_RECV, socketFd, waitTimeout);
+            direct.request.addr = reinterpret_cast<uint64_t>(buffer);
+            direct.request.len = static_cast<uint32_t>(size);
+            received = co_await direct;
+        } else if (receive.flags & IORING_CQE_F_BUFFER) {
+            uint16_t id = static_cast<uint16_t>(receive.flags >> IORING_CQE_BUFFER_SHIFT);
+            if (received > 0) {
+                std::memcpy(buffer, uring->buffer(id), received);
+            }
+            uring->recycleBuffer(id);
+        }
+        if (received < 0) {
+            errno = uringErrno(received);
+            co_return -1;
+        }
+        co_return received;
+    }
+
+    while (true) {
+        ssize_t received = recv(socketFd, buffer, size, 0);
+        if (received >= 0) {
+            co_return received;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            co_return -1;
+        }
+        readiness->readable = false;
+        if (!co_await readable()) {
+            co_return -1;
+        }
+    }
+}
+
+Async<bool> AsyncSocket::writeAll(std::string_view data) {
+    if (uring) {
+        while (!data.empty()) {
+            UringOperation sending(*uring, IORING_OP_SEND, socketFd, waitTimeout);
+            sending.request.addr = reinterpret_cast<uint64_t>(data.data());
+            sending.request.len = static_cast<uint32_t>(std::min<size_t>(data.size(), UINT32_MAX));
+            sending.request.msg_flags = MSG_NOSIGNAL;
+            int32_t sent = co_await sending;
+            if (sent < 0) {
+                errno = uringErrno(sent);
+                co_return false;
+            }
+            data.remove_prefix(sent);
+        }
+        co_return true;
+    }
+
+    while (!data.empty()) {
+        ssize_t sent = send(socketFd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (sent >= 0) {
+            data.remove_prefix(sent);
+            continue;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            co_return false;
+        }
+        readiness->writable = false;
+        if (!co_await writable()) {
+            co_return false;
+        }
+    }
+    co_return true;
+}
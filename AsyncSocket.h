@@ -0,0 +1,97 @@
+#ifndef ASYNCSOCKET_H
+#define ASYNCSOCKET_H
+
+#include <netinet/in.h>
+#include <sys/types.h>
+#include <chrono>
+#include <coroutine>
+#include <memory>
+#include <string_view>
+#include "Coroutine.h"
+#include "EventLoop.h"
+#include "Resolver.h"
+
+class IoUring;
+
+// Non-blocking socket whose reads, writes and connect are awaited from a
+// coroutine running on the socket's EventLoop. The descriptor is registered
+// edge-triggered once; readiness is remembered between waits so a coroutine
+// only suspends after the kernel said EAGAIN. When the loop thread has an
+// IoUring engine attached, every operation is issued through it instead.
+class AsyncSocket {
+public:
+    // Takes ownership of fd, which must already be non-blocking
+    AsyncSocket(EventLoop& loop, int fd);
+    ~AsyncSocket();
+
+    AsyncSocket(const AsyncSocket&) = delete;
+    AsyncSocket& operator=(const AsyncSocket&) = delete;
+
+    // Give up on a read or write that waits longer than this; zero waits forever
+    void setTimeout(std::chrono::milliseconds timeout) { waitTimeout = timeout; }
+
+    // Complete a non-blocking connect(); false with errno set on failure
+    Async<bool> connect(const SocketAddress& address);
+
+    // Bytes read, 0 on EOF, -1 with errno set on error (ETIMEDOUT on timeout)
+    Async<ssize_t> read(char* buffer, size_t size);
+
+    // Write all of data; false with errno set if the peer went away or timed out
+    Async<bool> writeAll(std::string_view data);
+
+    // Wait after a call made on fd() directly (e.g. splice) reported EAGAIN;
+    // false with errno set on timeout
+    Async<bool> waitReadable();
+    Async<bool> waitWritable();
+
+    // Stop watching the descriptor and hand it back to the caller
+    int release();
+
+    int fd() const { return socketFd; }
+    EventLoop& eventLoop() { return loop; }
+
+private:
+    // Readiness shared with the loop's handler, which may outlive this socket
+    struct Readiness {
+        bool readable = true;
+        bool writable = true;
+        std::coroutine_handle<> reader;
+        std::coroutine_handle<> writer;
+    };
+
+    // Suspends until the socket is readable (or writable) again or the timeout fires
+    struct ReadyAwaiter {
+        AsyncSocket& socket;
+        bool forWrite;
+        bool timedOut = false;
+        EventLoop::TimerId timer = 0;
+
+        bool await_ready() const;
+        void await_suspend(std::coroutine_handle<> handle);
+        bool await_resume();   // false on timeout
+    };
+
+    EventLoop& loop;
+    IoUring* uring;    // completion engine of this thread, or nullptr for epoll readiness
+    int socketFd;
+    bool registered;
+    std::shared_ptr<Readiness> readiness;
+    std::chrono::milliseconds waitTimeout{0};
+
+    ReadyAwaiter readable() { return ReadyAwaiter{*this, false}; }
+    ReadyAwaiter writable() { return ReadyAwaiter{*this, true}; }
+};
+
+// Suspend the calling coroutine for `delay` on its loop
+struct SleepAwaiter {
+    EventLoop& loop;
+    std::chrono::milliseconds delay;
+
+    bool await_ready() const { return delay.count() <= 0; }
+    void await_suspend(std::coroutine_handle<> handle) {
+        loop.runAfter(delay, [handle]() { handle.resume(); });
+    }
+    void await_resume() {}
+};
+
+#endif // ASYNCSOCKET_H
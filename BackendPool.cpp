@@ -0,0 +1,160 @@
+#include "BackendPool.h"
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <vector>
+
+BackendPool::BackendPool(BackendPoolConfig config)
+    : config(config), hits(0), misses(0), opened(0), closed(0), healthCheckFailures(0), exhausted(0) {}
+
+// Destructor: close every idle socket still owned by the pool
+BackendPool::~BackendPool() {
+    for (auto& entry : backends) {
+        for (auto& connection : entry.second->idle) {
+            close(connection.fd);
+        }
+    }
+}
+
+// Take the most recently used healthy idle socket, or reserve room for a new one
+BackendPool::AcquireResult BackendPool::acquire(const std::string& backendKey, int& fd) {
+    Backend& backend = backendFor(backendKey);
+    std::vector<int> deadSockets;
+    AcquireResult result;
+    {
+        std::lock_guard<std::mutex> lock(backend.mutex);
+        auto now = Clock::now();
+
+        fd = -1;
+        while (!backend.idle.empty()) {
+            IdleConnection connection = backend.idle.back();
+            backend.idle.pop_back();
+            if (isHealthy(connection, now)) {
+                fd = connection.fd;
+                break;
+            }
+            deadSockets.push_back(connection.fd);
+            --backend.total;
+        }
+
+        if (fd >= 0) {
+            result = AcquireResult::Reused;
+        } else if (backend.total < config.maxTotalPerBackend) {
+            ++backend.total;
+            result = AcquireResult::OpenNew;
+        } else {
+            result = AcquireResult::Exhausted;
+        }
+    }
+
+    // Close outside the lock
+    healthCheckFailures.fetch_add(deadSockets.size(), std::memory_order_relaxed);
+    for (int dead : deadSockets) {
+        closeSocket(dead);
+    }
+
+    if (result == AcquireResult::Reused) {
+        hits.fetch_add(1, std::memory_order_relaxed);
+    } else if (result == AcquireResult::OpenNew) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        exhausted.fetch_add(1, std::memory_order_relaxed);
+    }
+    return result;
+}
+
+// Count a freshly established connection
+void BackendPool::connected(const std::string& backendKey) {
+    (void)backendKey;
+    opened.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Hand a leased socket back to the pool
+void BackendPool::release(const std::string& backendKey, int fd, bool reusable) {
+    Backend& backend = backendFor(backendKey);
+    {
+        std::lock_guard<std::mutex> lock(backend.mutex);
+        if (reusable && backend.idle.size() < config.maxIdlePerBackend) {
+            backend.idle.push_back({fd, Clock::now()});
+            return;
+        }
+        --backend.total;
+    }
+    closeSocket(fd);
+}
+
+// Give back a slot reserved by acquire() that never got a connection
+void BackendPool::cancel(const std::string& backendKey) {
+    Backend& backend = backendFor(backendKey);
+    std::lock_guard<std::mutex> lock(backend.mutex);
+    --backend.total;
+}
+
+// Health-check every idle socket and close the ones that are no longer usable
+void BackendPool::reapIdle() {
+    std::vector<Backend*> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(backendsMutex);
+        for (auto& entry : backends) {
+            snapshot.push_back(entry.second.get());
+        }
+    }
+
+    for (Backend* backend : snapshot) {
+        std::vector<int> deadSockets;
+        {
+            std::lock_guard<std::mutex> lock(backend->mutex);
+            auto now = Clock::now();
+            for (auto it = backend->idle.begin(); it != backend->idle.end(); ) {
+                if (isHealthy(*it, now)) {
+                    ++it;
+                } else {
+                    deadSockets.push_back(it->fd);
+                    it = backend->idle.erase(it);
+                    --backend->total;
+                }
+            }
+        }
+        healthCheckFailures.fetch_add(deadSockets.size(), std::memory_order_relaxed);
+        for (int dead : deadSockets) {
+            closeSocket(dead);
+        }
+    }
+}
+
+BackendPool::Stats BackendPool::stats() const {
+    return Stats{
+        hits.load(std::memory_order_relaxed),
+        misses.load(std::memory_order_relaxed),
+        opened.load(std::memory_order_relaxed),
+        closed.load(std::memory_order_relaxed),
+        healthCheckFailures.load(std::memory_order_relaxed),
+        exhausted.load(std::memory_order_relaxed)
+    };
+}
+
+// Find or create the per-backend bookkeeping
+BackendPool::Backend& BackendPool::backendFor(const std::string& backendKey) {
+    std::lock_guard<std::mutex> lock(backendsMutex);
+    auto& backend = backends[backendKey];
+    if (!backend) {
+        backend = std::make_unique<Backend>();
+    }
+    return *backend;
+}
+
+// An idle socket is healthy when it has not expired, the backend has not closed
+// it and no unsolicited bytes are waiting on it
+bool BackendPool::isHealthy(const IdleConnection& connection, Clock::time_point now) const {
+    if (now - connection.idleSince > config.idleTimeout) {
+        return false;
+    }
+    char byte;
+    ssize_t peeked = recv(connection.fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    return peeked < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+void BackendPool::closeSocket(int fd) {
+    close(fd);
+    closed.fetch_add(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,91 @@
+#ifndef BACKENDPOOL_H
+#define BACKENDPOOL_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Pool limits, applied to each backend separately
+struct BackendPoolConfig {
+    size_t maxIdlePerBackend = 32;                  // idle keep-alive sockets kept per backend
+    size_t maxTotalPerBackend = 256;                // idle + leased sockets per backend
+    std::chrono::seconds idleTimeout{30};           // idle sockets older than this are closed
+};
+
+// Pool of idle HTTP/1.1 keep-alive connections to the backends, shared by all
+// worker threads. Sockets are kept non-blocking; callers connect new sockets
+// themselves and hand them back with release() when the response is complete.
+class BackendPool {
+public:
+    enum class AcquireResult {
+        Reused,      // fd holds a healthy idle connection
+        OpenNew,     // a slot was reserved; the caller must open a new connection
+        Exhausted    // maxTotalPerBackend sockets are already open
+    };
+
+    struct Stats {
+        uint64_t hits;                  // requests served over a reused connection
+        uint64_t misses;                // requests that needed a new connection
+        uint64_t opened;                // connections successfully established
+        uint64_t closed;                // connections closed by the pool or callers
+        uint64_t healthCheckFailures;   // idle sockets found dead or expired
+        uint64_t exhausted;             // acquire() refused because of maxTotalPerBackend
+    };
+
+    explicit BackendPool(BackendPoolConfig config = BackendPoolConfig());
+    ~BackendPool();
+
+    // Take an idle connection to the backend or reserve a slot for a new one
+    AcquireResult acquire(const std::string& backendKey, int& fd);
+
+    // A reserved slot now holds a connected socket
+    void connected(const std::string& backendKey);
+
+    // Return a leased socket; it is kept only when reusable and the idle list has room
+    void release(const std::string& backendKey, int fd, bool reusable);
+
+    // Drop a reserved slot whose connection attempt failed
+    void cancel(const std::string& backendKey);
+
+    // Close idle sockets that expired or were closed by the backend
+    void reapIdle();
+
+    Stats stats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct IdleConnection {
+        int fd;
+        Clock::time_point idleSince;
+    };
+
+    struct Backend {
+        std::mutex mutex;
+        std::deque<IdleConnection> idle;   // most recently used at the back
+        size_t total = 0;                  // idle + leased + reserved
+    };
+
+    BackendPoolConfig config;
+
+    std::mutex backendsMutex;              // Protects the backends map itself
+    std::unordered_map<std::string, std::unique_ptr<Backend>> backends;
+
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+    std::atomic<uint64_t> opened;
+    std::atomic<uint64_t> closed;
+    std::atomic<uint64_t> healthCheckFailures;
+    std::atomic<uint64_t> exhausted;
+
+    Backend& backendFor(const std::string& backendKey);
+    bool isHealthy(const IdleConnection& connection, Clock::time_point now) const;
+    void closeSocket(int fd);
+};
+
+#endif // BACKENDPOOL_H
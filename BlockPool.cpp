@@ -0,0 +1,77 @@
+#include "BlockPool.h"
+#include <bit>
+#include <new>
+
+// Set once the thread's lists are destroyed; frees later in its exit go straight to the heap
+static thread_local bool listsClosed = false;
+
+// Shift of the classes in the first power of two past MinBlock
+static constexpr int firstShift = 6 - 2;   // log2(MinBlock) - SubClassBits
+
+BlockPool::FreeLists::~FreeLists() {
+    for (size_t index = 0; index < ClassCount; ++index) {
+        while (heads[index] != nullptr) {
+            FreeBlock* block = heads[index];
+            heads[index] = block->next;
+            ::operator delete(block, classSize(index));
+        }
+    }
+    listsClosed = true;
+}
+
+// Function to find the lists of the calling thread; null while it exits
+BlockPool::FreeLists* BlockPool::local() {
+    thread_local FreeLists lists;
+    return listsClosed ? nullptr : &lists;
+}
+
+size_t BlockPool::classOf(size_t bytes) {
+    if (bytes <= MinBlock) {
+        return 0;
+    }
+    // The highest bit picks the power of two, the next SubClassBits bits the class within it
+    size_t last = bytes - 1;
+    int shift = std::bit_width(last) - 1 - SubClassBits;
+    return static_cast<size_t>(shift - firstShift) * SubClasses + (last >> shift) - SubClasses + 1;
+}
+
+size_t BlockPool::classSize(size_t index) {
+    if (index == 0) {
+        return MinBlock;
+    }
+    int shift = static_cast<int>((index - 1) / SubClasses) + firstShift;
+    return (SubClasses + (index - 1) % SubClasses + 1) << shift;
+}
+
+void* BlockPool::allocate(size_t bytes) {
+    if (bytes > MaxBlock) {
+        return ::operator new(bytes);
+    }
+    size_t index = classOf(bytes);
+    FreeLists* lists = local();
+    if (lists != nullptr && lists->heads[index] != nullptr) {
+        FreeBlock* block = lists->heads[index];
+        lists->heads[index] = block->next;
+        --lists->kept[index];
+        return block;
+    }
+    return ::operator new(classSize(index));
+}
+
+void BlockPool::deallocate(void* block, size_t bytes) noexcept {
+    if (bytes > MaxBlock) {
+        ::operator delete(block, bytes);
+        return;
+    }
+    size_t index = classOf(bytes);
+    FreeLists* lists = local();
+    if (lists == nullptr ||
+        (lists->kept[index] > 0 && (lists->kept[index] + 1) * classSize(index) > KeptBytesPerClass)) {
+        ::operator delete(block, classSize(index));
+        return;
+    }
+    FreeBlock* freed = static_cast<FreeBlock*>(block);
+    freed->next = lists->heads[index];
+    lists->heads[index] = freed;
+    ++lists->kept[index];
+}
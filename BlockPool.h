@@ -0,0 +1,42 @@
+#ifndef BLOCK_POOL_H
+#define BLOCK_POOL_H
+
+#include <cstddef>
+
+// Per-thread free lists of heap blocks, one list per size class. Classes
+// step like LatencyBuckets: four per power of two from 64 bytes to 64 KB, so
+// a block is never more than a quarter larger than asked for. Objects that
+// come and go with every request in the same few sizes (coroutine frames,
+// and the socket buffers inside them) reuse a block freed earlier instead
+// of going through malloc. Larger sizes, and blocks past what a list keeps,
+// go straight to the heap. A block freed on another thread than the one it
+// came from simply joins that thread's list.
+class BlockPool {
+public:
+    static void* allocate(size_t bytes);
+    static void deallocate(void* block, size_t bytes) noexcept;
+
+private:
+    static constexpr size_t MinBlock = 64;
+    static constexpr int SubClassBits = 2;
+    static constexpr size_t SubClasses = size_t{1} << SubClassBits;
+    static constexpr size_t MaxBlock = 64 * 1024;
+    static constexpr size_t ClassCount = 41;               // 64 B, then 4 classes per power of two up to MaxBlock
+    static constexpr size_t KeptBytesPerClass = 256 * 1024; // at least one block is always kept
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    struct FreeLists {
+        FreeBlock* heads[ClassCount] = {};
+        size_t kept[ClassCount] = {};
+        ~FreeLists();
+    };
+
+    static size_t classOf(size_t bytes);
+    static size_t classSize(size_t index);
+    static FreeLists* local();
+};
+
+#endif // BLOCK_POOL_H
@@ -0,0 +1,919 @@
+#include "Connection.h"
+#include "Logger.h"
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+// Relayed bytes allowed to wait for a slow client before backend reads pause
+static constexpr size_t relayHighWatermark = 256 * 1024;
+
+// Constructor: the connection takes ownership of the accepted socket
+ClientConnection::ClientConnection(EventLoop& loop, int clientSocket, struct sockaddr_in clientAddress,
+                                   Clock::time_point acceptedAt)
+    : loop(loop),
+      state(State::ReadingRequest),
+      clientSocket(clientSocket),
+      clientAddress(clientAddress),
+      clientIP(getClientIP(clientAddress)),
+      backendSocket(-1),
+      backendReused(false),
+      deadline(upstreams.settings()),
+      backendTimer(0),
+      retries(0),
+      backendAnswered(false),
+      hedgeSocket(-1),
+      hedgeReused(false),
+      hedgeConnecting(false),
+      hedgeTimer(0),
+      backendRequest(arena.resource()),
+      backendRequestOffset(0),
+      cacheKey(arena.resource()),
+      fetchLeader(false),
+      fetchTimer(0),
+      caching(true),
+      splicing(false),
+      responseOffset(0),
+      responseStatus(0),
+      closeAfterResponse(true),
+      requestsServed(0),
+      idleTimer(0),
+      idleTimerArmed(false),
+      acceptedAt(acceptedAt),
+      waitingTime(0) {}
+
+// Destructor: make sure no descriptor outlives the connection
+ClientConnection::~ClientConnection() {
+    endFetch();
+    if (backendSocket >= 0) {
+        backendPool.release(upstream->key, backendSocket, false);
+    }
+    if (hedgeSocket >= 0) {
+        backendPool.release(hedgeUpstream->key, hedgeSocket, false);
+    }
+    if (clientSocket >= 0) {
+        close(clientSocket);
+    }
+}
+
+// Register with the loop; edge-triggered so every handler drains until EAGAIN
+void ClientConnection::start() {
+    processingStart = Clock::now();
+    waitingTime = std::chrono::duration_cast<std::chrono::milliseconds>(processingStart - acceptedAt).count();
+    metrics.record(Stage::QueueWait, processingStart - acceptedAt);
+
+    auto self = shared_from_this();
+    if (!loop.add(clientSocket, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET,
+                  [self](uint32_t events) { self->onClientEvent(events); })) {
+        close(clientSocket);
+        clientSocket = -1;
+        state = State::Closed;
+        return;
+    }
+
+    // Data may already be waiting; edge-triggered mode will not report it again
+    readRequest();
+}
+
+// Dispatch client socket readiness according to the current state
+void ClientConnection::onClientEvent(uint32_t events) {
+    if (events & (EPOLLERR | EPOLLHUP)) {
+        if (state == State::ReadingRequest && !(requestsServed > 0 && requestBuffer.empty())) {
+            logRequest(clientIP, "DISCONNECT", "N/A", 499, waitingTime, processingTimeMs(),
+                       waitingTime + processingTimeMs(), "Client Closed Connection");
+        }
+        closeConnection();
+        return;
+    }
+
+    if (state == State::ReadingRequest && (events & (EPOLLIN | EPOLLRDHUP))) {
+        readRequest();
+    } else if (state == State::WritingResponse && (events & EPOLLOUT)) {
+        writeResponse();
+    } else if (state == State::ReadingBackend && (events & EPOLLOUT)) {
+        // The client drained some of the relay; resume reading the backend
+        if (splicing) {
+            relayBody();
+        } else if (flushRelay()) {
+            readBackendResponse();
+        }
+    }
+}
+
+// Dispatch backend socket readiness according to the current state
+void ClientConnection::onBackendEvent(uint32_t events) {
+    switch (state) {
+        case State::ConnectingBackend:
+            finishBackendConnect();
+            break;
+        case State::WritingBackend:
+            writeBackendRequest();
+            break;
+        case State::ReadingBackend:
+            if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                readBackendResponse();
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// Dispatch hedge socket readiness; once promoted it is the backend socket
+void ClientConnection::onHedgeEvent(uint32_t events) {
+    if (hedgeSocket < 0) {
+        onBackendEvent(events);
+        return;
+    }
+    if (hedgeConnecting) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        if (getsockopt(hedgeSocket, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0) {
+            hedgeUpstream.fail();
+            cancelHedge();
+            return;
+        }
+        if (!(events & EPOLLOUT)) {
+            return;
+        }
+        hedgeConnecting = false;
+        backendPool.connected(hedgeUpstream->key);
+        sendHedgeRequest();
+        return;
+    }
+    if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+        promoteHedge();
+    }
+}
+
+// The current backend phase ran past its deadline
+void ClientConnection::onBackendTimeout() {
+    backendTimer = 0;
+    if (state != State::ConnectingBackend && state != State::WritingBackend && state != State::ReadingBackend) {
+        return;
+    }
+    logError("Backend timed out", logPath);
+    retryOrFail(504, "Backend Timeout");
+}
+
+// Read until a complete request is buffered, EOF or EAGAIN. Pipelined
+// requests stay in requestBuffer and are served one after another.
+void ClientConnection::readRequest() {
+    char buffer[4096];
+    while (state == State::ReadingRequest) {
+        auto parseStart = MetricsRegistry::Clock::now();
+        auto result = requestParser.parse(requestBuffer, reqInfo);
+        if (result == HttpRequestParser::Result::Complete) {
+            metrics.record(Stage::Parse, parseStart);
+            processRequest();
+            return;
+        }
+        if (result == HttpRequestParser::Result::Error) {
+            cancelIdleTimer();
+            logMethod = "CLIENT_ERROR";
+            logPath = "N/A";
+            sendError(requestParser.errorStatus(), "Invalid Request Format");
+            return;
+        }
+
+        ssize_t bytesReceived = recv(clientSocket, buffer, sizeof(buffer), 0);
+        if (bytesReceived > 0) {
+            requestBuffer.append(buffer, bytesReceived);
+            continue;
+        }
+
+        if (bytesReceived == 0) {
+            // An idle keep-alive connection closing between requests is not an error
+            if (requestsServed == 0 || !requestBuffer.empty()) {
+                logRequest(clientIP, "DISCONNECT", "N/A", 499, waitingTime, processingTimeMs(),
+                           waitingTime + processingTimeMs(), "Client Closed Connection");
+            }
+            closeConnection();
+            return;
+        }
+
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            armIdleTimer();
+            return;  // Wait for the next EPOLLIN edge
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+
+        logRequest(clientIP, "ERROR", "N/A", 500, waitingTime, processingTimeMs(),
+                   waitingTime + processingTimeMs(), "Socket Receive Error");
+        closeConnection();
+        return;
+    }
+}
+
+// Parse the buffered request and serve it from cache or the backend
+void ClientConnection::processRequest() {
+    cancelIdleTimer();
+
+    // Later requests on a kept-alive connection start their clock once fully read
+    if (requestsServed > 0) {
+        processingStart = Clock::now();
+        waitingTime = 0;
+    }
+
+    // reqInfo views into requestBuffer, which is left untouched until the response is written
+    logMethod = reqInfo.method;
+    logPath = reqInfo.path;
+
+    // The metrics page is served by the proxy itself, outside the rate limits
+    if (isMetricsRequest(reqInfo)) {
+        sendResponse(generateMetricsResponse(), 200, "Served Metrics", reqInfo.keepAlive);
+        return;
+    }
+
+    // Check if request is in cache to avoid unnecessary backend calls
+    cacheKey = HttpCache::primaryKey(reqInfo.method, getBackendKey(), reqInfo.path, arena.resource());
+    auto lookupStart = MetricsRegistry::Clock::now();
+    HttpCache::Lookup cached = cache.lookup(reqInfo, cacheKey);
+    metrics.record(Stage::CacheLookup, lookupStart);
+    metrics.count(cached.response ? Counter::CacheHits : Counter::CacheMisses);
+
+    // Rate Limiting: hits and backend fetches draw on separate budgets of the route's policy
+    auto charge = cached.response ? RateLimitPolicies::Charge::CacheHit : RateLimitPolicies::Charge::BackendFetch;
+    if (!rateLimits.allow(rateLimits.match(reqInfo.method, reqInfo.path), charge, clientAddress)) {
+        if (cached.revalidate) {
+            revalidateInBackground(reqInfo, cacheKey);
+        }
+        logMethod = "RATE_LIMITED";
+        logPath = "N/A";
+        metrics.count(Counter::RateLimited);
+
+        // The request was read whole, so the connection stays usable
+        sendResponse(generateErrorResponse(429, "Too many requests. Please slow down and try again later."),
+                     429, rateLimitMessage(charge), reqInfo.keepAlive);
+        return;
+    }
+
+    if (cached.response) {
+        serveFromCache(std::move(cached));
+        return;
+    }
+
+    // Concurrent misses for one key share a single backend fetch: wait for
+    // the request already fetching it, then look the key up again
+    if (HttpCache::requestAllowsLookup(reqInfo) && HttpCache::requestAllowsStore(reqInfo)) {
+        std::weak_ptr<ClientConnection> weakSelf = shared_from_this();
+        EventLoop* owner = &loop;
+        fetchLeader = cache.beginFetch(cacheKey, [weakSelf, owner]() {
+            owner->post([weakSelf]() {
+                if (auto self = weakSelf.lock()) {
+                    self->resumeAfterFetch();
+                }
+            });
+        });
+        if (!fetchLeader) {
+            state = State::WaitingForFetch;
+            fetchTimer = loop.runAfter(getServerConfig().coalesceTimeout, [weakSelf]() {
+                if (auto self = weakSelf.lock()) {
+                    self->resumeAfterFetch();
+                }
+            });
+            return;
+        }
+    }
+
+    startBackendRequest();
+}
+
+// The fetch this request waited for ended (or took too long); use its result
+// if it was cached, otherwise go to the backend alone
+void ClientConnection::resumeAfterFetch() {
+    if (state != State::WaitingForFetch) {
+        return;
+    }
+    loop.cancelTimer(fetchTimer);
+
+    auto lookupStart = MetricsRegistry::Clock::now();
+    HttpCache::Lookup cached = cache.lookup(reqInfo, cacheKey);
+    metrics.record(Stage::CacheLookup, lookupStart);
+    if (cached.response) {
+        serveFromCache(std::move(cached));
+        return;
+    }
+    startBackendRequest();
+}
+
+// Send a cache hit, first handing a stale one's refresh to the background
+void ClientConnection::serveFromCache(HttpCache::Lookup cached) {
+    if (cached.revalidate) {
+        revalidateInBackground(reqInfo, cacheKey);
+    }
+    bool keepOpen = reqInfo.keepAlive && responseIsSelfDelimited(*cached.response, reqInfo.method == "HEAD");
+    sendCachedResponse(std::move(cached.response), keepOpen);
+}
+
+// Wake the requests coalesced behind this one, if it was fetching for them
+void ClientConnection::endFetch() {
+    if (fetchLeader) {
+        fetchLeader = false;
+        cache.finishFetch(cacheKey);
+    }
+}
+
+// Lease a pooled keep-alive connection or open a new non-blocking one
+void ClientConnection::startBackendRequest() {
+    const UpstreamConfig& policy = upstreams.settings();
+    if (!upstream) {
+        deadline = BackendDeadline(policy);
+        backendStart = deadline.phaseStarted();
+        upstream = upstreams.choose();
+    }
+    const std::string& backendKey = upstream->key;
+    if (backendRequest.empty()) {
+        backendRequest = buildBackendRequest(*upstream, reqInfo, arena.resource());
+    }
+    backendRequestOffset = 0;
+    responseParser.reset(reqInfo.method == "HEAD");
+    cacheCopy.clear();
+    caching = HttpCache::requestAllowsStore(reqInfo);
+    splicing = false;
+    responseBuffer.clear();
+    responseOffset = 0;
+    backendAnswered = false;
+
+    int pooledSocket = -1;
+    auto acquired = backendPool.acquire(backendKey, pooledSocket);
+    if (acquired == BackendPool::AcquireResult::Exhausted) {
+        cancelBackendTimer();
+        sendError(503, "Backend Connection Limit Reached");
+        return;
+    }
+
+    backendReused = acquired == BackendPool::AcquireResult::Reused;
+    if (backendReused) {
+        backendSocket = pooledSocket;
+        state = State::WritingBackend;
+    } else {
+        SocketAddress backendAddress;
+        if (!resolveBackendAddress(*upstream, backendAddress)) {
+            backendPool.cancel(backendKey);
+            retryOrFail(502, "Backend Resolution Failed");
+            return;
+        }
+
+        bool inProgress = false;
+        backendSocket = openBackendSocket(backendAddress, inProgress);
+        if (backendSocket < 0) {
+            backendPool.cancel(backendKey);
+            retryOrFail(502, "Backend Connection Failed");
+            return;
+        }
+        if (!inProgress) {
+            backendPool.connected(backendKey);
+        }
+        state = inProgress ? State::ConnectingBackend : State::WritingBackend;
+    }
+    deadline.startPhase(state == State::ConnectingBackend ? policy.connectTimeout : policy.firstByteTimeout);
+
+    auto self = shared_from_this();
+    if (!loop.add(backendSocket, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET,
+                  [self](uint32_t events) { self->onBackendEvent(events); })) {
+        backendPool.release(backendKey, backendSocket, false);
+        backendSocket = -1;
+        cancelBackendTimer();
+        sendError(502, "Backend Connection Failed");
+        return;
+    }
+    armBackendTimer();
+
+    if (state == State::WritingBackend) {
+        writeBackendRequest();
+    }
+}
+
+// The connect() completed; check whether it succeeded
+void ClientConnection::finishBackendConnect() {
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (getsockopt(backendSocket, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0) {
+        logError("Backend connection failed", strerror(error != 0 ? error : errno));
+        retryOrFail(502, "Backend Connection Failed");
+        return;
+    }
+
+    backendPool.connected(upstream->key);
+    metrics.record(Stage::BackendConnect, deadline.phaseStarted());
+    deadline.startPhase(upstreams.settings().firstByteTimeout);
+    armBackendTimer();
+    state = State::WritingBackend;
+    writeBackendRequest();
+}
+
+// Write as much of the backend request as the socket accepts
+void ClientConnection::writeBackendRequest() {
+    while (backendRequestOffset < backendRequest.size()) {
+        ssize_t sent = send(backendSocket, backendRequest.data() + backendRequestOffset,
+                            backendRequest.size() - backendRequestOffset, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;  // Wait for EPOLLOUT
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            logError("Error sending request to backend", strerror(errno));
+            retryOrFail(502, "Send Failed");
+            return;
+        }
+        backendRequestOffset += sent;
+    }
+
+    state = State::ReadingBackend;
+    armHedgeTimer();
+    readBackendResponse();
+}
+
+// Relay the backend response to the client as it arrives, keeping a copy for
+// the cache while it stays small enough. Reading pauses while a slow client
+// has relayHighWatermark bytes outstanding and resumes on its EPOLLOUT.
+void ClientConnection::readBackendResponse() {
+    char buffer[16384];
+    while (state == State::ReadingBackend) {
+        // Opaque bodies too large to cache skip user space once buffered bytes are out
+        if (!splicing && !caching && responseParser.bodyIsOpaque() && responseOffset == responseBuffer.size()) {
+            splicing = true;
+        }
+        if (splicing) {
+            relayBody();
+            return;
+        }
+        if (responseBuffer.size() - responseOffset >= relayHighWatermark) {
+            return;
+        }
+
+        ssize_t bytesReceived = recv(backendSocket, buffer, sizeof(buffer), 0);
+        if (bytesReceived > 0) {
+            if (!backendAnswered) {
+                // First byte: a pending hedge lost, and only the total deadline is left
+                backendAnswered = true;
+                if (hedgeSocket >= 0) {
+                    upstreams.countHedge(false);
+                }
+                cancelHedge();
+                metrics.record(Stage::BackendFirstByte, deadline.phaseStarted());
+                deadline.startPhase(std::chrono::milliseconds(0));
+                armBackendTimer();
+            }
+            size_t used = 0;
+            auto result = responseParser.feed(std::string_view(buffer, bytesReceived), used);
+            if (result == HttpResponseParser::Result::Error) {
+                // Before the head is relayed another backend may still answer, as in the other IO models
+                logError("Malformed backend response", logPath);
+                retryOrFail(502, "Invalid Response");
+                return;
+            }
+
+            std::string_view bytes(buffer, used);
+            if (caching) {
+                caching = responseFitsCache(responseParser);
+                if (caching) {
+                    cacheCopy.append(bytes);
+                } else {
+                    std::string().swap(cacheCopy);
+                }
+            }
+            responseBuffer.append(bytes);
+
+            if (result == HttpResponseParser::Result::Complete) {
+                // Bytes past the framed message mean the backend misbehaved; do not reuse it
+                finishBackendResponse(responseParser.keepAlive() && used == static_cast<size_t>(bytesReceived));
+                return;
+            }
+
+            // The head is held back until it parses, so a bad one can still get an error page
+            if (responseParser.headersComplete() && !flushRelay()) {
+                return;
+            }
+            continue;
+        }
+        if (bytesReceived == 0) {
+            if (responseParser.finishOnEof() == HttpResponseParser::Result::Complete) {
+                finishBackendResponse(false);
+            } else {
+                retryOrFail(502, "Invalid Response");
+            }
+            return;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        logError("Error receiving backend response", strerror(errno));
+        retryOrFail(502, "Invalid Response");
+        return;
+    }
+}
+
+// Write relayed bytes to the client until it stops taking them; false once
+// the connection had to be closed
+bool ClientConnection::flushRelay() {
+    while (responseOffset < responseBuffer.size()) {
+        ssize_t sent = send(clientSocket, responseBuffer.data() + responseOffset,
+                            responseBuffer.size() - responseOffset, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return true;  // Wait for EPOLLOUT
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            logRequest(clientIP, "FATAL", "N/A", 500, waitingTime, processingTimeMs(),
+                       waitingTime + processingTimeMs(), "Failed to send response");
+            closeConnection();
+            return false;
+        }
+        responseOffset += sent;
+    }
+    responseBuffer.clear();
+    responseOffset = 0;
+    return true;
+}
+
+// Move an opaque body from the backend to the client with splice()
+void ClientConnection::relayBody() {
+    size_t remaining = responseParser.bodyRemaining();
+    size_t before = remaining;
+    auto status = splice.pump(backendSocket, clientSocket, remaining);
+    responseParser.skipBody(before - remaining);
+
+    switch (status) {
+        case SpliceRelay::Status::Done:
+            finishBackendResponse(responseParser.keepAlive());
+            break;
+        case SpliceRelay::Status::WaitReadable:
+        case SpliceRelay::Status::WaitWritable:
+            break;  // Resumed by the next edge on either socket
+        case SpliceRelay::Status::Eof:
+            if (responseParser.finishOnEof() == HttpResponseParser::Result::Complete) {
+                finishBackendResponse(false);
+            } else {
+                abortRelay();
+            }
+            break;
+        default:
+            logError("Error relaying backend response", strerror(errno));
+            abortRelay();
+            break;
+    }
+}
+
+// A reused keep-alive socket may have been closed by the backend while idle;
+// retry on another connection as long as nothing was received yet. Other
+// failures of idempotent requests move to another backend within the retry
+// budget, until the total deadline passes.
+void ClientConnection::retryOrFail(int statusCode, const std::string& message) {
+    cancelHedge();
+    if (responseParser.headersComplete()) {
+        abortRelay();
+        return;
+    }
+
+    bool stale = backendReused && responseParser.messageLength() == 0 && !deadline.expired();
+    releaseBackend(false);
+    if (stale) {
+        startBackendRequest();
+        return;
+    }
+
+    const Upstream* failed = &*upstream;
+    upstream.fail();
+    if (mayRetryBackend(reqInfo.method, retries, deadline)) {
+        ++retries;
+        upstream = upstreams.choose(failed);
+        backendRequest.clear();
+        startBackendRequest();
+        return;
+    }
+    cancelBackendTimer();
+    if (deadline.expired()) {
+        sendError(504, "Backend Timeout");
+        return;
+    }
+    sendError(statusCode, message);
+}
+
+// Send the request to a second backend too, if the first one has not started
+// answering by the hedge delay
+void ClientConnection::startHedge() {
+    if (state != State::ReadingBackend || backendAnswered || hedgeSocket >= 0 || !upstreams.allowRetry()) {
+        return;
+    }
+    UpstreamRequest hedge = upstreams.choose(&*upstream);
+    if (&*hedge == &*upstream) {
+        return;   // nowhere else to send it
+    }
+
+    int pooledSocket = -1;
+    auto acquired = backendPool.acquire(hedge->key, pooledSocket);
+    if (acquired == BackendPool::AcquireResult::Exhausted) {
+        return;
+    }
+    bool reused = acquired == BackendPool::AcquireResult::Reused;
+    bool inProgress = false;
+    if (!reused) {
+        SocketAddress backendAddress;
+        pooledSocket = resolveBackendAddress(*hedge, backendAddress) ? openBackendSocket(backendAddress, inProgress) : -1;
+        if (pooledSocket < 0) {
+            backendPool.cancel(hedge->key);
+            hedge.fail();
+            return;
+        }
+        if (!inProgress) {
+            backendPool.connected(hedge->key);
+        }
+    }
+
+    hedgeSocket = pooledSocket;
+    hedgeReused = reused;
+    hedgeConnecting = inProgress;
+    hedgeUpstream = std::move(hedge);
+    auto self = shared_from_this();
+    if (!loop.add(hedgeSocket, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET,
+                  [self](uint32_t events) { self->onHedgeEvent(events); })) {
+        backendPool.release(hedgeUpstream->key, hedgeSocket, false);
+        hedgeSocket = -1;
+        hedgeUpstream = UpstreamRequest();
+        return;
+    }
+    if (!hedgeConnecting) {
+        sendHedgeRequest();
+    }
+}
+
+// The request fits a fresh socket buffer, so it goes out in one send or not at all
+void ClientConnection::sendHedgeRequest() {
+    std::pmr::string request = buildBackendRequest(*hedgeUpstream, reqInfo, arena.resource());
+    ssize_t sent = send(hedgeSocket, request.data(), request.size(), MSG_NOSIGNAL);
+    if (sent != static_cast<ssize_t>(request.size())) {
+        if (!hedgeReused) {
+            hedgeUpstream.fail();
+        }
+        cancelHedge();
+    }
+}
+
+// The hedge answered before the first backend: serve the response from it
+void ClientConnection::promoteHedge() {
+    if (state != State::ReadingBackend || backendAnswered) {
+        cancelHedge();
+        return;
+    }
+    upstreams.countHedge(true);
+    releaseBackend(false);
+    upstream = std::move(hedgeUpstream);
+    backendSocket = hedgeSocket;
+    backendReused = hedgeReused;
+    hedgeSocket = -1;
+    backendRequest.clear();
+    readBackendResponse();
+}
+
+// Close the hedge connection, if any, and forget the hedge delay
+void ClientConnection::cancelHedge() {
+    if (hedgeTimer != 0) {
+        loop.cancelTimer(hedgeTimer);
+        hedgeTimer = 0;
+    }
+    if (hedgeSocket >= 0) {
+        loop.remove(hedgeSocket);
+        backendPool.release(hedgeUpstream->key, hedgeSocket, false);
+        hedgeSocket = -1;
+    }
+    hedgeUpstream = UpstreamRequest();
+}
+
+// The response broke off after part of it reached the client; closing is the
+// only way left to tell the client
+void ClientConnection::abortRelay() {
+    logRequest(clientIP, logMethod, logPath, 502, waitingTime, processingTimeMs(),
+               waitingTime + processingTimeMs(), "Backend Response Interrupted");
+    recordBackendTotal();
+    cancelHedge();
+    releaseBackend(false);
+    upstream.fail();
+    closeConnection();
+}
+
+// Backend is done: return the socket to the pool, cache the response and
+// finish writing whatever the client has not taken yet
+void ClientConnection::finishBackendResponse(bool reusable) {
+    recordBackendTotal();
+    cancelBackendTimer();
+    cancelHedge();
+    releaseBackend(reusable);
+    upstream.finish(responseParser.statusCode());
+
+    // Cache the backend response if HTTP allows it and it was small enough to keep
+    if (caching) {
+        cache.store(reqInfo, cacheKey, std::move(cacheCopy));
+    }
+    endFetch();
+
+    // A response delimited by EOF forces the client connection to close as well
+    responseStatus = responseParser.statusCode();
+    logMessage = "Served from Backend";
+    closeAfterResponse = !reqInfo.keepAlive || responseParser.delimitedByClose();
+    state = State::WritingResponse;
+    writeResponse();
+}
+
+// Switch to writing a complete response to the client
+void ClientConnection::sendResponse(std::string response, int statusCode, std::string message, bool keepOpen) {
+    endFetch();
+    recordBackendTotal();
+    sendStart = MetricsRegistry::Clock::now();
+    responseBuffer = std::move(response);
+    responseOffset = 0;
+    responseStatus = statusCode;
+    logMessage = std::move(message);
+    closeAfterResponse = !keepOpen;
+    state = State::WritingResponse;
+    writeResponse();
+}
+
+// Write a cached response straight from the buffer shared with the cache
+void ClientConnection::sendCachedResponse(CachedResponse response, bool keepOpen) {
+    sharedResponse = std::move(response);
+    sendResponse(std::string(), 200, "Served from Cache", keepOpen);
+}
+
+// Send an error page, log it under the failing status code and close
+void ClientConnection::sendError(int statusCode, const std::string& message) {
+    sendResponse(generateErrorResponse(statusCode, message), statusCode, message, false);
+}
+
+// Write as much of the response as the socket accepts; close when done
+void ClientConnection::writeResponse() {
+    const std::string& response = sharedResponse ? *sharedResponse : responseBuffer;
+    while (responseOffset < response.size()) {
+        ssize_t sent = send(clientSocket, response.data() + responseOffset,
+                            response.size() - responseOffset, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;  // Wait for EPOLLOUT
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            logRequest(clientIP, "FATAL", "N/A", 500, waitingTime, processingTimeMs(),
+                       waitingTime + processingTimeMs(), "Failed to send response");
+            closeConnection();
+            return;
+        }
+        responseOffset += sent;
+    }
+
+    if (sendStart != MetricsRegistry::Clock::time_point()) {
+        metrics.record(Stage::Send, sendStart);
+        sendStart = MetricsRegistry::Clock::time_point();
+    }
+    long processingTime = processingTimeMs();
+    logRequest(clientIP, logMethod, logPath, responseStatus, waitingTime, processingTime,
+               waitingTime + processingTime, logMessage);
+    ++requestsServed;
+
+    if (closeAfterResponse || requestsServed >= getServerConfig().maxKeepAliveRequests) {
+        closeConnection();
+        return;
+    }
+
+    // Keep the connection open for the next (possibly already pipelined) request
+    requestBuffer.erase(0, reqInfo.length);
+    requestParser.reset();
+    responseBuffer.clear();
+    sharedResponse.reset();
+    responseOffset = 0;
+    RequestArena::forget(backendRequest);
+    RequestArena::forget(cacheKey);
+    arena.reset();
+    backendRequestOffset = 0;
+    upstream = UpstreamRequest();
+    retries = 0;
+    cacheCopy.clear();
+    splicing = false;
+    state = State::ReadingRequest;
+    readRequest();
+}
+
+// Close the connection if the client stays silent for keepAliveTimeout
+void ClientConnection::armIdleTimer() {
+    if (idleTimerArmed) {
+        return;
+    }
+    std::weak_ptr<ClientConnection> weakSelf = shared_from_this();
+    idleTimer = loop.runAfter(getServerConfig().keepAliveTimeout, [weakSelf]() {
+        if (auto self = weakSelf.lock()) {
+            self->idleTimerArmed = false;
+            if (self->state == State::ReadingRequest) {
+                if (self->requestsServed == 0 || !self->requestBuffer.empty()) {
+                    logRequest(self->clientIP, "DISCONNECT", "N/A", 499, self->waitingTime, self->processingTimeMs(),
+                               self->waitingTime + self->processingTimeMs(), "Client Request Timeout");
+                }
+                self->closeConnection();
+            }
+        }
+    });
+    idleTimerArmed = true;
+}
+
+void ClientConnection::cancelIdleTimer() {
+    if (idleTimerArmed) {
+        loop.cancelTimer(idleTimer);
+        idleTimerArmed = false;
+    }
+}
+
+// Account the backend exchange that just ended, if the request had one
+void ClientConnection::recordBackendTotal() {
+    if (backendStart != MetricsRegistry::Clock::time_point()) {
+        metrics.record(Stage::BackendTotal, backendStart);
+        backendStart = MetricsRegistry::Clock::time_point();
+    }
+}
+
+// Hand the backend socket back to the pool, if any. It must leave this loop
+// first since another worker may lease it right away.
+void ClientConnection::releaseBackend(bool reusable) {
+    if (backendSocket >= 0) {
+        loop.remove(backendSocket);
+        backendPool.release(upstream->key, backendSocket, reusable);
+        backendSocket = -1;
+    }
+}
+
+// Bound the current backend phase by the deadline; no timer when it is unbounded
+void ClientConnection::armBackendTimer() {
+    cancelBackendTimer();
+    std::chrono::milliseconds remaining = deadline.remaining();
+    if (remaining.count() == 0) {
+        return;
+    }
+    std::weak_ptr<ClientConnection> weakSelf = shared_from_this();
+    backendTimer = loop.runAfter(remaining, [weakSelf]() {
+        if (auto self = weakSelf.lock()) {
+            self->onBackendTimeout();
+        }
+    });
+}
+
+void ClientConnection::cancelBackendTimer() {
+    if (backendTimer != 0) {
+        loop.cancelTimer(backendTimer);
+        backendTimer = 0;
+    }
+}
+
+// Hedge an idempotent request if it is still unanswered after the hedge delay
+void ClientConnection::armHedgeTimer() {
+    std::chrono::milliseconds delay = upstreams.hedgeDelay();
+    std::chrono::milliseconds remaining = deadline.remaining();
+    if (delay.count() == 0 || hedgeTimer != 0 || !methodIsIdempotent(reqInfo.method) ||
+        (remaining.count() > 0 && remaining <= delay)) {
+        return;
+    }
+    std::weak_ptr<ClientConnection> weakSelf = shared_from_this();
+    hedgeTimer = loop.runAfter(delay, [weakSelf]() {
+        if (auto self = weakSelf.lock()) {
+            self->hedgeTimer = 0;
+            self->startHedge();
+        }
+    });
+}
+
+// Tear down both sockets; the last handler reference frees the connection
+void ClientConnection::closeConnection() {
+    if (state == State::Closed) {
+        return;
+    }
+    if (state == State::WaitingForFetch) {
+        loop.cancelTimer(fetchTimer);
+    }
+    state = State::Closed;
+    cancelIdleTimer();
+    endFetch();
+    cancelBackendTimer();
+    cancelHedge();
+    releaseBackend(false);
+    upstream = UpstreamRequest();
+    if (clientSocket >= 0) {
+        loop.remove(clientSocket);
+        close(clientSocket);
+        clientSocket = -1;
+    }
+
+    long connectionTime = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - acceptedAt).count();
+    recordConnection(clientIP, requestsServed, connectionTime);
+}
+
+long ClientConnection::processingTimeMs() const {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - processingStart).count();
+}
@@ -0,0 +1,138 @@
+#ifndef CONNECTION_H
+#define CONNECTION_H
+
+#include <netinet/in.h>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "EventLoop.h"
+#include "HttpParser.h"
+#include "RequestArena.h"
+#include "Server.h"
+#include "SpliceRelay.h"
+
+// Per-connection state machine driven by an EventLoop.
+// read request -> check cache -> backend I/O -> write response, then back to
+// reading while the client keeps the connection alive. Backend responses are
+// relayed to the client as they arrive rather than buffered whole.
+class ClientConnection : public std::enable_shared_from_this<ClientConnection> {
+public:
+    using Clock = std::chrono::high_resolution_clock;
+
+    ClientConnection(EventLoop& loop, int clientSocket, struct sockaddr_in clientAddress,
+                     Clock::time_point acceptedAt);
+    ~ClientConnection();
+
+    // Register the client socket with the loop and begin reading
+    void start();
+
+private:
+    enum class State {
+        ReadingRequest,
+        WaitingForFetch,        // another request is fetching the same cache key
+        ConnectingBackend,
+        WritingBackend,
+        ReadingBackend,
+        WritingResponse,
+        Closed
+    };
+
+    EventLoop& loop;
+    State state;
+
+    int clientSocket;
+    struct sockaddr_in clientAddress;
+    std::string clientIP;
+
+    int backendSocket;              // Leased from backendPool while >= 0
+    bool backendReused;             // Socket came from the idle keep-alive pool
+    UpstreamRequest upstream;       // Backend chosen for the request; kept across retries
+    BackendDeadline deadline;       // Phases of the request to the backends
+    EventLoop::TimerId backendTimer;  // Ends the current phase at its deadline; 0 when not armed
+    int retries;                    // Attempts repeated on another backend for this request
+    bool backendAnswered;           // Some of the response arrived on backendSocket
+    MetricsRegistry::Clock::time_point backendStart;  // First attempt of the request; unset when none
+
+    // The request also sent to a second backend while the first is slow to answer
+    int hedgeSocket;                // Leased from backendPool while >= 0
+    bool hedgeReused;
+    bool hedgeConnecting;
+    UpstreamRequest hedgeUpstream;
+    EventLoop::TimerId hedgeTimer;  // Starts the hedge after the hedge delay; 0 when not armed
+    RequestArena arena;             // Scratch memory of the request being served; reset between requests
+    std::pmr::string backendRequest;  // Request being written to the backend, in arena
+    size_t backendRequestOffset;
+    HttpResponseParser responseParser;  // Frames the response while it is relayed
+    std::pmr::string cacheKey;      // HttpCache key of the request being served, in arena
+    bool fetchLeader;               // This request fetches cacheKey for coalesced waiters
+    EventLoop::TimerId fetchTimer;  // Bounds WaitingForFetch
+    std::string cacheCopy;          // Relayed bytes, kept while the response fits maxCacheableSize
+    bool caching;
+    SpliceRelay splice;             // Zero-copy path for opaque bodies that are not cached
+    bool splicing;
+
+    std::string requestBuffer;      // Raw bytes read from the client; may hold pipelined requests
+    HttpRequestParser requestParser;
+    RequestInfo reqInfo;            // Views into requestBuffer
+
+    std::string responseBuffer;     // Response being written to the client
+    CachedResponse sharedResponse;  // Cache hit being written instead, shared with the cache
+    size_t responseOffset;
+    MetricsRegistry::Clock::time_point sendStart;     // A whole response was queued; unset while relaying
+    int responseStatus;
+    bool closeAfterResponse;
+    std::string logMethod;
+    std::string logPath;
+    std::string logMessage;
+
+    int requestsServed;             // Requests answered on this connection
+    EventLoop::TimerId idleTimer;
+    bool idleTimerArmed;
+
+    Clock::time_point acceptedAt;
+    Clock::time_point processingStart;
+    long waitingTime;
+
+    // Event handlers
+    void onClientEvent(uint32_t events);
+    void onBackendEvent(uint32_t events);
+    void onHedgeEvent(uint32_t events);
+    void onBackendTimeout();
+
+    // State transitions
+    void readRequest();
+    void processRequest();
+    void resumeAfterFetch();
+    void serveFromCache(HttpCache::Lookup cached);
+    void endFetch();
+    void startBackendRequest();
+    void finishBackendConnect();
+    void writeBackendRequest();
+    void readBackendResponse();
+    bool flushRelay();
+    void relayBody();
+    void finishBackendResponse(bool reusable);
+    void retryOrFail(int statusCode, const std::string& message);
+    void startHedge();
+    void sendHedgeRequest();
+    void promoteHedge();
+    void cancelHedge();
+    void abortRelay();
+    void sendResponse(std::string response, int statusCode, std::string message, bool keepOpen);
+    void sendCachedResponse(CachedResponse response, bool keepOpen);
+    void sendError(int statusCode, const std::string& message);
+    void writeResponse();
+
+    void armIdleTimer();
+    void cancelIdleTimer();
+    void releaseBackend(bool reusable);
+    void recordBackendTotal();
+    void armBackendTimer();
+    void cancelBackendTimer();
+    void armHedgeTimer();
+    void closeConnection();
+    long processingTimeMs() const;
+};
+
+#endif // CONNECTION_H
@@ -0,0 +1,135 @@
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <optional>
+#include <utility>
+#include "BlockPool.h"
+
+// Lazily started coroutine returning T. `co_await` on an Async runs it to
+// completion and yields its result (or rethrows its exception); the awaiting
+// coroutine is resumed directly when it finishes, without going through the
+// loop. A top-level coroutine is started with detach() and frees itself.
+template <typename T>
+class Async;
+
+namespace detail {
+
+template <typename T>
+struct AsyncPromiseBase {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr exception;
+    bool detached = false;
+
+    // Frames, with the socket buffers they hold, come from the thread's block
+    // pool: a connection allocates the same few frame sizes for every request
+    static void* operator new(size_t bytes) { return BlockPool::allocate(bytes); }
+    static void operator delete(void* frame, size_t bytes) noexcept { BlockPool::deallocate(frame, bytes); }
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            auto& promise = handle.promise();
+            if (promise.detached) {
+                // Nobody will read the result; an escaped exception ends the program as it would a thread
+                if (promise.exception) {
+                    std::rethrow_exception(promise.exception);
+                }
+                handle.destroy();
+                return std::noop_coroutine();
+            }
+            return promise.continuation ? promise.continuation : std::noop_coroutine();
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() { exception = std::current_exception(); }
+};
+
+template <typename T>
+struct AsyncPromise : AsyncPromiseBase<T> {
+    std::optional<T> value;
+
+    Async<T> get_return_object();
+    template <typename U>
+    void return_value(U&& result) { value.emplace(std::forward<U>(result)); }
+
+    T result() {
+        if (this->exception) {
+            std::rethrow_exception(this->exception);
+        }
+        return std::move(*value);
+    }
+};
+
+template <>
+struct AsyncPromise<void> : AsyncPromiseBase<void> {
+    Async<void> get_return_object();
+    void return_void() {}
+
+    void result() {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+};
+
+} // namespace detail
+
+template <typename T = void>
+class [[nodiscard]] Async {
+public:
+    using promise_type = detail::AsyncPromise<T>;
+
+    explicit Async(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+    Async(Async&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    Async(const Async&) = delete;
+    Async& operator=(const Async&) = delete;
+    ~Async() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+
+    T await_resume() { return handle.promise().result(); }
+
+    // Start the coroutine; it runs until its first suspension and destroys itself when done
+    void detach() {
+        auto started = std::exchange(handle, nullptr);
+        started.promise().detached = true;
+        started.resume();
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+};
+
+namespace detail {
+
+template <typename T>
+Async<T> AsyncPromise<T>::get_return_object() {
+    return Async<T>(std::coroutine_handle<AsyncPromise<T>>::from_promise(*this));
+}
+
+inline Async<void> AsyncPromise<void>::get_return_object() {
+    return Async<void>(std::coroutine_handle<AsyncPromise<void>>::from_promise(*this));
+}
+
+} // namespace detail
+
+#endif // COROUTINE_H
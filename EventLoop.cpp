@@ -0,0 +1,198 @@
+#include "EventLoop.h"
+#include "Logger.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+// Constructor: create the epoll instance and the wakeup eventfd
+EventLoop::EventLoop()
+    : epollFd(-1), wakeupFd(-1), running(false), handlers(&nodePool), nextTimerId(1),
+      timers(&nodePool), timerDeadlines(&nodePool) {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) {
+        throw std::runtime_error(std::string("epoll_create1 failed: ") + strerror(errno));
+    }
+
+    wakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeupFd < 0) {
+        close(epollFd);
+        throw std::runtime_error(std::string("eventfd failed: ") + strerror(errno));
+    }
+
+    struct epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = wakeupFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeupFd, &ev);
+}
+
+// Destructor: release the kernel objects owned by the loop
+EventLoop::~EventLoop() {
+    close(wakeupFd);
+    close(epollFd);
+}
+
+// Register a descriptor and the handler invoked for its events
+bool EventLoop::add(int fd, uint32_t events, Handler handler) {
+    struct epoll_event ev{};
+    ev.events = events;
+    ev.data.fd = fd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        logError("epoll_ctl ADD failed", strerror(errno));
+        return false;
+    }
+    handlers[fd] = std::allocate_shared<Handler>(std::pmr::polymorphic_allocator<Handler>(&nodePool),
+                                                 std::move(handler));
+    return true;
+}
+
+// Change the event mask of a registered descriptor
+bool EventLoop::modify(int fd, uint32_t events) {
+    struct epoll_event ev{};
+    ev.events = events;
+    ev.data.fd = fd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev) < 0) {
+        logError("epoll_ctl MOD failed", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+// Unregister a descriptor; pending events for it in the current batch are dropped
+void EventLoop::remove(int fd) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    handlers.erase(fd);
+}
+
+// Queue a task for the loop thread and wake it up
+void EventLoop::post(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        pendingTasks.push_back(std::move(task));
+    }
+    wakeup();
+}
+
+// Schedule a one-shot timer (must be called on the loop thread)
+EventLoop::TimerId EventLoop::runAfter(std::chrono::milliseconds delay, std::function<void()> callback) {
+    TimerId id = nextTimerId++;
+    auto deadline = Clock::now() + delay;
+    timers.emplace(std::make_pair(deadline, id), std::move(callback));
+    timerDeadlines[id] = deadline;
+    return id;
+}
+
+// Cancel a pending timer (must be called on the loop thread)
+void EventLoop::cancelTimer(TimerId id) {
+    auto it = timerDeadlines.find(id);
+    if (it == timerDeadlines.end()) {
+        return;
+    }
+    timers.erase(std::make_pair(it->second, id));
+    timerDeadlines.erase(it);
+}
+
+// Install the hook run before each epoll_wait (must be called on the loop thread)
+void EventLoop::setBeforeWait(std::function<void()> hook) {
+    beforeWait = std::move(hook);
+}
+
+// Main reactor loop
+void EventLoop::run() {
+    loopThreadId = std::this_thread::get_id();
+    running = true;
+
+    std::vector<struct epoll_event> events(256);
+    while (running) {
+        if (beforeWait) {
+            beforeWait();
+        }
+        int ready = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), nextTimeoutMs());
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            logError("epoll_wait failed", strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < ready; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == wakeupFd) {
+                uint64_t counter;
+                while (read(wakeupFd, &counter, sizeof(counter)) > 0) {}
+                continue;
+            }
+
+            auto it = handlers.find(fd);
+            if (it == handlers.end()) {
+                continue;  // Removed by an earlier handler in this batch
+            }
+            // Hold a reference so the handler may safely remove itself
+            std::shared_ptr<Handler> handler = it->second;
+            (*handler)(events[i].events);
+        }
+
+        runExpiredTimers();
+        runPendingTasks();
+
+        // Grow the event buffer when the loop is saturated
+        if (ready == static_cast<int>(events.size())) {
+            events.resize(events.size() * 2);
+        }
+    }
+}
+
+// Request the loop to exit after the current iteration
+void EventLoop::stop() {
+    running = false;
+    wakeup();
+}
+
+bool EventLoop::isInLoopThread() const {
+    return loopThreadId == std::this_thread::get_id();
+}
+
+// Milliseconds until the earliest timer, or -1 to block indefinitely
+int EventLoop::nextTimeoutMs() const {
+    if (timers.empty()) {
+        return -1;
+    }
+    auto delta = timers.begin()->first.first - Clock::now();
+    if (delta <= Clock::duration::zero()) {
+        return 0;
+    }
+    // Round up so the timer has expired when we wake
+    return static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(delta).count());
+}
+
+// Fire every timer whose deadline has passed
+void EventLoop::runExpiredTimers() {
+    auto now = Clock::now();
+    while (!timers.empty() && timers.begin()->first.first <= now) {
+        auto node = timers.extract(timers.begin());
+        timerDeadlines.erase(node.key().second);
+        node.mapped()();
+    }
+}
+
+// Drain tasks posted from other threads; both vectors keep their capacity across rounds
+void EventLoop::runPendingTasks() {
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        runningTasks.swap(pendingTasks);
+    }
+    for (auto& task : runningTasks) {
+        task();
+    }
+    runningTasks.clear();
+}
+
+// Interrupt epoll_wait from another thread
+void EventLoop::wakeup() {
+    uint64_t one = 1;
+    ssize_t written = write(wakeupFd, &one, sizeof(one));
+    (void)written;
+}
@@ -0,0 +1,88 @@
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Single-threaded epoll reactor. Each worker thread owns one loop and every
+// socket registered with it is only ever touched from that thread.
+class EventLoop {
+public:
+    using Handler = std::function<void(uint32_t events)>;
+    using TimerId = uint64_t;
+
+    EventLoop();
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // Register a file descriptor with the given epoll event mask
+    bool add(int fd, uint32_t events, Handler handler);
+
+    // Change the event mask of an already registered descriptor
+    bool modify(int fd, uint32_t events);
+
+    // Stop watching a descriptor (does not close it)
+    void remove(int fd);
+
+    // Queue a task to run on the loop thread; safe to call from any thread
+    void post(std::function<void()> task);
+
+    // Schedule a one-shot callback on the loop thread
+    TimerId runAfter(std::chrono::milliseconds delay, std::function<void()> callback);
+
+    // Cancel a pending timer; no-op if it already fired
+    void cancelTimer(TimerId id);
+
+    // Run hook on the loop thread right before each wait for events
+    void setBeforeWait(std::function<void()> hook);
+
+    // Run the loop on the calling thread until stop() is called
+    void run();
+
+    // Ask the loop to exit; safe to call from any thread
+    void stop();
+
+    bool isInLoopThread() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    int epollFd;
+    int wakeupFd;                                                  // eventfd used by post() and stop()
+    std::atomic<bool> running;
+    std::thread::id loopThreadId;
+
+    // Handler and timer nodes come and go with every request; only the loop
+    // thread touches them, so they are recycled through size-classed free
+    // lists without locking instead of going through malloc
+    std::pmr::unsynchronized_pool_resource nodePool;
+
+    std::pmr::unordered_map<int, std::shared_ptr<Handler>> handlers;   // fd -> event handler
+
+    std::mutex pendingMutex;                                       // Protects pendingTasks
+    std::vector<std::function<void()>> pendingTasks;               // Tasks posted from other threads
+    std::vector<std::function<void()>> runningTasks;               // Swapped with pendingTasks to run them
+
+    TimerId nextTimerId;
+    std::pmr::map<std::pair<Clock::time_point, TimerId>, std::function<void()>> timers;
+    std::pmr::unordered_map<TimerId, Clock::time_point> timerDeadlines; // id -> deadline, for cancellation
+    std::function<void()> beforeWait;
+
+    int nextTimeoutMs() const;
+    void runExpiredTimers();
+    void runPendingTasks();
+    void wakeup();
+};
+
+#endif // EVENTLOOP_H
@@ -0,0 +1,526 @@
+#include "HttpCache.h"
+#include <time.h>
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+
+// Statuses a shared cache may store (RFC 9110, section 15.1)
+static bool isCacheableStatus(int status) {
+    switch (status) {
+        case 200: case 203: case 204: case 300: case 301: case 308:
+        case 404: case 405: case 410: case 414: case 501:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool isCacheableMethod(std::string_view method) {
+    return method == "GET" || method == "HEAD";
+}
+
+// Bytes an entry costs besides its key
+size_t cachedSize(const CachedEntry& entry) {
+    // The entry's own copy of its key and its node on the expiry wheel count too
+    size_t size = sizeof(CachedEntry) + entry.key.size() + sizeof(ExpirySlot::value_type) + 2 * sizeof(void*) +
+                  (entry.response ? entry.response->size() : 0);
+    for (const auto& name : entry.vary) {
+        size += name.size();
+    }
+    return size;
+}
+
+CachedEntry::~CachedEntry() {
+    if (scheduledOn != nullptr) {
+        scheduledOn->unschedule(*this);
+    }
+}
+
+static std::string toLower(std::string_view value) {
+    std::string lower(value);
+    for (char& c : lower) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return lower;
+}
+
+static bool isUnreserved(unsigned char c) {
+    return std::isalnum(c) || c == '-' || c == '.' || c == '_' || c == '~';
+}
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Normalize a request target for use in a key: drop any scheme, authority and
+// fragment, decode escaped unreserved characters, uppercase the remaining
+// escapes and resolve "." and ".." segments. The query is kept as sent. The
+// result and the scratch on the way are allocated from `memory`.
+static void appendNormalizedPath(std::pmr::string& normalized, std::string_view target,
+                                 std::pmr::memory_resource* memory) {
+    size_t fragment = target.find('#');
+    if (fragment != std::string_view::npos) {
+        target = target.substr(0, fragment);
+    }
+    size_t scheme = target.find("://");
+    if (scheme != std::string_view::npos && scheme < target.find('/')) {
+        size_t pathStart = target.find('/', scheme + 3);
+        target = pathStart == std::string_view::npos ? std::string_view("/") : target.substr(pathStart);
+    }
+
+    std::pmr::string decoded(memory);
+    decoded.reserve(target.size());
+    for (size_t i = 0; i < target.size(); ++i) {
+        int high = i + 2 < target.size() && target[i] == '%' ? hexValue(target[i + 1]) : -1;
+        int low = high >= 0 ? hexValue(target[i + 2]) : -1;
+        if (low < 0) {
+            decoded += target[i];
+            continue;
+        }
+        unsigned char value = static_cast<unsigned char>(high * 16 + low);
+        if (isUnreserved(value)) {
+            decoded += static_cast<char>(value);
+        } else {
+            decoded += '%';
+            decoded += static_cast<char>(std::toupper(static_cast<unsigned char>(target[i + 1])));
+            decoded += static_cast<char>(std::toupper(static_cast<unsigned char>(target[i + 2])));
+        }
+        i += 2;
+    }
+
+    std::string_view path = decoded;
+    std::string_view query;
+    size_t queryStart = path.find('?');
+    if (queryStart != std::string_view::npos) {
+        query = path.substr(queryStart);
+        path = path.substr(0, queryStart);
+    }
+
+    // Resolve dot segments
+    std::pmr::vector<std::string_view> segments(memory);
+    bool trailingSlash = path.empty() || path.back() == '/';
+    size_t pos = 0;
+    while (pos <= path.size()) {
+        size_t slash = path.find('/', pos);
+        std::string_view segment = path.substr(pos, slash == std::string_view::npos ? std::string_view::npos : slash - pos);
+        if (segment == "..") {
+            if (!segments.empty()) segments.pop_back();
+            trailingSlash = slash == std::string_view::npos || trailingSlash;
+        } else if (segment == ".") {
+            trailingSlash = slash == std::string_view::npos || trailingSlash;
+        } else if (!segment.empty()) {
+            segments.push_back(segment);
+        }
+        if (slash == std::string_view::npos) break;
+        pos = slash + 1;
+    }
+
+    size_t start = normalized.size();
+    for (std::string_view segment : segments) {
+        normalized += '/';
+        normalized += segment;
+    }
+    if (normalized.size() == start || trailingSlash) {
+        normalized += '/';
+    }
+    normalized += query;
+}
+
+// Parse an HTTP-date in the preferred IMF-fixdate form
+static bool parseHttpDate(std::string_view value, std::chrono::system_clock::time_point& time) {
+    std::string text(trim(value));
+    struct tm parts{};
+    const char* end = strptime(text.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &parts);
+    if (end == nullptr || *end != '\0') {
+        return false;
+    }
+    time = std::chrono::system_clock::from_time_t(timegm(&parts));
+    return true;
+}
+
+// Parse delta-seconds, tolerating quotes
+static bool parseSeconds(std::string_view value, long long& seconds) {
+    value = trim(value);
+    if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+        value = value.substr(1, value.size() - 2);
+    }
+    auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), seconds);
+    return error == std::errc() && end == value.data() + value.size() && seconds >= 0;
+}
+
+// Cache-Control directives that matter to a shared cache
+struct CacheControl {
+    bool noStore = false;
+    bool noCache = false;
+    bool isPrivate = false;
+    long long maxAge = -1;
+    long long sMaxAge = -1;
+    long long staleWhileRevalidate = -1;
+};
+
+static void parseCacheControl(std::string_view value, CacheControl& directives) {
+    while (!value.empty()) {
+        size_t comma = value.find(',');
+        std::string_view directive = trim(value.substr(0, comma));
+        value = comma == std::string_view::npos ? std::string_view() : value.substr(comma + 1);
+
+        size_t equals = directive.find('=');
+        std::string_view name = trim(directive.substr(0, equals));
+        std::string_view argument = equals == std::string_view::npos ? std::string_view() : directive.substr(equals + 1);
+
+        long long seconds = 0;
+        if (iequals(name, "no-store")) {
+            directives.noStore = true;
+        } else if (iequals(name, "no-cache")) {
+            directives.noCache = true;
+        } else if (iequals(name, "private")) {
+            directives.isPrivate = true;
+        } else if (iequals(name, "max-age") && parseSeconds(argument, seconds)) {
+            directives.maxAge = seconds;
+        } else if (iequals(name, "s-maxage") && parseSeconds(argument, seconds)) {
+            directives.sMaxAge = seconds;
+        } else if (iequals(name, "stale-while-revalidate") && parseSeconds(argument, seconds)) {
+            directives.staleWhileRevalidate = seconds;
+        }
+    }
+}
+
+// Split a raw response into its status code and header fields
+static bool parseResponseHead(std::string_view response, int& status,
+                              std::vector<std::pair<std::string_view, std::string_view>>& headers) {
+    size_t headEnd = response.find("\r\n\r\n");
+    if (headEnd == std::string_view::npos || response.size() < 12) {
+        return false;
+    }
+    auto [ptr, error] = std::from_chars(response.data() + 9, response.data() + 12, status);
+    if (error != std::errc()) {
+        return false;
+    }
+
+    size_t pos = response.find("\r\n") + 2;
+    while (pos < headEnd) {
+        size_t next = response.find("\r\n", pos);
+        std::string_view line = response.substr(pos, next - pos);
+        pos = next + 2;
+        size_t colon = line.find(':');
+        if (colon != std::string_view::npos) {
+            headers.emplace_back(trim(line.substr(0, colon)), trim(line.substr(colon + 1)));
+        }
+    }
+    return true;
+}
+
+static int64_t toMilliseconds(std::chrono::steady_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+}
+
+HttpCache::HttpCache(const HttpCacheConfig& config)
+    : config(config),
+      wheel(wheelSlots),
+      wheelPosition(0),
+      wheelTime(Clock::now()),
+      nextTick(toMilliseconds(wheelTime + std::chrono::seconds(1))),
+      entries(config.limits, config.shardCount, config.policy) {}
+
+std::pmr::string HttpCache::primaryKey(std::string_view method, std::string_view host, std::string_view path,
+                                       std::pmr::memory_resource* memory) {
+    std::pmr::string key(memory);
+    key.reserve(method.size() + host.size() + path.size() + 2);
+    key.append(method);
+    key += ' ';
+    for (char c : host) {
+        key += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    appendNormalizedPath(key, path, memory);
+    return key;
+}
+
+bool HttpCache::requestAllowsStore(const RequestInfo& request) {
+    if (!isCacheableMethod(request.method) || !request.header("Authorization").empty()) {
+        return false;
+    }
+    CacheControl directives;
+    parseCacheControl(request.header("Cache-Control"), directives);
+    return !directives.noStore;
+}
+
+bool HttpCache::requestAllowsLookup(const RequestInfo& request) {
+    if (!isCacheableMethod(request.method)) {
+        return false;
+    }
+
+    // A client asking for revalidation gets a fresh copy from the backend
+    CacheControl directives;
+    std::string_view cacheControl = request.header("Cache-Control");
+    parseCacheControl(cacheControl, directives);
+    return !(directives.noCache || directives.noStore || directives.maxAge == 0 ||
+             (cacheControl.empty() && icontains(request.header("Pragma"), "no-cache")));
+}
+
+HttpCache::Lookup HttpCache::lookup(const RequestInfo& request, std::string_view key) {
+    Lookup result;
+    if (!requestAllowsLookup(request)) {
+        return result;
+    }
+
+    Clock::time_point now = Clock::now();
+    if (toMilliseconds(now) >= nextTick.load(std::memory_order_relaxed)) {
+        advance(now);
+    }
+
+    EntryPtr entry = find(key, now);
+    if (entry && !entry->vary.empty()) {
+        // The variant key only lives for the lookup; build it on the stack
+        char scratch[512];
+        std::pmr::monotonic_buffer_resource memory(scratch, sizeof(scratch));
+        entry = find(variantKey(key, entry->vary, request, &memory), now);
+    }
+    if (!entry) {
+        return result;
+    }
+
+    // Past its freshness but within stale-while-revalidate: serve it, and let
+    // only the lookup that wins the fetch refresh it
+    result.response = entry->response;
+    if (entry->expiresAt <= now) {
+        result.revalidate = beginFetch(key, nullptr);
+    }
+    return result;
+}
+
+bool HttpCache::store(const RequestInfo& request, std::string_view key, std::string response) {
+    if (!requestAllowsStore(request)) {
+        return false;
+    }
+
+    int status = 0;
+    std::vector<std::pair<std::string_view, std::string_view>> headers;
+    if (!parseResponseHead(response, status, headers) || !isCacheableStatus(status)) {
+        return false;
+    }
+
+    CacheControl directives;
+    std::string_view expires;
+    std::string_view date;
+    long long age = 0;
+    bool hasExpires = false;
+    bool setsCookie = false;
+    std::vector<std::string> vary;
+    for (const auto& [name, value] : headers) {
+        if (iequals(name, "Cache-Control")) {
+            parseCacheControl(value, directives);
+        } else if (iequals(name, "Expires")) {
+            expires = value;
+            hasExpires = true;
+        } else if (iequals(name, "Date")) {
+            date = value;
+        } else if (iequals(name, "Age")) {
+            parseSeconds(value, age);
+        } else if (iequals(name, "Set-Cookie")) {
+            setsCookie = true;
+        } else if (iequals(name, "Vary")) {
+            std::string_view list = value;
+            while (!list.empty()) {
+                size_t comma = list.find(',');
+                std::string_view field = trim(list.substr(0, comma));
+                list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+                if (field == "*") {
+                    return false;  // Varies on things we cannot see
+                }
+                if (!field.empty()) {
+                    vary.push_back(toLower(field));
+                }
+            }
+        }
+    }
+    if (directives.noStore || directives.isPrivate || directives.noCache || setsCookie) {
+        return false;
+    }
+
+    // Freshness lifetime: s-maxage, then max-age, then Expires relative to Date
+    long long lifetime = config.defaultTtl.count();
+    if (directives.sMaxAge >= 0) {
+        lifetime = directives.sMaxAge;
+    } else if (directives.maxAge >= 0) {
+        lifetime = directives.maxAge;
+    } else if (hasExpires) {
+        std::chrono::system_clock::time_point expiresAt;
+        std::chrono::system_clock::time_point generatedAt = std::chrono::system_clock::now();
+        if (!parseHttpDate(expires, expiresAt)) {
+            return false;  // An invalid Expires means already expired
+        }
+        parseHttpDate(date, generatedAt);
+        lifetime = std::chrono::duration_cast<std::chrono::seconds>(expiresAt - generatedAt).count();
+    }
+    lifetime = std::min<long long>(lifetime - age, config.maxTtl.count());
+    if (lifetime <= 0) {
+        return false;
+    }
+    long long staleLifetime = directives.staleWhileRevalidate >= 0 ? directives.staleWhileRevalidate
+                                                                    : config.staleWhileRevalidate.count();
+
+    auto entry = std::make_shared<CachedEntry>();
+    entry->response = std::make_shared<const std::string>(std::move(response));
+    entry->expiresAt = Clock::now() + std::chrono::seconds(lifetime);
+    entry->staleUntil = entry->expiresAt + std::chrono::seconds(staleLifetime);
+
+    if (vary.empty()) {
+        entry->key = key;
+        entries.put(entry->key, entry);
+        schedule(entry);
+        return true;
+    }
+
+    // Variants live under their own keys; the marker tells lookups which headers to add
+    entry->key = variantKey(key, vary, request, std::pmr::get_default_resource());
+    auto marker = std::make_shared<CachedEntry>();
+    marker->key = key;
+    marker->vary = std::move(vary);
+    marker->expiresAt = entry->expiresAt;
+    marker->staleUntil = entry->staleUntil;
+    entries.put(entry->key, entry);
+    entries.put(marker->key, marker);
+    schedule(entry);
+    schedule(marker);
+    return true;
+}
+
+CacheStats HttpCache::stats() const {
+    return entries.stats();
+}
+
+std::pmr::string HttpCache::variantKey(std::string_view key, const std::vector<std::string>& vary,
+                                       const RequestInfo& request, std::pmr::memory_resource* memory) {
+    std::pmr::string variant(key, memory);
+    for (const auto& name : vary) {
+        variant += '\n';
+        variant += name;
+        variant += ':';
+        variant += trim(request.header(name));
+    }
+    return variant;
+}
+
+bool HttpCache::beginFetch(std::string_view key, std::function<void()> onDone) {
+    std::lock_guard<std::mutex> lock(flightMutex);
+    auto flight = flights.find(key);
+    if (flight == flights.end()) {
+        flights.emplace(key, std::make_shared<Flight>());
+        return true;
+    }
+    if (onDone) {
+        flight->second->waiters.push_back(std::move(onDone));
+    }
+    return false;
+}
+
+bool HttpCache::beginFetchOrWait(std::string_view key, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(flightMutex);
+    auto position = flights.find(key);
+    if (position == flights.end()) {
+        flights.emplace(key, std::make_shared<Flight>());
+        return true;
+    }
+    std::shared_ptr<Flight> flight = position->second;
+    flight->finished.wait_for(lock, timeout, [&flight]() { return flight->done; });
+    return false;
+}
+
+void HttpCache::finishFetch(std::string_view key) {
+    std::shared_ptr<Flight> flight;
+    {
+        std::lock_guard<std::mutex> lock(flightMutex);
+        auto position = flights.find(key);
+        if (position == flights.end()) {
+            return;
+        }
+        flight = std::move(position->second);
+        flights.erase(position);
+        flight->done = true;
+    }
+    flight->finished.notify_all();
+    for (auto& waiter : flight->waiters) {
+        waiter();
+    }
+}
+
+// Entry under key if it may still be served; expired ones are dropped on the way
+HttpCache::EntryPtr HttpCache::find(std::string_view key, Clock::time_point now) {
+    EntryPtr entry;
+    if (!entries.get(key, entry)) {
+        return nullptr;
+    }
+    if (entry->staleUntil <= now) {
+        entries.erase(key, entry);
+        return nullptr;
+    }
+    return entry;
+}
+
+// Slot that turns once the entry has expired, or the last one ahead for expiries
+// beyond one turn of the wheel; they move on when it comes up early
+size_t HttpCache::slotFor(const CachedEntry& entry) const {
+    auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(entry.staleUntil - wheelTime).count();
+    size_t ticks = delay <= 1000 ? 0 : static_cast<size_t>((delay + 999) / 1000 - 1);
+    ticks = std::min(ticks, wheelSlots - 1);
+    return (wheelPosition + ticks) % wheelSlots;
+}
+
+// Put the entry on the wheel; it stays there until it is destroyed
+void HttpCache::schedule(const EntryPtr& entry) {
+    std::lock_guard<std::mutex> lock(wheelMutex);
+    entry->wheelSlot = slotFor(*entry);
+    ExpirySlot& slot = wheel[entry->wheelSlot];
+    entry->wheelItem = slot.insert(slot.end(), entry.get());
+    entry->scheduledOn = this;
+}
+
+// Take a dying entry off the wheel
+void HttpCache::unschedule(const CachedEntry& entry) {
+    std::lock_guard<std::mutex> lock(wheelMutex);
+    wheel[entry.wheelSlot].erase(entry.wheelItem);
+}
+
+// Turn the wheel up to now and drop what expired. Only one thread turns it at
+// a time; the others carry on rather than wait.
+void HttpCache::advance(Clock::time_point now) {
+    // References taken under the wheel lock are only dropped once it is released:
+    // dropping the last one destroys the entry, which takes the lock to unschedule it
+    std::vector<EntryPtr> expired;
+    std::vector<EntryPtr> later;
+    {
+        std::unique_lock<std::mutex> lock(wheelMutex, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            return;
+        }
+        for (size_t turned = 0; wheelTime + std::chrono::seconds(1) <= now && turned < wheelSlots; ++turned) {
+            for (const CachedEntry* item : wheel[wheelPosition]) {
+                EntryPtr entry = item->weak_from_this().lock();
+                if (entry) {
+                    (entry->staleUntil <= now ? expired : later).push_back(std::move(entry));
+                }
+                // Otherwise it is being destroyed and unschedules itself once the lock is free
+            }
+            wheelPosition = (wheelPosition + 1) % wheelSlots;
+            wheelTime += std::chrono::seconds(1);
+        }
+        if (wheelTime + std::chrono::seconds(1) <= now) {
+            wheelTime = now;  // Idle for more than a turn; every slot was just processed
+        }
+        nextTick.store(toMilliseconds(wheelTime + std::chrono::seconds(1)), std::memory_order_relaxed);
+
+        for (const EntryPtr& entry : later) {
+            ExpirySlot& from = wheel[entry->wheelSlot];
+            entry->wheelSlot = slotFor(*entry);
+            wheel[entry->wheelSlot].splice(wheel[entry->wheelSlot].end(), from, entry->wheelItem);
+        }
+    }
+
+    // Expired entries stay on their slot until the cache lets go of them
+    for (const EntryPtr& entry : expired) {
+        entries.erase(entry->key, entry);
+    }
+}
@@ -0,0 +1,156 @@
+#ifndef HTTPCACHE_H
+#define HTTPCACHE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "HttpParser.h"
+#include "Lrucache.h"
+
+// Cached responses are immutable and shared: a hit hands out a reference
+// instead of copying the bytes, and eviction never frees a response in flight
+using CachedResponse = std::shared_ptr<const std::string>;
+
+class HttpCache;
+struct CachedEntry;
+
+// One slot of the expiry wheel: the entries due to expire in that second
+using ExpirySlot = std::list<const CachedEntry*>;
+
+// One slot of the HTTP cache: a stored response, or a marker recording which
+// request headers select between the variants of a response that sent Vary.
+// An entry sits on its cache's expiry wheel for as long as it lives, so one
+// evicted or replaced leaves the wheel with its last reference.
+struct CachedEntry : std::enable_shared_from_this<CachedEntry> {
+    CachedResponse response;                    // null for a Vary marker
+    std::vector<std::string> vary;              // lowercase request header names
+    std::chrono::steady_clock::time_point expiresAt;
+    std::chrono::steady_clock::time_point staleUntil;   // may be served while revalidating until then
+    std::string key;                            // key it is stored under, to drop it once expired
+
+    // Where it is on the wheel; owned by the cache under its wheel lock
+    mutable HttpCache* scheduledOn = nullptr;
+    mutable size_t wheelSlot = 0;
+    mutable ExpirySlot::iterator wheelItem;
+
+    CachedEntry() = default;
+    CachedEntry(const CachedEntry&) = delete;
+    CachedEntry& operator=(const CachedEntry&) = delete;
+    ~CachedEntry();
+};
+
+size_t cachedSize(const CachedEntry& entry);
+
+// Limits and freshness defaults of the HTTP cache
+struct HttpCacheConfig {
+    CacheLimits limits;
+    size_t shardCount = 16;
+    EvictionPolicy policy = EvictionPolicy::WTinyLFU;
+    std::chrono::seconds defaultTtl{60};        // for cacheable responses without explicit freshness; 0 disables
+    std::chrono::seconds maxTtl{24 * 60 * 60};  // upper bound on any freshness lifetime
+    std::chrono::seconds staleWhileRevalidate{0};  // default when the response sets none; 0 disables
+};
+
+// Shared HTTP cache following RFC 9111 for a proxy: only GET and HEAD
+// responses with cacheable statuses are stored, for the lifetime given by
+// Cache-Control (s-maxage, max-age) or Expires minus Age, and never when either
+// side says no-store or private. Keys combine method, upstream host and the
+// normalized path, plus the request headers the response Varies on.
+// Expired entries are dropped lazily on lookup and by a one-second timer wheel.
+//
+// Concurrent misses for one key are coalesced: the first request fetches
+// (beginFetch returns true) and the others wait for it to call finishFetch,
+// then look the key up again. A stale entry inside its stale-while-revalidate
+// window is still served, and exactly one of those lookups is asked to refresh it.
+class HttpCache {
+public:
+    // Result of a lookup
+    struct Lookup {
+        CachedResponse response;    // null on a miss
+        bool revalidate = false;    // response is stale; the caller now owns the key's
+                                    // fetch and must refresh it, then call finishFetch
+    };
+
+    explicit HttpCache(const HttpCacheConfig& config);
+
+    // Key for the request before Vary is applied, built in `memory` (usually the request's arena)
+    static std::pmr::string primaryKey(std::string_view method, std::string_view host, std::string_view path,
+                                       std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+    // Whether a response to this request may be stored at all
+    static bool requestAllowsStore(const RequestInfo& request);
+
+    // Whether the request may be answered from the cache; false when the
+    // client asks for revalidation
+    static bool requestAllowsLookup(const RequestInfo& request);
+
+    // Fresh (or revalidating stale) response for the request
+    Lookup lookup(const RequestInfo& request, std::string_view key);
+
+    // Store a complete response if its status and headers allow it
+    bool store(const RequestInfo& request, std::string_view key, std::string response);
+
+    // Become the one request fetching key and return true, or return false and
+    // have onDone (if any) run on the fetching thread once it finishes
+    bool beginFetch(std::string_view key, std::function<void()> onDone);
+
+    // Blocking variant: return true to become the fetcher, or wait up to
+    // timeout for the current one to finish and return false
+    bool beginFetchOrWait(std::string_view key, std::chrono::milliseconds timeout);
+
+    // The fetcher is done, successful or not; wake everyone waiting on key
+    void finishFetch(std::string_view key);
+
+    CacheStats stats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+    using EntryPtr = std::shared_ptr<const CachedEntry>;
+
+    static constexpr size_t wheelSlots = 256;   // one-second ticks
+
+    // A fetch in progress and the requests waiting for it
+    struct Flight {
+        std::vector<std::function<void()>> waiters;
+        bool done = false;
+        std::condition_variable finished;
+    };
+
+    HttpCacheConfig config;
+
+    // Declared before the entries, which leave the wheel as they are destroyed
+    std::mutex wheelMutex;
+    std::vector<ExpirySlot> wheel;
+    size_t wheelPosition;
+    Clock::time_point wheelTime;                   // start of the tick at wheelPosition
+    std::atomic<int64_t> nextTick;                 // steady-clock ms when the wheel is due to turn
+
+    ShardedLRUCache<std::string, EntryPtr> entries;
+
+    std::mutex flightMutex;
+    std::unordered_map<std::string, std::shared_ptr<Flight>, KeyTraits<std::string>::Hash,
+                       KeyTraits<std::string>::Equal> flights;
+
+    static std::pmr::string variantKey(std::string_view key, const std::vector<std::string>& vary,
+                                       const RequestInfo& request, std::pmr::memory_resource* memory);
+    EntryPtr find(std::string_view key, Clock::time_point now);
+    void schedule(const EntryPtr& entry);
+    size_t slotFor(const CachedEntry& entry) const;
+    void unschedule(const CachedEntry& entry);
+    void advance(Clock::time_point now);
+
+    friend struct CachedEntry;
+};
+
+#endif // HTTPCACHE_H
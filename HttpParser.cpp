@@ -0,0 +1,640 @@
+#include "HttpParser.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Largest response head we are willing to buffer
+static constexpr size_t maxHeadSize = 64 * 1024;
+
+// Strip leading and trailing spaces/tabs
+std::string_view trim(std::string_view value) {
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) value.remove_suffix(1);
+    return value;
+}
+
+// Case-insensitive ASCII comparison
+bool iequals(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Case-insensitive substring search
+bool icontains(std::string_view haystack, std::string_view needle) {
+    if (needle.size() > haystack.size()) return false;
+    for (size_t i = 0; i + needle.size() <= haystack.size(); ++i) {
+        if (iequals(haystack.substr(i, needle.size()), needle)) return true;
+    }
+    return false;
+}
+
+HttpResponseParser::HttpResponseParser() {
+    reset();
+}
+
+// Prepare for a new response
+void HttpResponseParser::reset(bool headRequest) {
+    phase = Phase::Head;
+    head.clear();
+    line.clear();
+    bodyRemaining_ = 0;
+    chunkRemaining = 0;
+    bodyLength = 0;
+    length = 0;
+    status = 0;
+    contentLengthSet = false;
+    chunked = false;
+    reusable = false;
+    closeDelimited = false;
+    this->headRequest = headRequest;
+}
+
+// Consume as many of the given bytes as belong to the current message
+HttpResponseParser::Result HttpResponseParser::feed(std::string_view data, size_t& used) {
+    size_t pos = 0;
+    bool failed = false;
+    while (!failed && pos < data.size() && phase != Phase::Done) {
+        std::string_view rest = data.substr(pos);
+        switch (phase) {
+            case Phase::Head: {
+                Result headResult = Result::Incomplete;
+                pos += feedHead(rest, headResult);
+                if (headResult == Result::Error) {
+                    failed = true;
+                }
+                break;
+            }
+            case Phase::FixedBody: {
+                size_t take = std::min(bodyRemaining_, rest.size());
+                pos += take;
+                bodyRemaining_ -= take;
+                if (bodyRemaining_ == 0) {
+                    phase = Phase::Done;
+                }
+                break;
+            }
+            case Phase::ChunkData: {
+                size_t take = std::min(chunkRemaining, rest.size());
+                pos += take;
+                chunkRemaining -= take;
+                if (chunkRemaining == 0) {
+                    phase = Phase::ChunkEnd;
+                }
+                break;
+            }
+            case Phase::ChunkSize:
+            case Phase::ChunkEnd:
+            case Phase::Trailers: {
+                bool lineComplete = false;
+                pos += feedLine(rest, lineComplete);
+                if ((lineComplete && finishLine() == Result::Error) || line.size() > maxHeadSize) {
+                    failed = true;
+                }
+                break;
+            }
+            case Phase::UntilClose:
+                pos = data.size();
+                break;
+            default:
+                break;
+        }
+    }
+
+    length += pos;
+    used = pos;
+    if (failed) {
+        return Result::Error;
+    }
+    return phase == Phase::Done ? Result::Complete : Result::Incomplete;
+}
+
+// The peer closed the connection
+HttpResponseParser::Result HttpResponseParser::finishOnEof() {
+    if (phase == Phase::UntilClose) {
+        phase = Phase::Done;
+    }
+    return phase == Phase::Done ? Result::Complete : Result::Error;  // Otherwise truncated
+}
+
+// Bytes that may still be forwarded blindly; unbounded for read-until-close bodies
+size_t HttpResponseParser::bodyRemaining() const {
+    if (phase == Phase::FixedBody) return bodyRemaining_;
+    if (phase == Phase::UntilClose) return SIZE_MAX;
+    return 0;
+}
+
+// Account body bytes forwarded around the parser
+void HttpResponseParser::skipBody(size_t bytes) {
+    length += bytes;
+    if (phase == Phase::FixedBody) {
+        bodyRemaining_ -= std::min(bytes, bodyRemaining_);
+        if (bodyRemaining_ == 0) {
+            phase = Phase::Done;
+        }
+    }
+}
+
+// Buffer the head until the blank line; returns the bytes taken from data
+size_t HttpResponseParser::feedHead(std::string_view data, Result& result) {
+    size_t previous = head.size();
+
+    // Find the blank line before copying, so the body is never buffered with
+    // the head. It may straddle the bytes buffered by an earlier call.
+    size_t take = data.size();
+    char seam[6];
+    size_t carried = std::min<size_t>(previous, 3);
+    size_t joined = carried + std::min<size_t>(data.size(), 3);
+    std::copy_n(head.data() + previous - carried, carried, seam);
+    std::copy_n(data.data(), joined - carried, seam + carried);
+    size_t seamEnd = std::string_view(seam, joined).find("\r\n\r\n");
+    if (seamEnd != std::string_view::npos) {
+        take = seamEnd + 4 - carried;
+    } else if (size_t end = data.find("\r\n\r\n"); end != std::string_view::npos) {
+        take = end + 4;
+    }
+    head.append(data.substr(0, take));
+
+    size_t scanFrom = previous > 3 ? previous - 3 : 0;
+    size_t headEnd = head.find("\r\n\r\n", scanFrom);
+    if (headEnd == std::string::npos) {
+        result = head.size() > maxHeadSize ? Result::Error : Result::Incomplete;
+        return data.size();
+    }
+
+    head.resize(headEnd + 4);
+    result = parseHead();
+    return head.size() - previous;
+}
+
+// Buffer one LF-terminated line; returns the bytes taken from data
+size_t HttpResponseParser::feedLine(std::string_view data, bool& lineComplete) {
+    size_t newline = data.find('\n');
+    if (newline == std::string_view::npos) {
+        line.append(data);
+        return data.size();
+    }
+    line.append(data.substr(0, newline + 1));
+    lineComplete = true;
+    return newline + 1;
+}
+
+// Act on a complete chunk-size, chunk-end or trailer line
+HttpResponseParser::Result HttpResponseParser::finishLine() {
+    if (line.size() < 2 || line[line.size() - 2] != '\r') {
+        return Result::Error;
+    }
+    std::string_view content(line.data(), line.size() - 2);
+
+    if (phase == Phase::ChunkSize) {
+        size_t extension = content.find(';');
+        if (extension != std::string_view::npos) {
+            content = content.substr(0, extension);
+        }
+        content = trim(content);
+
+        size_t chunkSize = 0;
+        auto [end, error] = std::from_chars(content.data(), content.data() + content.size(), chunkSize, 16);
+        if (content.empty() || error != std::errc() || end != content.data() + content.size()) {
+            return Result::Error;
+        }
+        chunkRemaining = chunkSize;
+        phase = chunkSize == 0 ? Phase::Trailers : Phase::ChunkData;
+    } else if (phase == Phase::ChunkEnd) {
+        if (!content.empty()) {
+            return Result::Error;
+        }
+        phase = Phase::ChunkSize;
+    } else if (content.empty()) {
+        phase = Phase::Done;  // Blank line ends the trailers
+    }
+
+    line.clear();
+    return Result::Complete;
+}
+
+// Parse the status line and the headers that decide how the body is framed
+HttpResponseParser::Result HttpResponseParser::parseHead() {
+    std::string_view headView = std::string_view(head).substr(0, head.size() - 2);
+    size_t lineEnd = headView.find("\r\n");
+    std::string_view statusLine = headView.substr(0, lineEnd);
+
+    // Status line: HTTP/1.x SSS Reason
+    if (statusLine.size() < 12 || statusLine.substr(0, 7) != "HTTP/1.") {
+        return Result::Error;
+    }
+    bool http11 = statusLine[7] == '1';
+    auto [ptr, ec] = std::from_chars(statusLine.data() + 9, statusLine.data() + 12, status);
+    if (ec != std::errc() || ptr != statusLine.data() + 12) {
+        return Result::Error;
+    }
+
+    bool connectionClose = false;
+    bool connectionKeepAlive = false;
+
+    // Header lines
+    size_t pos = lineEnd + 2;
+    while (pos < headView.size()) {
+        size_t next = headView.find("\r\n", pos);
+        std::string_view headerLine = headView.substr(pos, next - pos);
+        pos = next == std::string_view::npos ? headView.size() : next + 2;
+
+        size_t colon = headerLine.find(':');
+        if (colon == std::string_view::npos) {
+            continue;
+        }
+        std::string_view name = trim(headerLine.substr(0, colon));
+        std::string_view value = trim(headerLine.substr(colon + 1));
+
+        if (iequals(name, "Content-Length")) {
+            auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), bodyLength);
+            if (error != std::errc() || end != value.data() + value.size()) {
+                return Result::Error;
+            }
+            contentLengthSet = true;
+        } else if (iequals(name, "Transfer-Encoding")) {
+            chunked = icontains(value, "chunked");
+        } else if (iequals(name, "Connection")) {
+            connectionClose = icontains(value, "close");
+            connectionKeepAlive = icontains(value, "keep-alive");
+        }
+    }
+
+    reusable = http11 ? !connectionClose : connectionKeepAlive;
+
+    if (headRequest || (status >= 100 && status < 200) || status == 204 || status == 304) {
+        bodyLength = 0;
+        phase = Phase::Done;
+    } else if (chunked) {
+        phase = Phase::ChunkSize;
+    } else if (contentLengthSet) {
+        bodyRemaining_ = bodyLength;
+        phase = bodyLength == 0 ? Phase::Done : Phase::FixedBody;
+    } else {
+        // Body is delimited by connection close, so the socket cannot be reused
+        reusable = false;
+        closeDelimited = true;
+        phase = Phase::UntilClose;
+    }
+    return Result::Complete;
+}
+
+// Find the first CR or LF in [begin, end), 16 bytes per step with SSE2
+static const char* findLineBreak(const char* begin, const char* end) {
+#if defined(__SSE2__)
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    while (end - begin >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, cr), _mm_cmpeq_epi8(chunk, lf)));
+        if (mask != 0) {
+            return begin + __builtin_ctz(mask);
+        }
+        begin += 16;
+    }
+#endif
+    while (begin < end && *begin != '\r' && *begin != '\n') ++begin;
+    return begin;
+}
+
+// Find the first occurrence of a delimiter in [begin, end), 16 bytes per step with SSE2
+static const char* findByte(const char* begin, const char* end, char target) {
+#if defined(__SSE2__)
+    const __m128i needle = _mm_set1_epi8(target);
+    while (end - begin >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+        if (mask != 0) {
+            return begin + __builtin_ctz(mask);
+        }
+        begin += 16;
+    }
+#endif
+    while (begin < end && *begin != target) ++begin;
+    return begin;
+}
+
+// RFC 9110 token characters, as used in methods and header names
+static bool isTokenChar(char c) {
+    if (std::isalnum(static_cast<unsigned char>(c))) return true;
+    switch (c) {
+        case '!': case '#': case '$': case '%': case '&': case '\'': case '*': case '+':
+        case '-': case '.': case '^': case '_': case '`': case '|': case '~':
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool isToken(std::string_view value) {
+    if (value.empty()) return false;
+    for (char c : value) {
+        if (!isTokenChar(c)) return false;
+    }
+    return true;
+}
+
+// Case-insensitive header lookup
+std::string_view RequestInfo::header(std::string_view name) const {
+    for (size_t i = 0; i < headerCount; ++i) {
+        if (iequals(headers[i].name, name)) {
+            return headers[i].value;
+        }
+    }
+    return {};
+}
+
+HttpRequestParser::HttpRequestParser() {
+    reset();
+}
+
+// Forget all progress so the next request can be parsed from the start of the buffer
+void HttpRequestParser::reset() {
+    phase = Phase::RequestLine;
+    lineStart = 0;
+    offset = 0;
+    bodyStart = 0;
+    chunkRemaining = 0;
+    bodyBytes = 0;
+    contentLength = 0;
+    hasContentLength = false;
+    chunked = false;
+    connectionClose = false;
+    connectionKeepAlive = false;
+    error = 0;
+    method = path = version = Span{0, 0};
+    headerCount = 0;
+}
+
+// Parse as far as the buffered bytes allow
+HttpRequestParser::Result HttpRequestParser::parse(std::string_view buffer, RequestInfo& request) {
+    if (phase == Phase::Done) {
+        return complete(buffer, request);
+    }
+    if (error != 0) {
+        return Result::Error;
+    }
+
+    // Request line and headers, one CRLF-terminated line at a time
+    while (phase == Phase::RequestLine || phase == Phase::Headers) {
+        const char* data = buffer.data();
+        const char* end = data + buffer.size();
+        const char* lineBreak = findLineBreak(data + offset, end);
+        if (lineBreak == end) {
+            offset = buffer.size();
+            return buffer.size() > maxRequestSize ? fail(431) : Result::Incomplete;
+        }
+
+        size_t breakOffset = lineBreak - data;
+        if (*lineBreak != '\r') {
+            return fail(400);  // Bare LF
+        }
+        if (breakOffset + 1 == buffer.size()) {
+            offset = breakOffset;  // Wait for the LF
+            return Result::Incomplete;
+        }
+        if (data[breakOffset + 1] != '\n') {
+            return fail(400);
+        }
+        if (breakOffset + 2 > maxRequestSize) {
+            return fail(431);
+        }
+
+        size_t thisLineStart = lineStart;
+        std::string_view line(data + lineStart, breakOffset - lineStart);
+        lineStart = offset = breakOffset + 2;
+
+        if (phase == Phase::RequestLine) {
+            if (line.empty()) {
+                continue;  // Tolerate empty lines before the request line
+            }
+            if (parseRequestLine(line, thisLineStart) == Result::Error) {
+                return Result::Error;
+            }
+            phase = Phase::Headers;
+            continue;
+        }
+
+        if (!line.empty()) {
+            if (parseHeaderLine(line, thisLineStart) == Result::Error) {
+                return Result::Error;
+            }
+            continue;
+        }
+
+        // Blank line: the head is complete, decide how the body is framed
+        bodyStart = offset;
+        if (chunked) {
+            if (hasContentLength) {
+                return fail(400);  // Ambiguous framing invites request smuggling
+            }
+            phase = Phase::ChunkSize;
+        } else if (contentLength > maxRequestBodySize) {
+            return fail(413);
+        } else if (contentLength > 0) {
+            phase = Phase::FixedBody;
+        } else {
+            phase = Phase::Done;
+        }
+    }
+
+    if (phase != Phase::Done) {
+        Result result = parseBody(buffer);
+        if (result != Result::Complete) {
+            return result;
+        }
+    }
+    return complete(buffer, request);
+}
+
+HttpRequestParser::Result HttpRequestParser::fail(int status) {
+    error = status;
+    return Result::Error;
+}
+
+// METHOD SP request-target SP HTTP/1.x
+HttpRequestParser::Result HttpRequestParser::parseRequestLine(std::string_view line, size_t lineOffset) {
+    const char* begin = line.data();
+    const char* end = begin + line.size();
+
+    const char* firstSpace = findByte(begin, end, ' ');
+    if (firstSpace == end) {
+        return fail(400);
+    }
+    const char* secondSpace = findByte(firstSpace + 1, end, ' ');
+    if (secondSpace == end) {
+        return fail(400);
+    }
+
+    std::string_view methodView(begin, firstSpace - begin);
+    std::string_view pathView(firstSpace + 1, secondSpace - firstSpace - 1);
+    std::string_view versionView(secondSpace + 1, end - secondSpace - 1);
+
+    if (!isToken(methodView) || pathView.empty() ||
+        (versionView != "HTTP/1.1" && versionView != "HTTP/1.0")) {
+        return fail(400);
+    }
+
+    method = Span{static_cast<uint32_t>(lineOffset), static_cast<uint32_t>(methodView.size())};
+    path = Span{static_cast<uint32_t>(lineOffset + (pathView.data() - begin)), static_cast<uint32_t>(pathView.size())};
+    version = Span{static_cast<uint32_t>(lineOffset + (versionView.data() - begin)), static_cast<uint32_t>(versionView.size())};
+    return Result::Complete;
+}
+
+// name ":" OWS value OWS
+HttpRequestParser::Result HttpRequestParser::parseHeaderLine(std::string_view line, size_t lineOffset) {
+    if (headerCount == maxRequestHeaders) {
+        return fail(431);
+    }
+
+    const char* begin = line.data();
+    const char* colon = findByte(begin, begin + line.size(), ':');
+    if (colon == begin + line.size()) {
+        return fail(400);
+    }
+
+    std::string_view name(begin, colon - begin);
+    std::string_view value = trim(std::string_view(colon + 1, begin + line.size() - colon - 1));
+    if (!isToken(name)) {
+        return fail(400);  // Also rejects whitespace before the colon
+    }
+
+    if (iequals(name, "Content-Length")) {
+        size_t length = 0;
+        auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), length);
+        if (value.empty() || ec != std::errc() || end != value.data() + value.size() ||
+            (hasContentLength && length != contentLength)) {
+            return fail(400);
+        }
+        contentLength = length;
+        hasContentLength = true;
+    } else if (iequals(name, "Transfer-Encoding")) {
+        // chunked must be the final coding; anything else cannot be framed
+        std::string_view last = value.substr(value.rfind(',') == std::string_view::npos ? 0 : value.rfind(',') + 1);
+        if (!iequals(trim(last), "chunked")) {
+            return fail(400);
+        }
+        chunked = true;
+    } else if (iequals(name, "Connection")) {
+        connectionClose = connectionClose || icontains(value, "close");
+        connectionKeepAlive = connectionKeepAlive || icontains(value, "keep-alive");
+    }
+
+    headerSpans[headerCount++] = {
+        Span{static_cast<uint32_t>(lineOffset), static_cast<uint32_t>(name.size())},
+        Span{static_cast<uint32_t>(lineOffset + (value.data() - begin)), static_cast<uint32_t>(value.size())}
+    };
+    return Result::Complete;
+}
+
+// Frame the body by Content-Length or chunked encoding without copying it
+HttpRequestParser::Result HttpRequestParser::parseBody(std::string_view buffer) {
+    while (true) {
+        switch (phase) {
+            case Phase::FixedBody:
+                if (buffer.size() - bodyStart < contentLength) {
+                    return Result::Incomplete;
+                }
+                offset = bodyStart + contentLength;
+                phase = Phase::Done;
+                return Result::Complete;
+
+            case Phase::ChunkSize: {
+                const char* data = buffer.data();
+                const char* lineBreak = findByte(data + offset, data + buffer.size(), '\r');
+                if (lineBreak == data + buffer.size() || lineBreak + 1 == data + buffer.size()) {
+                    return buffer.size() - offset > 64 ? fail(400) : Result::Incomplete;
+                }
+                if (lineBreak[1] != '\n') {
+                    return fail(400);
+                }
+
+                std::string_view sizeLine(data + offset, lineBreak - (data + offset));
+                size_t extension = sizeLine.find(';');
+                if (extension != std::string_view::npos) {
+                    sizeLine = sizeLine.substr(0, extension);
+                }
+                sizeLine = trim(sizeLine);
+
+                size_t chunkSize = 0;
+                auto [end, ec] = std::from_chars(sizeLine.data(), sizeLine.data() + sizeLine.size(), chunkSize, 16);
+                if (sizeLine.empty() || ec != std::errc() || end != sizeLine.data() + sizeLine.size()) {
+                    return fail(400);
+                }
+                if (chunkSize > maxRequestBodySize - bodyBytes) {
+                    return fail(413);
+                }
+
+                offset = (lineBreak - data) + 2;
+                bodyBytes += chunkSize;
+                if (chunkSize == 0) {
+                    phase = Phase::Trailers;
+                } else {
+                    chunkRemaining = chunkSize + 2;  // payload + CRLF
+                    phase = Phase::ChunkData;
+                }
+                break;
+            }
+
+            case Phase::ChunkData:
+                if (buffer.size() - offset < chunkRemaining) {
+                    return Result::Incomplete;
+                }
+                offset += chunkRemaining;
+                if (buffer.substr(offset - 2, 2) != "\r\n") {
+                    return fail(400);
+                }
+                chunkRemaining = 0;
+                phase = Phase::ChunkSize;
+                break;
+
+            case Phase::Trailers: {
+                const char* data = buffer.data();
+                const char* lineBreak = findByte(data + offset, data + buffer.size(), '\r');
+                if (lineBreak == data + buffer.size() || lineBreak + 1 == data + buffer.size()) {
+                    return buffer.size() - offset > maxRequestSize ? fail(431) : Result::Incomplete;
+                }
+                if (lineBreak[1] != '\n') {
+                    return fail(400);
+                }
+                bool lastLine = lineBreak == data + offset;
+                offset = (lineBreak - data) + 2;
+                if (lastLine) {
+                    phase = Phase::Done;
+                    return Result::Complete;
+                }
+                break;
+            }
+
+            default:
+                return phase == Phase::Done ? Result::Complete : Result::Error;
+        }
+    }
+}
+
+// Materialize the recorded offsets as views into the current buffer
+HttpRequestParser::Result HttpRequestParser::complete(std::string_view buffer, RequestInfo& request) {
+    auto view = [&buffer](Span span) { return buffer.substr(span.offset, span.length); };
+
+    request.method = view(method);
+    request.path = view(path);
+    request.version = view(version);
+    request.headerCount = headerCount;
+    for (size_t i = 0; i < headerCount; ++i) {
+        request.headers[i] = HttpHeader{view(headerSpans[i].first), view(headerSpans[i].second)};
+    }
+    request.body = buffer.substr(bodyStart, offset - bodyStart);
+    request.contentLength = chunked ? bodyBytes : contentLength;
+    request.chunked = chunked;
+    request.keepAlive = request.version == "HTTP/1.1" ? !connectionClose : connectionKeepAlive;
+    request.length = offset;
+    return Result::Complete;
+}
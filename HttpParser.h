@@ -0,0 +1,179 @@
+#ifndef HTTPPARSER_H
+#define HTTPPARSER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// Header value helpers shared by the parsers and the cache
+std::string_view trim(std::string_view value);                        // strip spaces and tabs
+bool iequals(std::string_view a, std::string_view b);                 // case-insensitive ASCII
+bool icontains(std::string_view haystack, std::string_view needle);   // case-insensitive search
+
+// Streaming framer for HTTP/1.x responses read from a backend.
+// Push each chunk of bytes through feed() as it arrives; only the head and
+// partial chunk-size lines are buffered, so bodies can be relayed to the
+// client without holding them in memory, and keep-alive connections can be
+// reused as soon as the message ends instead of waiting for EOF.
+class HttpResponseParser {
+public:
+    enum class Result {
+        Incomplete,   // need more bytes
+        Complete,     // the message ended; bytes past `used` belong to no message
+        Error         // malformed response; the connection must not be reused
+    };
+
+    HttpResponseParser();
+
+    // Prepare for a new response; HEAD responses never carry a body
+    void reset(bool headRequest = false);
+
+    // Consume the next bytes of the stream; `used` is how many belong to this message
+    Result feed(std::string_view data, size_t& used);
+
+    // The peer closed the connection; completes read-until-close bodies
+    Result finishOnEof();
+
+    // Body bytes that can be forwarded without inspecting them (Content-Length
+    // or read-until-close bodies), e.g. with splice()
+    bool bodyIsOpaque() const { return phase == Phase::FixedBody || phase == Phase::UntilClose; }
+    size_t bodyRemaining() const;
+
+    // Account body bytes that were forwarded without passing through feed()
+    void skipBody(size_t bytes);
+
+    bool headersComplete() const { return phase != Phase::Head; }
+    int statusCode() const { return status; }
+    bool keepAlive() const { return reusable; }
+    size_t messageLength() const { return length; }
+    bool hasContentLength() const { return contentLengthSet; }
+    size_t contentLength() const { return bodyLength; }
+    bool isChunked() const { return chunked; }
+
+    // The body ends only when the peer closes, so the client connection must close too
+    bool delimitedByClose() const { return closeDelimited; }
+
+private:
+    enum class Phase {
+        Head,          // status line and headers
+        FixedBody,     // Content-Length delimited body
+        ChunkSize,     // chunk-size line
+        ChunkData,     // chunk payload
+        ChunkEnd,      // CRLF after the chunk payload
+        Trailers,      // trailer section after the last chunk
+        UntilClose,    // no framing: body ends when the peer closes
+        Done
+    };
+
+    Phase phase;
+    std::string head;       // status line and headers, until the blank line
+    std::string line;       // partial chunk-size / trailer line
+    size_t bodyRemaining_;  // bytes left in a Content-Length body
+    size_t chunkRemaining;  // payload bytes left in the current chunk
+    size_t bodyLength;      // Content-Length of the body, if any
+    size_t length;          // message bytes consumed so far; the total once complete
+    int status;
+    bool contentLengthSet;
+    bool chunked;
+    bool reusable;
+    bool closeDelimited;
+    bool headRequest;
+
+    size_t feedHead(std::string_view data, Result& result);
+    size_t feedLine(std::string_view data, bool& lineComplete);
+    Result parseHead();
+    Result finishLine();
+};
+
+// Largest request head (request line + headers) accepted from a client
+static constexpr size_t maxRequestSize = 4096;
+
+// Largest request body buffered while framing a request
+static constexpr size_t maxRequestBodySize = 1024 * 1024;
+
+// Most headers accepted in one request
+static constexpr size_t maxRequestHeaders = 64;
+
+// A header as views into the receive buffer
+struct HttpHeader {
+    std::string_view name;
+    std::string_view value;
+};
+
+// structure of the request; every view points into the connection's receive
+// buffer and stays valid until those bytes are consumed or the buffer grows
+struct RequestInfo {
+    std::string_view method;
+    std::string_view path;
+    std::string_view version;
+    std::array<HttpHeader, maxRequestHeaders> headers;
+    size_t headerCount = 0;
+    std::string_view body;       // raw body bytes, still chunk-encoded when chunked
+    size_t contentLength = 0;
+    bool chunked = false;
+    bool keepAlive = false;      // client allows the connection to be reused
+    size_t length = 0;           // bytes of the buffer taken by this request
+
+    // Case-insensitive header lookup; empty when absent
+    std::string_view header(std::string_view name) const;
+};
+
+// Resumable, zero-copy parser for HTTP/1.x requests. Call parse() with the
+// whole receive buffer after every read; it continues from where the previous
+// call stopped, so each byte is scanned once. Only offsets are kept while the
+// request is incomplete, so the buffer may be reallocated between calls.
+class HttpRequestParser {
+public:
+    enum class Result {
+        Incomplete,   // need more bytes
+        Complete,     // request filled in; its bytes are the first request.length of the buffer
+        Error         // malformed or too large; errorStatus() gives the HTTP status
+    };
+
+    HttpRequestParser();
+
+    // Forget all progress; call after consuming a complete request
+    void reset();
+
+    Result parse(std::string_view buffer, RequestInfo& request);
+
+    int errorStatus() const { return error; }
+
+private:
+    enum class Phase { RequestLine, Headers, FixedBody, ChunkSize, ChunkData, Trailers, Done };
+
+    struct Span {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    Phase phase;
+    size_t lineStart;         // start of the head line being scanned
+    size_t offset;            // next byte to scan
+    size_t bodyStart;
+    size_t chunkRemaining;    // payload bytes (plus CRLF) left in the current chunk
+    size_t bodyBytes;         // decoded body bytes seen so far
+    size_t contentLength;
+    bool hasContentLength;
+    bool chunked;
+    bool connectionClose;
+    bool connectionKeepAlive;
+    int error;
+
+    Span method;
+    Span path;
+    Span version;
+    std::array<std::pair<Span, Span>, maxRequestHeaders> headerSpans;
+    size_t headerCount;
+
+    Result fail(int status);
+    Result parseRequestLine(std::string_view line, size_t lineOffset);
+    Result parseHeaderLine(std::string_view line, size_t lineOffset);
+    Result parseBody(std::string_view buffer);
+    Result complete(std::string_view buffer, RequestInfo& request);
+};
+
+#endif // HTTPPARSER_H
@@ -0,0 +1,318 @@
+#include "IoUring.h"
+#include "Logger.h"
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+static thread_local IoUring* currentEngine = nullptr;
+
+// Completions drained per flush() before the loop gets to run epoll and timers again
+static constexpr int maxFlushRounds = 4;
+
+static int ioUringSetup(unsigned entries, struct io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+static int ioUringRegister(int fd, unsigned opcode, void* arg, unsigned count) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+// Memory shared with the kernel is read and written with acquire/release ordering
+static unsigned loadAcquire(unsigned* value) {
+    return std::atomic_ref<unsigned>(*value).load(std::memory_order_acquire);
+}
+
+static void storeRelease(unsigned* value, unsigned next) {
+    std::atomic_ref<unsigned>(*value).store(next, std::memory_order_release);
+}
+
+static void* mapRing(int fd, size_t bytes, off_t offset) {
+    void* ring = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+    return ring == MAP_FAILED ? nullptr : ring;
+}
+
+static unsigned roundUpToPowerOfTwo(unsigned value) {
+    unsigned power = 1;
+    while (power < value) {
+        power <<= 1;
+    }
+    return power;
+}
+
+// Constructor: set up the rings and register the provided receive buffers
+IoUring::IoUring(unsigned entries, unsigned bufferCount, size_t bufferSize)
+    : ringFd(-1), loop(nullptr),
+      sqRing(nullptr), sqRingBytes(0), sqHead(nullptr), sqTail(nullptr), sqFlags(nullptr),
+      sqMask(0), sqEntries(0), sqes(nullptr), sqesBytes(0), localTail(0), unsubmitted(0),
+      cqRing(nullptr), cqRingBytes(0), cqHead(nullptr), cqTail(nullptr), cqMask(0), cqes(nullptr),
+      bufferRing(nullptr), bufferRingBytes(0), bufferMemory(nullptr), bufferBytes(bufferSize),
+      bufferCount(roundUpToPowerOfTwo(bufferCount)), bufferTail(0) {
+    // Multishot accepts can post many completions per submission; give them room
+    struct io_uring_params params{};
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = entries * 4;
+    ringFd = ioUringSetup(entries, &params);
+    if (ringFd < 0) {
+        throw std::runtime_error(std::string("io_uring_setup failed: ") + strerror(errno));
+    }
+    if (!(params.features & IORING_FEAT_NODROP)) {
+        release();
+        throw std::runtime_error("io_uring lacks IORING_FEAT_NODROP");
+    }
+
+    sqRingBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingBytes = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap) {
+        sqRingBytes = cqRingBytes = std::max(sqRingBytes, cqRingBytes);
+    }
+
+    sqRing = mapRing(ringFd, sqRingBytes, IORING_OFF_SQ_RING);
+    cqRing = singleMmap ? sqRing : mapRing(ringFd, cqRingBytes, IORING_OFF_CQ_RING);
+    sqesBytes = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes = static_cast<struct io_uring_sqe*>(mapRing(ringFd, sqesBytes, IORING_OFF_SQES));
+    if (!sqRing || !cqRing || !sqes) {
+        int error = errno;
+        release();
+        throw std::runtime_error(std::string("io_uring mmap failed: ") + strerror(error));
+    }
+
+    char* sq = static_cast<char*>(sqRing);
+    sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqFlags = reinterpret_cast<unsigned*>(sq + params.sq_off.flags);
+    sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqEntries = params.sq_entries;
+    localTail = *sqTail;
+
+    // Entries are always submitted in slot order
+    unsigned* sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    for (unsigned i = 0; i < sqEntries; ++i) {
+        sqArray[i] = i;
+    }
+
+    char* cq = static_cast<char*>(cqRing);
+    cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    // Provided buffer ring: the kernel picks a buffer per receive and names it in the completion
+    bufferRingBytes = this->bufferCount * sizeof(struct io_uring_buf);
+    void* ringMemory = mmap(nullptr, bufferRingBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    void* dataMemory = mmap(nullptr, this->bufferCount * bufferBytes, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    bufferRing = ringMemory == MAP_FAILED ? nullptr : static_cast<struct io_uring_buf_ring*>(ringMemory);
+    bufferMemory = dataMemory == MAP_FAILED ? nullptr : static_cast<char*>(dataMemory);
+    if (!bufferRing || !bufferMemory) {
+        int error = errno;
+        release();
+        throw std::runtime_error(std::string("io_uring buffer allocation failed: ") + strerror(error));
+    }
+
+    struct io_uring_buf_reg registration{};
+    registration.ring_addr = reinterpret_cast<uint64_t>(bufferRing);
+    registration.ring_entries = this->bufferCount;
+    registration.bgid = bufferGroup;
+    if (ioUringRegister(ringFd, IORING_REGISTER_PBUF_RING, &registration, 1) < 0) {
+        int error = errno;
+        release();
+        throw std::runtime_error(std::string("io_uring provided buffer ring unsupported: ") + strerror(error));
+    }
+    for (unsigned id = 0; id < this->bufferCount; ++id) {
+        recycleBuffer(static_cast<uint16_t>(id));
+    }
+}
+
+// Destructor: detach from the loop and unmap everything shared with the kernel
+IoUring::~IoUring() {
+    if (loop) {
+        loop->remove(ringFd);
+        loop->setBeforeWait(nullptr);
+    }
+    if (currentEngine == this) {
+        currentEngine = nullptr;
+    }
+    release();
+}
+
+void IoUring::release() {
+    if (bufferMemory) {
+        munmap(bufferMemory, bufferCount * bufferBytes);
+    }
+    if (bufferRing) {
+        munmap(bufferRing, bufferRingBytes);
+    }
+    if (sqes) {
+        munmap(sqes, sqesBytes);
+    }
+    if (cqRing && cqRing != sqRing) {
+        munmap(cqRing, cqRingBytes);
+    }
+    if (sqRing) {
+        munmap(sqRing, sqRingBytes);
+    }
+    if (ringFd >= 0) {
+        close(ringFd);
+    }
+    bufferMemory = nullptr;
+    bufferRing = nullptr;
+    sqes = nullptr;
+    cqRing = sqRing = nullptr;
+    ringFd = -1;
+}
+
+bool IoUring::supported(std::string& reason) {
+    std::unique_ptr<IoUring> probe;
+    try {
+        probe = std::make_unique<IoUring>(8, 1, 4096);
+    } catch (const std::exception& e) {
+        reason = e.what();
+        return false;
+    }
+
+    // The provided buffer ring and multishot accept arrived together in 5.19;
+    // check the individual operations the socket layer issues as well
+    auto ops = std::make_unique<char[]>(sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op));
+    auto* opProbe = reinterpret_cast<struct io_uring_probe*>(ops.get());
+    std::memset(opProbe, 0, sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op));
+    if (ioUringRegister(probe->ringFd, IORING_REGISTER_PROBE, opProbe, 256) < 0) {
+        reason = std::string("io_uring probe failed: ") + strerror(errno);
+        return false;
+    }
+    for (uint8_t opcode : {IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SEND, IORING_OP_CONNECT,
+                           IORING_OP_POLL_ADD, IORING_OP_LINK_TIMEOUT}) {
+        if (opcode > opProbe->last_op || !(opProbe->ops[opcode].flags & IO_URING_OP_SUPPORTED)) {
+            reason = "io_uring operation " + std::to_string(opcode) + " unsupported";
+            return false;
+        }
+    }
+    return true;
+}
+
+void IoUring::attach(EventLoop& eventLoop) {
+    loop = &eventLoop;
+    currentEngine = this;
+    // The ring descriptor polls readable while completions wait in the queue
+    loop->add(ringFd, EPOLLIN, [this](uint32_t) {
+        flush();
+    });
+    loop->setBeforeWait([this]() {
+        flush();
+    });
+}
+
+IoUring* IoUring::current() {
+    return currentEngine;
+}
+
+// Next free submission slot, submitting what is queued when the ring is full
+struct io_uring_sqe* IoUring::nextEntry() {
+    while (localTail - loadAcquire(sqHead) >= sqEntries) {
+        submit();
+    }
+    struct io_uring_sqe* entry = &sqes[localTail & sqMask];
+    std::memset(entry, 0, sizeof(*entry));
+    ++localTail;
+    ++unsubmitted;
+    return entry;
+}
+
+void IoUring::queue(const struct io_uring_sqe& request, Completion* target,
+                    const struct __kernel_timespec* timeout) {
+    // A linked pair must go out in one submission; make room for both first
+    if (timeout && localTail - loadAcquire(sqHead) + 2 > sqEntries) {
+        submit();
+    }
+
+    struct io_uring_sqe* entry = nextEntry();
+    *entry = request;
+    entry->user_data = reinterpret_cast<uint64_t>(target);
+    if (timeout) {
+        entry->flags |= IOSQE_IO_LINK;
+        struct io_uring_sqe* timer = nextEntry();
+        timer->opcode = IORING_OP_LINK_TIMEOUT;
+        timer->fd = -1;
+        timer->addr = reinterpret_cast<uint64_t>(timeout);
+        timer->len = 1;
+        timer->user_data = 0;   // its own completion is not reported
+    }
+}
+
+void IoUring::recycleBuffer(uint16_t id) {
+    struct io_uring_buf& slot = bufferRing->bufs[bufferTail & (bufferCount - 1)];
+    slot.addr = reinterpret_cast<uint64_t>(bufferMemory + static_cast<size_t>(id) * bufferBytes);
+    slot.len = static_cast<uint32_t>(bufferBytes);
+    slot.bid = id;
+    ++bufferTail;
+    std::atomic_ref<uint16_t>(bufferRing->tail).store(bufferTail, std::memory_order_release);
+}
+
+// Hand every queued entry to the kernel in one io_uring_enter
+void IoUring::submit() {
+    if (unsubmitted == 0) {
+        return;
+    }
+    storeRelease(sqTail, localTail);
+    while (unsubmitted > 0) {
+        int submitted = ioUringEnter(ringFd, unsubmitted, 0, 0);
+        if (submitted >= 0) {
+            unsubmitted -= static_cast<unsigned>(submitted);
+            continue;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EBUSY) {
+            // Completions must be consumed before the kernel takes more work
+            reap();
+            continue;
+        }
+        logError("io_uring_enter failed", strerror(errno));
+        return;
+    }
+}
+
+// Deliver every posted completion; returns whether there were any
+bool IoUring::reap() {
+    // Completions the kernel could not post while the queue was full are flushed on request
+    if (loadAcquire(sqFlags) & IORING_SQ_CQ_OVERFLOW) {
+        ioUringEnter(ringFd, 0, 0, IORING_ENTER_GETEVENTS);
+    }
+
+    bool reaped = false;
+    unsigned head = *cqHead;
+    while (head != loadAcquire(cqTail)) {
+        struct io_uring_cqe completion = cqes[head & cqMask];
+        storeRelease(cqHead, ++head);
+        reaped = true;
+
+        // The head moves first: a resumed coroutine may queue work that reaps again
+        if (completion.user_data != 0) {
+            reinterpret_cast<Completion*>(completion.user_data)->complete(completion.res, completion.flags);
+        }
+    }
+    return reaped;
+}
+
+void IoUring::flush() {
+    for (int round = 0; round < maxFlushRounds; ++round) {
+        submit();
+        // Operations that completed inline are delivered now instead of after another epoll_wait
+        if (!reap() && unsubmitted == 0) {
+            return;
+        }
+    }
+    submit();
+}
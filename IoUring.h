@@ -0,0 +1,96 @@
+#ifndef IOURING_H
+#define IOURING_H
+
+#include <linux/io_uring.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "EventLoop.h"
+
+// Completion-based I/O engine for one EventLoop thread, driven through the raw
+// io_uring syscalls. Operations queued during a loop iteration are submitted
+// together by one io_uring_enter just before the loop waits, and completions
+// are reaped when the ring descriptor turns readable in epoll. Receives draw
+// from a provided buffer ring, so idle connections pin no receive buffer.
+class IoUring {
+public:
+    // Receives a queued operation's result; user_data of its entry points here
+    struct Completion {
+        virtual void complete(int32_t result, uint32_t flags) = 0;
+
+    protected:
+        ~Completion() = default;
+    };
+
+    static constexpr uint16_t bufferGroup = 0;
+
+    // Throws std::runtime_error when the kernel cannot set up the ring
+    IoUring(unsigned entries, unsigned bufferCount, size_t bufferSize);
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    // Check that rings with multishot accept and provided buffers work here;
+    // reason says what is missing when they do not
+    static bool supported(std::string& reason);
+
+    // Drive the ring from loop and make it this thread's engine
+    void attach(EventLoop& loop);
+
+    // Engine attached on the calling thread, or nullptr
+    static IoUring* current();
+
+    // Queue a copy of request for target; a linked timeout cancels it with
+    // -ECANCELED if it has not completed by then. Both must outlive the operation.
+    void queue(const struct io_uring_sqe& request, Completion* target,
+               const struct __kernel_timespec* timeout = nullptr);
+
+    // Data of a provided buffer named by a completion; hand it back when consumed
+    const char* buffer(uint16_t id) const { return bufferMemory + static_cast<size_t>(id) * bufferBytes; }
+    size_t bufferSize() const { return bufferBytes; }
+    void recycleBuffer(uint16_t id);
+
+    // Submit queued operations and deliver completions until both run dry
+    void flush();
+
+private:
+    int ringFd;
+    EventLoop* loop;
+
+    // Submission queue
+    void* sqRing;
+    size_t sqRingBytes;
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned* sqFlags;
+    unsigned sqMask;
+    unsigned sqEntries;
+    struct io_uring_sqe* sqes;
+    size_t sqesBytes;
+    unsigned localTail;     // entries filled, published to the kernel on submit
+    unsigned unsubmitted;
+
+    // Completion queue
+    void* cqRing;
+    size_t cqRingBytes;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned cqMask;
+    struct io_uring_cqe* cqes;
+
+    // Provided receive buffers
+    struct io_uring_buf_ring* bufferRing;
+    size_t bufferRingBytes;
+    char* bufferMemory;
+    size_t bufferBytes;
+    unsigned bufferCount;
+    uint16_t bufferTail;
+
+    struct io_uring_sqe* nextEntry();
+    void submit();
+    bool reap();
+    void release();
+};
+
+#endif // IOURING_H
@@ -0,0 +1,82 @@
+#include "LoadShedder.h"
+#include <cmath>
+
+LoadShedder::LoadShedder(LoadShedderConfig config)
+    : config(config),
+      rejected(0),
+      displaced(0),
+      dropped(0),
+      aboveTarget(false),
+      dropCount(0),
+      dropping(false) {}
+
+LoadShedder::Overflow LoadShedder::admitOverflow() {
+    switch (config.policy) {
+        case ShedPolicy::RejectNew:
+            rejected.fetch_add(1, std::memory_order_relaxed);
+            return Overflow::Reject;
+        case ShedPolicy::DropOldest:
+            return Overflow::DisplaceOldest;
+        default:
+            return Overflow::Wait;
+    }
+}
+
+void LoadShedder::recordDisplaced() {
+    displaced.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool LoadShedder::shedAtDequeue(Clock::duration queueDelay) {
+    if (config.policy != ShedPolicy::CoDel || !codelShouldDrop(queueDelay)) {
+        return false;
+    }
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+// Control law from RFC 8289, applied to connections instead of packets
+bool LoadShedder::codelShouldDrop(Clock::duration queueDelay) {
+    if (queueDelay < config.target && !aboveTarget.load(std::memory_order_relaxed)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(codelMutex);
+    Clock::time_point now = Clock::now();
+    if (queueDelay < config.target) {
+        // The queue drained below target: leave the dropping state
+        aboveTarget.store(false, std::memory_order_relaxed);
+        firstAboveTime = Clock::time_point();
+        dropping = false;
+        return false;
+    }
+
+    aboveTarget.store(true, std::memory_order_relaxed);
+    if (firstAboveTime == Clock::time_point()) {
+        firstAboveTime = now + config.interval;
+        return false;
+    }
+
+    if (!dropping) {
+        if (now < firstAboveTime) {
+            return false;
+        }
+        // Delay stayed above target for a whole interval; resume near the last
+        // drop rate if we were dropping recently
+        dropping = true;
+        dropCount = (dropCount > 2 && now - dropNext < 16 * config.interval) ? dropCount - 2 : 1;
+        dropNext = now + std::chrono::duration_cast<Clock::duration>(config.interval / std::sqrt(dropCount));
+        return true;
+    }
+
+    if (now < dropNext) {
+        return false;
+    }
+    ++dropCount;
+    dropNext += std::chrono::duration_cast<Clock::duration>(config.interval / std::sqrt(dropCount));
+    return true;
+}
+
+LoadShedder::Stats LoadShedder::stats() const {
+    return Stats{rejected.load(std::memory_order_relaxed), displaced.load(std::memory_order_relaxed),
+                 dropped.load(std::memory_order_relaxed)};
+}
@@ -0,0 +1,78 @@
+#ifndef LOADSHEDDER_H
+#define LOADSHEDDER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+// What the thread pool model does with connections it cannot serve in time
+enum class ShedPolicy {
+    Block,        // the acceptor waits for room in the queue
+    RejectNew,    // a connection arriving at a full queue gets 503 right away
+    DropOldest,   // a connection arriving at a full queue displaces the longest-waiting one
+    CoDel         // shed at dequeue once queue delay stays above target for an interval
+};
+
+struct LoadShedderConfig {
+    ShedPolicy policy = ShedPolicy::RejectNew;
+    size_t queueCapacity = 1024;                    // accepted connections waiting for a worker
+    std::chrono::milliseconds target{5};            // CoDel: acceptable standing queue delay
+    std::chrono::milliseconds interval{100};        // CoDel: how long delay may exceed target
+};
+
+// Admission control for the thread pool's accept queue. The acceptor asks
+// what to do when the queue is full; workers ask whether a connection that
+// waited `queueDelay` should still be served. Only CoDel keeps state across
+// calls: it starts shedding when every connection in the last interval
+// waited longer than target, and sheds faster (interval / sqrt(drops)) for as
+// long as the delay stays high.
+class LoadShedder {
+public:
+    struct Stats {
+        uint64_t rejected;    // refused at accept
+        uint64_t displaced;   // pushed out of a full queue by a newer connection
+        uint64_t dropped;     // shed at dequeue
+    };
+
+    // What the acceptor does with a connection that finds the queue full
+    enum class Overflow {
+        Wait,             // wait for room, then queue it
+        Reject,           // refuse it
+        DisplaceOldest    // take the longest-waiting connection out of the queue, refuse that one, queue this
+    };
+
+    explicit LoadShedder(LoadShedderConfig config = LoadShedderConfig());
+
+    // The queue was full when a connection arrived
+    Overflow admitOverflow();
+
+    // A queued connection was refused to make room for a newer one
+    void recordDisplaced();
+
+    // Whether a connection leaving the queue after `queueDelay` must be shed
+    bool shedAtDequeue(std::chrono::steady_clock::duration queueDelay);
+
+    const LoadShedderConfig& settings() const { return config; }
+    Stats stats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    LoadShedderConfig config;
+    std::atomic<uint64_t> rejected;
+    std::atomic<uint64_t> displaced;
+    std::atomic<uint64_t> dropped;
+
+    // CoDel state
+    std::atomic<bool> aboveTarget;        // fast path: nothing to do while delay is below target
+    std::mutex codelMutex;
+    Clock::time_point firstAboveTime;     // when delay must still be above target to start dropping
+    Clock::time_point dropNext;
+    uint32_t dropCount;
+    bool dropping;
+
+    bool codelShouldDrop(Clock::duration queueDelay);
+};
+
+#endif // LOADSHEDDER_H
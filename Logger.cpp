@@ -1,4 +1,5 @@
 #include "Logger.h"
+#include "Metrics.h"
 #include "spdlog/sinks/rotating_file_sink.h"
 #include "spdlog/sinks/stdout_sinks.h"
 #include "spdlog/spdlog.h"
@@ -33,21 +34,31 @@ void setupLogger() {
     }
 }
 
+// Request and connection lines go to the access log, which formats and writes them on its own thread
+static AccessLog accessLog;
+
+void setupAccessLog(const AccessLogConfig& config) {
+    accessLog.start(config);
+}
+
+AccessLogStats accessLogStats() {
+    return accessLog.stats();
+}
+
 // Log detailed request information for tracking and debugging
-void logRequest(const std::string& clientIP, const std::string& method, 
-                const std::string& path, int statusCode, 
-                long waitingTime, long processingTime, long totalTime, 
-                std::string backendResponse) {
-    // Structured logging with comprehensive request details
-    spdlog::info(
-        "Request Details: "
-        "IP: {} | Method: {} | Path: {} | Status: {} | "
-        "Waiting Time: {} ms | Processing Time: {} ms | Total Time: {} ms | "
-        "Backend Response: {}", 
-        clientIP, method, path, statusCode, 
-        waitingTime, processingTime, totalTime, 
-        backendResponse
-    );
+void logRequest(std::string_view clientIP, std::string_view method,
+                std::string_view path, int statusCode,
+                long waitingTime, long processingTime, long totalTime,
+                std::string_view backendResponse) {
+    // Every answered request is logged once, so it is counted here too
+    metrics.countResponse(statusCode);
+
+    accessLog.append(clientIP, method, path, statusCode, waitingTime, processingTime, totalTime, backendResponse);
+}
+
+// Log how many requests a client connection carried before it closed
+void logConnection(const std::string& clientIP, int requestsServed, long connectionTime) {
+    accessLog.appendConnection(clientIP, requestsServed, connectionTime);
 }
 
 // Log errors with context for easier troubleshooting
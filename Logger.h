@@ -8,13 +8,18 @@
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/sinks/rotating_file_sink.h>
 #include <spdlog/async.h>
+#include <string_view>
+#include "AccessLog.h"
 
 
 
 void setupLogger();
-void logRequest(const std::string& clientIP, const std::string& method, 
-                const std::string& path, int statusCode, 
-                long waitingTime, long processingTime, long totalTime , std::string backendResponse);
+void setupAccessLog(const AccessLogConfig& config);
+AccessLogStats accessLogStats();
+void logRequest(std::string_view clientIP, std::string_view method,
+                std::string_view path, int statusCode,
+                long waitingTime, long processingTime, long totalTime, std::string_view backendResponse);
+void logConnection(const std::string& clientIP, int requestsServed, long connectionTime);
 void logError(const std::string& errorMessage, const std::string& context);
 
 #endif // LOGGER_H
@@ -1,19 +1,96 @@
 #include "Lrucache.h"
+#include "HttpCache.h"
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+
+// Odd multipliers giving each sketch row an independent slot for a key
+static constexpr uint64_t sketchSeeds[] = {
+    0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL, 0x9ae16a3b2f90404fULL, 0xcbf29ce484222325ULL
+};
+
+// Constructor: about one counter per expected entry in each row
+FrequencySketch::FrequencySketch(size_t expectedEntries) : width(64), additions(0) {
+    while (width < expectedEntries && width < (size_t(1) << 20)) {
+        width <<= 1;
+    }
+    counters.assign(width * depth, 0);
+    sampleSize = width * 10;
+}
+
+// Record one request for the key
+void FrequencySketch::increment(uint64_t hash) {
+    bool added = false;
+    for (int row = 0; row < depth; ++row) {
+        uint8_t& counter = counters[indexOf(hash, row)];
+        if (counter < 15) {
+            ++counter;
+            added = true;
+        }
+    }
+
+    // Halve every counter periodically so the sketch follows changes in popularity
+    if (added && ++additions >= sampleSize) {
+        for (uint8_t& counter : counters) {
+            counter >>= 1;
+        }
+        additions /= 2;
+    }
+}
+
+// Estimated recent requests for the key; collisions only ever overestimate
+unsigned FrequencySketch::frequency(uint64_t hash) const {
+    unsigned estimate = 15;
+    for (int row = 0; row < depth; ++row) {
+        estimate = std::min<unsigned>(estimate, counters[indexOf(hash, row)]);
+    }
+    return estimate;
+}
+
+size_t FrequencySketch::indexOf(uint64_t hash, int row) const {
+    uint64_t mixed = (hash ^ (hash >> 29)) * sketchSeeds[row];
+    mixed ^= mixed >> 32;
+    return row * width + (mixed & (width - 1));
+}
 
 // Constructor to initialize the cache with a given capacity
 template <typename KeyType, typename ValueType>
-LRUCache<KeyType, ValueType>::LRUCache(size_t capacity) : capacity(capacity) {}
+LRUCache<KeyType, ValueType>::LRUCache(size_t capacity) : LRUCache(CacheLimits{capacity, 0, 0}) {}
+
+// Constructor to initialize the cache with entry and byte limits and an eviction policy
+template <typename KeyType, typename ValueType>
+LRUCache<KeyType, ValueType>::LRUCache(const CacheLimits& limits, EvictionPolicy policy)
+    : limits(limits), policy(policy), bytes(0), evictions(0), rejected(0),
+      windowWeight(0), protectedWeight(0), windowCapacity(0), protectedCapacity(0) {
+    if (policy == EvictionPolicy::WTinyLFU) {
+        // 1% window, and 80% of the main region protected from one-hit newcomers
+        size_t capacity = limits.maxBytes != 0 ? limits.maxBytes : limits.maxEntries;
+        windowCapacity = std::max<size_t>(capacity / 100, 1);
+        protectedCapacity = (capacity - std::min(capacity, windowCapacity)) * 4 / 5;
+
+        size_t expectedEntries = limits.maxEntries != 0 ? limits.maxEntries : limits.maxBytes / 1024;
+        sketch = std::make_unique<FrequencySketch>(expectedEntries);
+    }
+}
 
 // Method to get the value associated with a key
 template <typename KeyType, typename ValueType>
-bool LRUCache<KeyType, ValueType>::get(const KeyType& key, ValueType& value) {
+bool LRUCache<KeyType, ValueType>::get(KeyView key, ValueType& value) {
     std::lock_guard<std::mutex> lock(cacheMutex);  // Lock the cache for thread safety
 
+    // Misses count too: a key requested often earns its place when it is next stored
+    if (sketch) {
+        sketch->increment(hashOf(key));
+    }
+
     // Check if the key is in the cache
-    if (cache.find(key) != cache.end()) {
-        value = cache[key]->second;  // Retrieve the value from the cache
-        // Move the key to the back of the list to mark it as most recently used
-        usageOrder.splice(usageOrder.end(), usageOrder, cache[key]);  // Move to the end of the list
+    auto entry = cache.find(key);
+    if (entry != cache.end()) {
+        value = entry->second->value;  // Retrieve the value from the cache
+        touch(entry->second);  // Mark it as most recently used
         return true;
     }
     return false;
@@ -22,25 +99,261 @@ bool LRUCache<KeyType, ValueType>::get(const KeyType& key, ValueType& value) {
 // Method to add or update a key-value pair in the cache
 template <typename KeyType, typename ValueType>
 void LRUCache<KeyType, ValueType>::put(const KeyType& key, const ValueType& value) {
+    put(key, ValueType(value));
+}
+
+// Method to add or update a key-value pair, taking over the value without a copy.
+// Entries are evicted according to the policy until the cache is back within its limits.
+template <typename KeyType, typename ValueType>
+void LRUCache<KeyType, ValueType>::put(const KeyType& key, ValueType&& value) {
+    size_t size = charge(key, value);
+
     std::lock_guard<std::mutex> lock(cacheMutex);  // Lock the cache for thread safety
 
+    auto existing = cache.find(key);
+
+    // An entry that could never fit is refused; drop the stale version too
+    if ((limits.maxEntryBytes != 0 && size > limits.maxEntryBytes) ||
+        (limits.maxBytes != 0 && size > limits.maxBytes)) {
+        ++rejected;
+        if (existing != cache.end()) {
+            remove(existing->second);
+        }
+        return;
+    }
+
     // Check if the key already exists in the cache
-    if (cache.find(key) != cache.end()) {
-        cache[key]->second = value;  // Update the value
-        // Move the key to the back of the list
-        usageOrder.splice(usageOrder.end(), usageOrder, cache[key]);  // Move to the end of the list
-    } else {
-        // If the cache is full, remove the least recently used (LRU) key
-        if (cache.size() >= capacity) {
-            KeyType lruKey = usageOrder.front().first;  // The front of the list is the least recently used
-            usageOrder.pop_front();  // Remove the LRU key from the list
-            cache.erase(lruKey);  // Remove the LRU key from the cache
+    if (existing != cache.end()) {
+        auto entry = existing->second;
+        Segment segment = entry->segment;
+        size_t oldWeight = weightOf(*entry);
+        bytes -= charge(entry->key, entry->value);
+        entry->value = std::move(value);  // Update the value
+        bytes += size;
+        if (segment == Segment::Window) {
+            windowWeight = windowWeight - oldWeight + weightOf(*entry);
+        } else if (segment == Segment::Protected) {
+            protectedWeight = protectedWeight - oldWeight + weightOf(*entry);
         }
-        // Add the new key-value pair to the cache
-        usageOrder.push_back(std::make_pair(key, value));  // Add to the list
+        touch(entry);
+    } else {
+        // Add the new key-value pair to the cache; W-TinyLFU starts it in the window
+        usageOrder.push_back(Entry{key, std::move(value), Segment::Window});  // Add to the list
         cache[key] = --usageOrder.end();  // Store the iterator to the list node
+        bytes += size;
+        windowWeight += weightOf(usageOrder.back());
+    }
+
+    // Entries pushed out of the window become candidates for the main region
+    if (policy == EvictionPolicy::WTinyLFU) {
+        while (windowWeight > windowCapacity && usageOrder.size() > 1) {
+            moveTo(usageOrder.begin(), Segment::Probation);
+        }
+    }
+
+    while (overLimits() && cache.size() > 1) {
+        evictOne();
+    }
+}
+
+// Method to remove a key, but only while it still holds the expected value,
+// so a late expiry cannot drop a newer entry stored under the same key
+template <typename KeyType, typename ValueType>
+bool LRUCache<KeyType, ValueType>::erase(KeyView key, const ValueType& expected) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto entry = cache.find(key);
+    if (entry == cache.end() || !(entry->second->value == expected)) {
+        return false;
+    }
+    remove(entry->second);
+    return true;
+}
+
+// Method to read the capacity counters
+template <typename KeyType, typename ValueType>
+CacheStats LRUCache<KeyType, ValueType>::stats() const {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    CacheStats result;
+    result.bytes = bytes;
+    result.entries = cache.size();
+    result.evictions = evictions;
+    result.rejected = rejected;
+    return result;
+}
+
+// Bytes an entry costs: its key and value plus the bookkeeping nodes
+template <typename KeyType, typename ValueType>
+size_t LRUCache<KeyType, ValueType>::charge(const KeyType& key, const ValueType& value) {
+    return cachedSize(key) + cachedSize(value) + entryOverhead;
+}
+
+template <typename KeyType, typename ValueType>
+uint64_t LRUCache<KeyType, ValueType>::hashOf(KeyView key) {
+    return static_cast<uint64_t>(typename KeyTraits<KeyType>::Hash{}(key));
+}
+
+// Share of the W-TinyLFU regions an entry takes
+template <typename KeyType, typename ValueType>
+size_t LRUCache<KeyType, ValueType>::weightOf(const Entry& entry) const {
+    return limits.maxBytes != 0 ? charge(entry.key, entry.value) : 1;
+}
+
+template <typename KeyType, typename ValueType>
+typename LRUCache<KeyType, ValueType>::EntryList& LRUCache<KeyType, ValueType>::listFor(Segment segment) {
+    switch (segment) {
+        case Segment::Probation:
+            return probation;
+        case Segment::Protected:
+            return protectedEntries;
+        default:
+            return usageOrder;
+    }
+}
+
+template <typename KeyType, typename ValueType>
+bool LRUCache<KeyType, ValueType>::overLimits() const {
+    return (limits.maxEntries != 0 && cache.size() > limits.maxEntries) ||
+           (limits.maxBytes != 0 && bytes > limits.maxBytes);
+}
+
+// Record a hit: move to the back of its list; a second hit on probation
+// promotes the entry, demoting the least recent protected ones if needed
+template <typename KeyType, typename ValueType>
+void LRUCache<KeyType, ValueType>::touch(typename EntryList::iterator entry) {
+    if (entry->segment == Segment::Probation) {
+        moveTo(entry, Segment::Protected);
+        while (protectedWeight > protectedCapacity && protectedEntries.size() > 1) {
+            moveTo(protectedEntries.begin(), Segment::Probation);
+        }
+        return;
+    }
+    EntryList& list = listFor(entry->segment);
+    list.splice(list.end(), list, entry);  // Move to the end of the list
+}
+
+// Move an entry to the most recent end of another segment
+template <typename KeyType, typename ValueType>
+void LRUCache<KeyType, ValueType>::moveTo(typename EntryList::iterator entry, Segment segment) {
+    size_t weight = weightOf(*entry);
+    if (entry->segment == Segment::Window) windowWeight -= weight;
+    if (entry->segment == Segment::Protected) protectedWeight -= weight;
+    if (segment == Segment::Window) windowWeight += weight;
+    if (segment == Segment::Protected) protectedWeight += weight;
+
+    EntryList& from = listFor(entry->segment);
+    entry->segment = segment;
+    EntryList& to = listFor(segment);
+    to.splice(to.end(), from, entry);
+}
+
+// Drop one entry. LRU takes the least recently used. W-TinyLFU pits the
+// newest probation entry against the least recent main-region entry and
+// keeps whichever the sketch says was requested more often.
+template <typename KeyType, typename ValueType>
+void LRUCache<KeyType, ValueType>::evictOne() {
+    ++evictions;
+
+    if (policy == EvictionPolicy::LRU || (probation.empty() && protectedEntries.empty())) {
+        remove(usageOrder.begin());
+        return;
+    }
+    if (probation.empty()) {
+        remove(protectedEntries.begin());
+        return;
     }
+
+    auto candidate = std::prev(probation.end());
+    auto victim = probation.size() > 1 ? probation.begin()
+                : !protectedEntries.empty() ? protectedEntries.begin()
+                : candidate;
+    if (victim != candidate &&
+        sketch->frequency(hashOf(candidate->key)) > sketch->frequency(hashOf(victim->key))) {
+        remove(victim);
+    } else {
+        remove(candidate);
+    }
+}
+
+template <typename KeyType, typename ValueType>
+void LRUCache<KeyType, ValueType>::remove(typename EntryList::iterator entry) {
+    size_t weight = weightOf(*entry);
+    if (entry->segment == Segment::Window) windowWeight -= weight;
+    if (entry->segment == Segment::Protected) protectedWeight -= weight;
+    bytes -= charge(entry->key, entry->value);
+    cache.erase(entry->key);
+    listFor(entry->segment).erase(entry);
+}
+
+// Constructor: split the capacity between shardCount independent caches
+template <typename KeyType, typename ValueType>
+ShardedLRUCache<KeyType, ValueType>::ShardedLRUCache(size_t capacity, size_t shardCount)
+    : ShardedLRUCache(CacheLimits{capacity, 0, 0}, shardCount) {}
+
+// Constructor: split the entry and byte limits between shardCount independent caches
+template <typename KeyType, typename ValueType>
+ShardedLRUCache<KeyType, ValueType>::ShardedLRUCache(const CacheLimits& limits, size_t shardCount,
+                                                     EvictionPolicy policy) {
+    if (shardCount == 0) {
+        shardCount = 1;
+    }
+
+    // Round up so no shard is left without room; the per-entry limit applies unchanged
+    CacheLimits perShard = limits;
+    perShard.maxEntries = (limits.maxEntries + shardCount - 1) / shardCount;
+    perShard.maxBytes = (limits.maxBytes + shardCount - 1) / shardCount;
+
+    shards.reserve(shardCount);
+    for (size_t i = 0; i < shardCount; ++i) {
+        shards.push_back(std::make_unique<LRUCache<KeyType, ValueType>>(perShard, policy));
+    }
+}
+
+template <typename KeyType, typename ValueType>
+bool ShardedLRUCache<KeyType, ValueType>::get(KeyView key, ValueType& value) {
+    return shardFor(key).get(key, value);
+}
+
+template <typename KeyType, typename ValueType>
+void ShardedLRUCache<KeyType, ValueType>::put(const KeyType& key, const ValueType& value) {
+    shardFor(key).put(key, value);
+}
+
+template <typename KeyType, typename ValueType>
+void ShardedLRUCache<KeyType, ValueType>::put(const KeyType& key, ValueType&& value) {
+    shardFor(key).put(key, std::move(value));
+}
+
+template <typename KeyType, typename ValueType>
+bool ShardedLRUCache<KeyType, ValueType>::erase(KeyView key, const ValueType& expected) {
+    return shardFor(key).erase(key, expected);
+}
+
+// Sum of the counters of every shard
+template <typename KeyType, typename ValueType>
+CacheStats ShardedLRUCache<KeyType, ValueType>::stats() const {
+    CacheStats total;
+    for (const auto& shard : shards) {
+        CacheStats stats = shard->stats();
+        total.bytes += stats.bytes;
+        total.entries += stats.entries;
+        total.evictions += stats.evictions;
+        total.rejected += stats.rejected;
+    }
+    return total;
+}
+
+// Pick the shard from the high bits of the mixed hash; the shard's own hash
+// map buckets by the low bits, so the two choices stay independent
+template <typename KeyType, typename ValueType>
+LRUCache<KeyType, ValueType>& ShardedLRUCache<KeyType, ValueType>::shardFor(KeyView key) {
+    uint64_t hash = static_cast<uint64_t>(typename KeyTraits<KeyType>::Hash{}(key)) * 0x9E3779B97F4A7C15ULL;
+    return *shards[(hash >> 32) % shards.size()];
 }
 
 // Explicit template instantiation for commonly used types
 template class LRUCache<std::string, std::string>;
+template class ShardedLRUCache<std::string, std::string>;
+template class LRUCache<std::string, std::shared_ptr<const std::string>>;
+template class ShardedLRUCache<std::string, std::shared_ptr<const std::string>>;
+template class LRUCache<std::string, std::shared_ptr<const CachedEntry>>;
+template class ShardedLRUCache<std::string, std::shared_ptr<const CachedEntry>>;
@@ -1,23 +1,164 @@
 #ifndef LRU_CACHE_H
 #define LRU_CACHE_H
 
+#include <cstdint>
 #include <iostream>
 #include <list>
+#include <memory>
+#include <string>
+#include <string_view>
 #include <unordered_map>
 #include <mutex>
+#include <vector>
+
+// Limits of a cache; 0 disables a limit
+struct CacheLimits {
+    size_t maxEntries = 0;
+    size_t maxBytes = 0;        // budget for keys, values and per-entry bookkeeping
+    size_t maxEntryBytes = 0;   // larger entries are never admitted
+};
+
+// Capacity counters of a cache
+struct CacheStats {
+    size_t bytes = 0;
+    size_t entries = 0;
+    uint64_t evictions = 0;     // entries dropped to make room, or refused admission by the policy
+    uint64_t rejected = 0;      // entries refused for exceeding maxEntryBytes
+};
+
+// How a full cache chooses what to drop
+enum class EvictionPolicy {
+    LRU,        // drop the least recently used entry
+    WTinyLFU    // small LRU window in front of a segmented LRU main region; a newcomer
+                // leaving the window only displaces a main entry it is more popular than
+};
+
+// Bytes a key or value is charged against the budget
+inline size_t cachedSize(const std::string& value) { return value.size(); }
+template <typename T>
+inline size_t cachedSize(const std::shared_ptr<const T>& value) { return value ? cachedSize(*value) : 0; }
+
+// How keys are hashed, compared and passed to lookups. std::string keys are
+// found from any string_view, so a caller holding the key in scratch memory
+// does not copy it into a std::string just to look it up.
+template <typename KeyType>
+struct KeyTraits {
+    using View = const KeyType&;
+    using Hash = std::hash<KeyType>;
+    using Equal = std::equal_to<KeyType>;
+};
+
+template <>
+struct KeyTraits<std::string> {
+    using View = std::string_view;
+    struct Hash {
+        using is_transparent = void;
+        size_t operator()(std::string_view key) const { return std::hash<std::string_view>{}(key); }
+    };
+    using Equal = std::equal_to<>;
+};
+
+// Count-min sketch of how often keys were requested lately. Counters saturate
+// at 15 and are halved every few thousand requests so old popularity fades.
+class FrequencySketch {
+public:
+    explicit FrequencySketch(size_t expectedEntries);
+    void increment(uint64_t hash);
+    unsigned frequency(uint64_t hash) const;
+
+private:
+    static constexpr int depth = 4;
+
+    std::vector<uint8_t> counters;   // depth rows of `width` counters
+    size_t width;
+    size_t additions;
+    size_t sampleSize;               // additions between two halvings
+
+    size_t indexOf(uint64_t hash, int row) const;
+};
 
 template <typename KeyType, typename ValueType>
 class LRUCache {
 public:
+    using KeyView = typename KeyTraits<KeyType>::View;
+
     LRUCache(size_t capacity);
-    bool get(const KeyType& key, ValueType& value);
+    LRUCache(const CacheLimits& limits, EvictionPolicy policy = EvictionPolicy::LRU);
+    bool get(KeyView key, ValueType& value);
     void put(const KeyType& key, const ValueType& value);
+    void put(const KeyType& key, ValueType&& value);
+    bool erase(KeyView key, const ValueType& expected);
+    CacheStats stats() const;
 
 private:
-    size_t capacity;
-    std::list<std::pair<KeyType, ValueType>> usageOrder;  // List to keep track of access order (key, value)
-    std::unordered_map<KeyType, typename std::list<std::pair<KeyType, ValueType>>::iterator> cache;  // Hash map for O(1) access to list node
-    std::mutex cacheMutex;  // Mutex for thread safety
+    enum class Segment { Window, Probation, Protected };
+
+    struct Entry {
+        KeyType key;
+        ValueType value;
+        Segment segment;
+    };
+    using EntryList = std::list<Entry>;
+
+    // Approximate allocator cost of one entry: the list node and the hash map node
+    static constexpr size_t entryOverhead = sizeof(Entry) + 2 * sizeof(void*) +
+                                            sizeof(KeyType) + 3 * sizeof(void*) + sizeof(size_t);
+
+    CacheLimits limits;
+    EvictionPolicy policy;
+    size_t bytes;
+    uint64_t evictions;
+    uint64_t rejected;
+
+    // LRU keeps every entry in usageOrder; W-TinyLFU uses it as the window
+    EntryList usageOrder;  // List to keep track of access order, least recent first
+    EntryList probation;   // Main region entries seen once since entering it
+    EntryList protectedEntries;  // Main region entries hit again while on probation
+    std::unordered_map<KeyType, typename EntryList::iterator, typename KeyTraits<KeyType>::Hash,
+                       typename KeyTraits<KeyType>::Equal> cache;  // Hash map for O(1) access to list node
+    mutable std::mutex cacheMutex;  // Mutex for thread safety
+
+    // W-TinyLFU only; sizes are in bytes under a byte budget, in entries otherwise
+    std::unique_ptr<FrequencySketch> sketch;
+    size_t windowWeight;
+    size_t protectedWeight;
+    size_t windowCapacity;
+    size_t protectedCapacity;
+
+    static size_t charge(const KeyType& key, const ValueType& value);
+    static uint64_t hashOf(KeyView key);
+    size_t weightOf(const Entry& entry) const;
+    EntryList& listFor(Segment segment);
+    bool overLimits() const;
+    void touch(typename EntryList::iterator entry);
+    void moveTo(typename EntryList::iterator entry, Segment segment);
+    void evictOne();
+    void remove(typename EntryList::iterator entry);
+};
+
+// LRU cache split into independent shards, each with its own lock and LRU
+// list, so threads touching different keys do not serialize on one mutex.
+// A key always maps to the same shard; capacity and byte budget are divided
+// evenly between them.
+template <typename KeyType, typename ValueType>
+class ShardedLRUCache {
+public:
+    using KeyView = typename KeyTraits<KeyType>::View;
+
+    ShardedLRUCache(size_t capacity, size_t shardCount);
+    ShardedLRUCache(const CacheLimits& limits, size_t shardCount, EvictionPolicy policy = EvictionPolicy::LRU);
+    bool get(KeyView key, ValueType& value);
+    void put(const KeyType& key, const ValueType& value);
+    void put(const KeyType& key, ValueType&& value);
+    bool erase(KeyView key, const ValueType& expected);
+    CacheStats stats() const;
+
+    size_t shardCount() const { return shards.size(); }
+
+private:
+    std::vector<std::unique_ptr<LRUCache<KeyType, ValueType>>> shards;
+
+    LRUCache<KeyType, ValueType>& shardFor(KeyView key);
 };
 
 #endif
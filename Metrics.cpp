@@ -0,0 +1,205 @@
+#include "Metrics.h"
+#include <bit>
+#include <charconv>
+
+MetricsRegistry metrics;
+
+static const char* const counterNames[] = {
+    "cache_hit", "cache_miss", "rate_limited", "2xx", "3xx", "4xx", "5xx"
+};
+
+static const char* const stageNames[] = {
+    "queue_wait", "parse", "cache_lookup", "backend_connect", "backend_first_byte", "backend_total", "send"
+};
+
+// Bucket bounds published for Prometheus, in microseconds; the fine buckets stay internal
+static const uint64_t publishedBounds[] = {
+    50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000,
+    1000000, 2500000, 5000000, 10000000
+};
+
+static const double publishedQuantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+size_t LatencyBuckets::indexOf(uint64_t micros) {
+    if (micros < SubBuckets) {
+        return static_cast<size_t>(micros);
+    }
+    // The highest bit picks the power of two, the next SubBucketBits bits the bucket within it
+    int shift = std::bit_width(micros) - 1 - SubBucketBits;
+    size_t index = static_cast<size_t>(shift + 1) * SubBuckets + static_cast<size_t>((micros >> shift) - SubBuckets);
+    return index < BucketCount ? index : BucketCount - 1;
+}
+
+uint64_t LatencyBuckets::upperBound(size_t index) {
+    if (index < SubBuckets) {
+        return index + 1;
+    }
+    int shift = static_cast<int>(index / SubBuckets) - 1;
+    return (SubBuckets + index % SubBuckets + 1) << shift;
+}
+
+// Only the owning thread writes a shard, so a plain load and store replaces a locked read-modify-write
+static void add(std::atomic<uint64_t>& value, uint64_t amount) {
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+// Function to find the shard of the calling thread, adding it on first use.
+// There is one registry per process, so the thread_local needs no owner.
+MetricsShard& MetricsRegistry::localShard() {
+    thread_local MetricsShard* shard = nullptr;
+    if (shard == nullptr) {
+        std::lock_guard<std::mutex> lock(shardsMutex);
+        shards.push_back(std::make_unique<MetricsShard>());
+        shard = shards.back().get();
+    }
+    return *shard;
+}
+
+void MetricsRegistry::count(Counter counter, uint64_t amount) {
+    add(localShard().counters[static_cast<size_t>(counter)], amount);
+}
+
+void MetricsRegistry::countResponse(int statusCode) {
+    if (statusCode >= 200 && statusCode < 600) {
+        count(static_cast<Counter>(static_cast<int>(Counter::Responses2xx) + statusCode / 100 - 2));
+    }
+}
+
+void MetricsRegistry::record(Stage stage, std::chrono::nanoseconds duration) {
+    uint64_t micros = duration.count() > 0
+        ? static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count())
+        : 0;
+    MetricsShard::Histogram& histogram = localShard().histograms[static_cast<size_t>(stage)];
+    add(histogram.buckets[LatencyBuckets::indexOf(micros)], 1);
+    add(histogram.sumMicros, micros);
+}
+
+// Function to append a sample value the way Prometheus parses it
+static void appendNumber(std::string& text, double value) {
+    char buffer[32];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    text.append(buffer, result.ptr);
+}
+
+static void appendNumber(std::string& text, uint64_t value) {
+    char buffer[24];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    text.append(buffer, result.ptr);
+}
+
+void MetricsPage::describe(std::string_view name, std::string_view type, std::string_view help) {
+    page.append("# HELP ").append(name).append(" ").append(help).append("\n");
+    page.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+}
+
+void MetricsPage::sample(std::string_view name, std::string_view labels, double value) {
+    page.append(name);
+    if (!labels.empty()) {
+        page.append("{").append(labels).append("}");
+    }
+    page.append(" ");
+    appendNumber(page, value);
+    page.append("\n");
+}
+
+void MetricsPage::sample(std::string_view name, std::string_view labels, uint64_t value) {
+    page.append(name);
+    if (!labels.empty()) {
+        page.append("{").append(labels).append("}");
+    }
+    page.append(" ");
+    appendNumber(page, value);
+    page.append("\n");
+}
+
+// Function to find the value below which `quantile` of the recorded values fall,
+// reported as the highest value of its bucket
+static double quantileSeconds(const std::vector<uint64_t>& buckets, double quantile) {
+    uint64_t count = 0;
+    for (uint64_t n : buckets) {
+        count += n;
+    }
+    if (count == 0) {
+        return 0.0;
+    }
+    uint64_t rank = static_cast<uint64_t>(quantile * static_cast<double>(count - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return static_cast<double>(LatencyBuckets::upperBound(i) - 1) / 1e6;
+        }
+    }
+    return static_cast<double>(LatencyBuckets::upperBound(buckets.size() - 1) - 1) / 1e6;
+}
+
+void MetricsRegistry::render(MetricsPage& page) const {
+    constexpr size_t counterCount = static_cast<size_t>(Counter::Count);
+    constexpr size_t stageCount = static_cast<size_t>(Stage::Count);
+
+    // Add up the shards; values keep moving meanwhile, which a scrape tolerates
+    std::array<uint64_t, counterCount> counters{};
+    std::vector<std::vector<uint64_t>> buckets(stageCount, std::vector<uint64_t>(LatencyBuckets::BucketCount));
+    std::array<uint64_t, stageCount> sums{};
+    {
+        std::lock_guard<std::mutex> lock(shardsMutex);
+        for (const auto& shard : shards) {
+            for (size_t c = 0; c < counterCount; ++c) {
+                counters[c] += shard->counters[c].load(std::memory_order_relaxed);
+            }
+            for (size_t s = 0; s < stageCount; ++s) {
+                const MetricsShard::Histogram& histogram = shard->histograms[s];
+                for (size_t b = 0; b < LatencyBuckets::BucketCount; ++b) {
+                    buckets[s][b] += histogram.buckets[b].load(std::memory_order_relaxed);
+                }
+                sums[s] += histogram.sumMicros.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    page.describe("proxy_cache_lookups_total", "counter", "Requests looked up in the response cache, by result.");
+    for (size_t c = static_cast<size_t>(Counter::CacheHits); c <= static_cast<size_t>(Counter::CacheMisses); ++c) {
+        page.sample("proxy_cache_lookups_total", std::string("result=\"") + counterNames[c] + "\"", counters[c]);
+    }
+    page.describe("proxy_rate_limited_total", "counter", "Requests refused by the rate limiter.");
+    page.sample("proxy_rate_limited_total", "", counters[static_cast<size_t>(Counter::RateLimited)]);
+    page.describe("proxy_responses_total", "counter", "Requests answered, by status class.");
+    for (size_t c = static_cast<size_t>(Counter::Responses2xx); c < counterCount; ++c) {
+        page.sample("proxy_responses_total", std::string("code=\"") + counterNames[c] + "\"", counters[c]);
+    }
+
+    // Bucket counts are exact except for values in the fine bucket straddling a bound,
+    // which are counted under the next bound
+    page.describe("proxy_stage_duration_seconds", "histogram", "Latency of each stage of a request.");
+    for (size_t s = 0; s < stageCount; ++s) {
+        std::string stage = std::string("stage=\"") + stageNames[s] + "\"";
+        uint64_t cumulative = 0;
+        size_t b = 0;
+        for (uint64_t bound : publishedBounds) {
+            while (b < LatencyBuckets::BucketCount && LatencyBuckets::upperBound(b) - 1 <= bound) {
+                cumulative += buckets[s][b++];
+            }
+            std::string labels = stage + ",le=\"";
+            appendNumber(labels, static_cast<double>(bound) / 1e6);
+            page.sample("proxy_stage_duration_seconds_bucket", labels + "\"", cumulative);
+        }
+        // Shards are read while written, so the total comes from the buckets to stay consistent with them
+        while (b < LatencyBuckets::BucketCount) {
+            cumulative += buckets[s][b++];
+        }
+        page.sample("proxy_stage_duration_seconds_bucket", stage + ",le=\"+Inf\"", cumulative);
+        page.sample("proxy_stage_duration_seconds_sum", stage, static_cast<double>(sums[s]) / 1e6);
+        page.sample("proxy_stage_duration_seconds_count", stage, cumulative);
+    }
+
+    page.describe("proxy_stage_duration_quantile_seconds", "gauge",
+                  "Latency quantiles of each stage since start, to within 1/16.");
+    for (size_t s = 0; s < stageCount; ++s) {
+        for (double quantile : publishedQuantiles) {
+            std::string labels = std::string("stage=\"") + stageNames[s] + "\",quantile=\"";
+            appendNumber(labels, quantile);
+            page.sample("proxy_stage_duration_quantile_seconds", labels + "\"",
+                        quantileSeconds(buckets[s], quantile));
+        }
+    }
+}
@@ -0,0 +1,105 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Events counted on the request path
+enum class Counter {
+    CacheHits,
+    CacheMisses,
+    RateLimited,
+    Responses2xx,
+    Responses3xx,
+    Responses4xx,
+    Responses5xx,
+    Count
+};
+
+// Stages of a request whose latency is recorded
+enum class Stage {
+    QueueWait,          // accepted until a worker picked the connection up
+    Parse,              // parsing the buffered request
+    CacheLookup,
+    BackendConnect,     // a new backend connection, not a pooled one
+    BackendFirstByte,   // request sent until the first response byte
+    BackendTotal,       // the whole backend exchange, retries and hedges included
+    Send,               // writing a response held whole in memory (cache hits, errors)
+    Count
+};
+
+// Log-linear histogram of microsecond latencies in the style of HdrHistogram:
+// exact below 16 us, then 16 buckets per power of two, so any recorded value
+// is known to within 1/16 (about 6%) up to roughly 19 hours
+struct LatencyBuckets {
+    static constexpr int SubBucketBits = 4;
+    static constexpr size_t SubBuckets = size_t{1} << SubBucketBits;
+    static constexpr int MaxExponent = 36;   // 2^36 us; longer values land in the last bucket
+    static constexpr size_t BucketCount = (MaxExponent - SubBucketBits + 2) * SubBuckets;
+
+    static size_t indexOf(uint64_t micros);
+    static uint64_t upperBound(size_t index);   // exclusive, in microseconds
+};
+
+// Counters and histograms written by one thread only
+struct MetricsShard {
+    std::array<std::atomic<uint64_t>, static_cast<size_t>(Counter::Count)> counters{};
+    struct Histogram {
+        std::array<std::atomic<uint64_t>, LatencyBuckets::BucketCount> buckets{};
+        std::atomic<uint64_t> sumMicros{0};
+    };
+    std::array<Histogram, static_cast<size_t>(Stage::Count)> histograms{};
+};
+
+// Text in the Prometheus exposition format. Each family is described once,
+// then sampled under as many label sets as it has.
+class MetricsPage {
+public:
+    void describe(std::string_view name, std::string_view type, std::string_view help);
+    void sample(std::string_view name, std::string_view labels, double value);
+    void sample(std::string_view name, std::string_view labels, uint64_t value);
+
+    std::string& text() { return page; }
+
+private:
+    std::string page;
+};
+
+// Process-wide metrics. Every thread records into a shard of its own with
+// relaxed single-writer updates, so the request path neither locks nor
+// contends on a cache line; shards are only added up when scraped. Shards
+// outlive their threads so counters never go backwards.
+class MetricsRegistry {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void count(Counter counter, uint64_t amount = 1);
+
+    // Count a response under its status class
+    void countResponse(int statusCode);
+
+    void record(Stage stage, std::chrono::nanoseconds duration);
+
+    // Record the time since `startedAt`
+    void record(Stage stage, Clock::time_point startedAt) { record(stage, Clock::now() - startedAt); }
+
+    // Merge all shards into the page
+    void render(MetricsPage& page) const;
+
+private:
+    mutable std::mutex shardsMutex;   // Guards the shard list, not the values in it
+    std::vector<std::unique_ptr<MetricsShard>> shards;
+
+    MetricsShard& localShard();
+};
+
+extern MetricsRegistry metrics;
+
+#endif // METRICS_H
@@ -0,0 +1,86 @@
+#include "RateLimitPolicy.h"
+
+// A rule together with the buckets that enforce it
+class RateLimitPolicies::Policy {
+public:
+    explicit Policy(const RateLimitRule& rule)
+        : rule(rule),
+          hits(makeLimiter(rule.hitBudget)),
+          misses(makeLimiter(rule.missBudget)) {}
+
+    RateLimitRule rule;
+    AdvancedRateLimiter hits;
+    AdvancedRateLimiter misses;
+
+private:
+    static AdvancedRateLimiter makeLimiter(const RateLimitBudget& budget) {
+        return AdvancedRateLimiter(budget.globalMaxTokens, budget.globalRefillRate,
+                                   budget.perIPMaxTokens, budget.perIPRefillRate,
+                                   budget.trackingWindow, 64, budget.maxTrackedIPs);
+    }
+};
+
+RateLimitPolicies::RateLimitPolicies(const RateLimitRule& defaultRule, const std::vector<RateLimitRule>& rules) {
+    configure(defaultRule, rules);
+}
+
+RateLimitPolicies::~RateLimitPolicies() = default;
+
+void RateLimitPolicies::configure(const RateLimitRule& defaultRule, const std::vector<RateLimitRule>& rules) {
+    policies.clear();
+    policies.push_back(std::make_unique<Policy>(defaultRule));
+    for (const RateLimitRule& rule : rules) {
+        policies.push_back(std::make_unique<Policy>(rule));
+    }
+}
+
+RateLimitPolicies::Policy& RateLimitPolicies::match(std::string_view method, std::string_view path) const {
+    Policy* best = policies.front().get();
+    size_t bestPrefix = 0;
+    bool bestHasMethod = false;
+    for (size_t i = 1; i < policies.size(); ++i) {
+        const RateLimitRule& rule = policies[i]->rule;
+        if (!rule.method.empty() && rule.method != method) {
+            continue;
+        }
+        if (path.substr(0, rule.pathPrefix.size()) != rule.pathPrefix) {
+            continue;
+        }
+
+        bool hasMethod = !rule.method.empty();
+        if (best == policies.front().get() || rule.pathPrefix.size() > bestPrefix ||
+            (rule.pathPrefix.size() == bestPrefix && hasMethod && !bestHasMethod)) {
+            best = policies[i].get();
+            bestPrefix = rule.pathPrefix.size();
+            bestHasMethod = hasMethod;
+        }
+    }
+    return *best;
+}
+
+bool RateLimitPolicies::allow(Policy& policy, Charge charge, const struct sockaddr_in& clientAddress) {
+    if (charge == Charge::CacheHit) {
+        return policy.hits.allowRequest(clientAddress, policy.rule.hitCost);
+    }
+    return policy.misses.allowRequest(clientAddress, policy.rule.missCost);
+}
+
+void RateLimitPolicies::reapStaleEntries(size_t shardBudget) {
+    for (auto& policy : policies) {
+        policy->hits.reapStaleEntries(shardBudget);
+        policy->misses.reapStaleEntries(shardBudget);
+    }
+}
+
+RateLimiterStats RateLimitPolicies::stats() const {
+    RateLimiterStats total;
+    for (const auto& policy : policies) {
+        for (const AdvancedRateLimiter* limiter : {&policy->hits, &policy->misses}) {
+            RateLimiterStats stats = limiter->stats();
+            total.trackedIPs += stats.trackedIPs;
+            total.evicted += stats.evicted;
+            total.expired += stats.expired;
+        }
+    }
+    return total;
+}
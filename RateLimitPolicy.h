@@ -0,0 +1,65 @@
+#ifndef RATE_LIMIT_POLICY_H
+#define RATE_LIMIT_POLICY_H
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "TokenBucket.h"
+
+// Bucket parameters of one rate limit budget
+struct RateLimitBudget {
+    int globalMaxTokens = 10000;
+    double globalRefillRate = 10.0;
+    int perIPMaxTokens = 100;
+    double perIPRefillRate = 2.0;
+    std::chrono::seconds trackingWindow{60};
+    size_t maxTrackedIPs = 100000;
+};
+
+// Rate limits for requests matching a method and path prefix. Cache hits and
+// backend fetches draw on separate budgets, so throttling backend traffic does
+// not also throttle cheap cached responses.
+struct RateLimitRule {
+    std::string method;             // empty matches every method
+    std::string pathPrefix;         // empty matches every path
+    RateLimitBudget hitBudget{100000, 1000.0, 1000, 100.0};
+    RateLimitBudget missBudget;
+    double hitCost = 1.0;           // tokens taken per cache hit; 0 makes hits free
+    double missCost = 1.0;          // tokens taken per backend fetch
+};
+
+// Rate limit rules evaluated after a request is parsed and the cache consulted.
+// The rule with the longest matching path prefix applies, a method-specific
+// rule winning over one for every method; requests nothing matches use the
+// default rule.
+class RateLimitPolicies {
+public:
+    // What serving the request will cost
+    enum class Charge { CacheHit, BackendFetch };
+
+    class Policy;
+
+    explicit RateLimitPolicies(const RateLimitRule& defaultRule = RateLimitRule(),
+                               const std::vector<RateLimitRule>& rules = {});
+    ~RateLimitPolicies();
+
+    // Replace the rules; only before serving starts
+    void configure(const RateLimitRule& defaultRule, const std::vector<RateLimitRule>& rules);
+
+    Policy& match(std::string_view method, std::string_view path) const;
+
+    // Take the request's tokens from the policy's hit or miss budget
+    bool allow(Policy& policy, Charge charge, const struct sockaddr_in& clientAddress);
+
+    // Clear idle clients from the next `shardBudget` shards of every bucket
+    void reapStaleEntries(size_t shardBudget);
+
+    RateLimiterStats stats() const;
+
+private:
+    std::vector<std::unique_ptr<Policy>> policies;   // default first
+};
+
+#endif // RATE_LIMIT_POLICY_H
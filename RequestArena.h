@@ -0,0 +1,36 @@
+#ifndef REQUEST_ARENA_H
+#define REQUEST_ARENA_H
+
+#include <cstddef>
+#include <memory_resource>
+#include <string>
+
+// Scratch memory for the request a connection is serving. Strings that die
+// with the request (the cache key, the backend request) are bump-allocated
+// from a buffer inside the arena and all freed at once by reset() instead of
+// one malloc and free each. A request needing more spills into heap blocks,
+// which reset() returns as well.
+class RequestArena {
+public:
+    static constexpr size_t InlineBytes = 4096;
+
+    RequestArena() : memory(initial, sizeof(initial)) {}
+
+    RequestArena(const RequestArena&) = delete;
+    RequestArena& operator=(const RequestArena&) = delete;
+
+    std::pmr::memory_resource* resource() { return &memory; }
+
+    // Free everything allocated since the last reset. Containers still using
+    // the arena must give their memory back first, see forget().
+    void reset() { memory.release(); }
+
+    // Empty a string allocated from an arena, dropping its buffer too
+    static void forget(std::pmr::string& value) { value = std::pmr::string(value.get_allocator()); }
+
+private:
+    alignas(std::max_align_t) std::byte initial[InlineBytes];
+    std::pmr::monotonic_buffer_resource memory;
+};
+
+#endif // REQUEST_ARENA_H
@@ -0,0 +1,337 @@
+#include "Resolver.h"
+#include "Logger.h"
+#include <arpa/inet.h>
+#include <arpa/nameser.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <resolv.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <strings.h>
+
+// Function to build a socket address from a textual IPv4 or IPv6 address
+static bool parseAddress(const std::string& text, uint16_t port, SocketAddress& address) {
+    address = SocketAddress();
+    auto* v4 = reinterpret_cast<struct sockaddr_in*>(&address.storage);
+    if (inet_pton(AF_INET, text.c_str(), &v4->sin_addr) == 1) {
+        v4->sin_family = AF_INET;
+        v4->sin_port = htons(port);
+        address.length = sizeof(struct sockaddr_in);
+        return true;
+    }
+    auto* v6 = reinterpret_cast<struct sockaddr_in6*>(&address.storage);
+    if (inet_pton(AF_INET6, text.c_str(), &v6->sin6_addr) == 1) {
+        v6->sin6_family = AF_INET6;
+        v6->sin6_port = htons(port);
+        address.length = sizeof(struct sockaddr_in6);
+        return true;
+    }
+    return false;
+}
+
+std::string SocketAddress::toString() const {
+    char text[INET6_ADDRSTRLEN] = "";
+    if (family() == AF_INET) {
+        auto* v4 = reinterpret_cast<const struct sockaddr_in*>(&storage);
+        inet_ntop(AF_INET, &v4->sin_addr, text, sizeof(text));
+        return std::string(text) + ":" + std::to_string(ntohs(v4->sin_port));
+    }
+    auto* v6 = reinterpret_cast<const struct sockaddr_in6*>(&storage);
+    inet_ntop(AF_INET6, &v6->sin6_addr, text, sizeof(text));
+    return "[" + std::string(text) + "]:" + std::to_string(ntohs(v6->sin6_port));
+}
+
+const SocketAddress& Resolution::pick() const {
+    return addresses[next.fetch_add(1, std::memory_order_relaxed) % addresses.size()];
+}
+
+Resolver::Resolver(ResolverConfig config)
+    : config(std::move(config)),
+      stopping(false),
+      hits(0),
+      misses(0),
+      refreshes(0),
+      failures(0),
+      staleServed(0) {
+    refresher = std::thread([this]() { runRefresher(); });
+}
+
+Resolver::~Resolver() {
+    {
+        std::lock_guard<std::mutex> lock(refresherMutex);
+        stopping = true;
+    }
+    refresherWake.notify_one();
+    refresher.join();
+}
+
+void Resolver::configure(const ResolverConfig& newConfig) {
+    std::lock_guard<std::mutex> lock(refresherMutex);
+    std::unique_lock<std::shared_mutex> entriesLock(entriesMutex);
+    config = newConfig;
+    entries.clear();
+}
+
+std::shared_ptr<const Resolution> Resolver::resolve(const std::string& host, uint16_t port) {
+    std::string key = host + ":" + std::to_string(port);
+    Clock::time_point now = Clock::now();
+    {
+        std::shared_lock<std::shared_mutex> lock(entriesMutex);
+        auto position = entries.find(key);
+        if (position != entries.end()) {
+            Entry& entry = *position->second;
+            entry.lastUsed.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+            std::shared_ptr<const Resolution> current = entry.current;
+            if (now < current->expiresAt) {
+                hits.fetch_add(1, std::memory_order_relaxed);
+                return current;
+            }
+            // The refresher could not renew the records; they are still the best we have
+            if (!current->addresses.empty() && now < current->expiresAt + config.serveStale) {
+                staleServed.fetch_add(1, std::memory_order_relaxed);
+                return current;
+            }
+        }
+    }
+
+    // First use of the name (or records too stale to trust): resolve here
+    misses.fetch_add(1, std::memory_order_relaxed);
+    std::shared_ptr<const Resolution> fresh = lookup(host, port);
+    {
+        std::unique_lock<std::shared_mutex> lock(entriesMutex);
+        std::unique_ptr<Entry>& entry = entries[key];
+        if (!entry) {
+            entry = std::make_unique<Entry>();
+            entry->host = host;
+            entry->port = port;
+        }
+        entry->current = fresh;
+        entry->refreshAt = refreshTime(*fresh);
+        entry->lastUsed.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+    }
+
+    // The refresher may be sleeping past this entry's refresh time
+    { std::lock_guard<std::mutex> lock(refresherMutex); }
+    refresherWake.notify_one();
+    return fresh;
+}
+
+void Resolver::warm(const std::string& host, uint16_t port) {
+    if (resolve(host, port)->addresses.empty()) {
+        logError("DNS resolution failed", host);
+    }
+}
+
+ResolverStats Resolver::stats() const {
+    return ResolverStats{hits.load(std::memory_order_relaxed), misses.load(std::memory_order_relaxed),
+                         refreshes.load(std::memory_order_relaxed), failures.load(std::memory_order_relaxed),
+                         staleServed.load(std::memory_order_relaxed)};
+}
+
+// Function to resolve a name through every source in turn
+std::shared_ptr<Resolution> Resolver::lookup(const std::string& host, uint16_t port) {
+    auto result = std::make_shared<Resolution>();
+    result->resolvedAt = Clock::now();
+
+    // Literal addresses never change
+    SocketAddress literal;
+    if (parseAddress(host, port, literal)) {
+        result->addresses.push_back(literal);
+        result->expiresAt = result->resolvedAt + config.maxTtl;
+        return result;
+    }
+
+    if (lookupHostsFile(host, port, *result) || lookupDns(host, port, *result) ||
+        lookupSystem(host, port, *result)) {
+        return result;
+    }
+
+    failures.fetch_add(1, std::memory_order_relaxed);
+    result->addresses.clear();
+    result->expiresAt = result->resolvedAt + config.negativeTtl;
+    return result;
+}
+
+// Function to find a name in the hosts file; entries there live for defaultTtl
+bool Resolver::lookupHostsFile(const std::string& host, uint16_t port, Resolution& result) const {
+    if (config.hostsFile.empty()) {
+        return false;
+    }
+    std::ifstream hosts(config.hostsFile);
+    std::string line;
+    while (std::getline(hosts, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string addressText;
+        std::string name;
+        if (!(fields >> addressText)) {
+            continue;
+        }
+        while (fields >> name) {
+            SocketAddress address;
+            if (strcasecmp(name.c_str(), host.c_str()) == 0 && parseAddress(addressText, port, address)) {
+                result.addresses.push_back(address);
+                break;
+            }
+        }
+    }
+    result.expiresAt = result.resolvedAt + config.defaultTtl;
+    return !result.addresses.empty();
+}
+
+// Function to query DNS for A and AAAA records; the shortest record TTL bounds the result
+bool Resolver::lookupDns(const std::string& host, uint16_t port, Resolution& result) const {
+    struct __res_state state{};
+    if (res_ninit(&state) != 0) {
+        return false;
+    }
+
+    if (!config.nameserver.empty()) {
+        std::string address = config.nameserver;
+        uint16_t nameserverPort = NAMESERVER_PORT;
+        size_t colon = address.rfind(':');
+        if (colon != std::string::npos) {
+            nameserverPort = static_cast<uint16_t>(std::stoi(address.substr(colon + 1)));
+            address.resize(colon);
+        }
+        state.nscount = 1;
+        state.nsaddr_list[0] = {};
+        state.nsaddr_list[0].sin_family = AF_INET;
+        state.nsaddr_list[0].sin_port = htons(nameserverPort);
+        inet_pton(AF_INET, address.c_str(), &state.nsaddr_list[0].sin_addr);
+    }
+
+    uint32_t ttl = UINT32_MAX;
+    unsigned char answer[4096];
+    for (ns_type type : {ns_t_a, ns_t_aaaa}) {
+        int length = res_nsearch(&state, host.c_str(), ns_c_in, type, answer, sizeof(answer));
+        ns_msg message;
+        if (length < 0 || ns_initparse(answer, length, &message) < 0) {
+            continue;
+        }
+        for (int i = 0; i < ns_msg_count(message, ns_s_an); ++i) {
+            ns_rr record;
+            if (ns_parserr(&message, ns_s_an, i, &record) < 0) {
+                break;
+            }
+
+            // Skip the CNAMEs on the way to the addresses
+            SocketAddress address;
+            if (type == ns_t_a && ns_rr_type(record) == ns_t_a && ns_rr_rdlen(record) == 4) {
+                auto* v4 = reinterpret_cast<struct sockaddr_in*>(&address.storage);
+                v4->sin_family = AF_INET;
+                v4->sin_port = htons(port);
+                std::memcpy(&v4->sin_addr, ns_rr_rdata(record), 4);
+                address.length = sizeof(struct sockaddr_in);
+            } else if (type == ns_t_aaaa && ns_rr_type(record) == ns_t_aaaa && ns_rr_rdlen(record) == 16) {
+                auto* v6 = reinterpret_cast<struct sockaddr_in6*>(&address.storage);
+                v6->sin6_family = AF_INET6;
+                v6->sin6_port = htons(port);
+                std::memcpy(&v6->sin6_addr, ns_rr_rdata(record), 16);
+                address.length = sizeof(struct sockaddr_in6);
+            } else {
+                continue;
+            }
+            result.addresses.push_back(address);
+            ttl = std::min(ttl, ns_rr_ttl(record));
+        }
+    }
+    res_nclose(&state);
+
+    if (result.addresses.empty()) {
+        return false;
+    }
+    auto lifetime = std::clamp(std::chrono::seconds(ttl), config.minTtl, config.maxTtl);
+    result.expiresAt = result.resolvedAt + lifetime;
+    return true;
+}
+
+// Function to resolve through getaddrinfo, covering NSS sources other than files and DNS
+bool Resolver::lookupSystem(const std::string& host, uint16_t port, Resolution& result) const {
+    struct addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_ADDRCONFIG | AI_NUMERICSERV;
+
+    struct addrinfo* found = nullptr;
+    int rc = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &found);
+    if (rc != 0) {
+        return false;
+    }
+    for (struct addrinfo* info = found; info; info = info->ai_next) {
+        if (info->ai_addrlen > sizeof(struct sockaddr_storage)) {
+            continue;
+        }
+        SocketAddress address;
+        std::memcpy(&address.storage, info->ai_addr, info->ai_addrlen);
+        address.length = info->ai_addrlen;
+        result.addresses.push_back(address);
+    }
+    freeaddrinfo(found);
+    result.expiresAt = result.resolvedAt + config.defaultTtl;
+    return !result.addresses.empty();
+}
+
+// Refresh after three quarters of the TTL; retry failures after negativeTtl
+Resolver::Clock::time_point Resolver::refreshTime(const Resolution& resolution) const {
+    if (resolution.addresses.empty()) {
+        return resolution.expiresAt;
+    }
+    return resolution.resolvedAt + (resolution.expiresAt - resolution.resolvedAt) * 3 / 4;
+}
+
+// Background thread re-resolving names before their records expire
+void Resolver::runRefresher() {
+    std::unique_lock<std::mutex> lock(refresherMutex);
+    while (!stopping) {
+        Clock::time_point now = Clock::now();
+        Clock::time_point wakeAt = now + std::chrono::seconds(60);
+        std::vector<std::pair<std::string, uint16_t>> due;
+        {
+            std::unique_lock<std::shared_mutex> entriesLock(entriesMutex);
+            for (auto position = entries.begin(); position != entries.end();) {
+                Entry& entry = *position->second;
+                Clock::time_point lastUsed(Clock::duration(entry.lastUsed.load(std::memory_order_relaxed)));
+                if (now - lastUsed > config.idleExpiry) {
+                    position = entries.erase(position);
+                    continue;
+                }
+                if (entry.refreshAt <= now) {
+                    due.emplace_back(entry.host, entry.port);
+                } else {
+                    wakeAt = std::min(wakeAt, entry.refreshAt);
+                }
+                ++position;
+            }
+        }
+
+        if (due.empty()) {
+            refresherWake.wait_until(lock, wakeAt);
+            continue;
+        }
+
+        // DNS may take seconds; do not hold up resolve() while it answers
+        lock.unlock();
+        for (const auto& [host, port] : due) {
+            std::shared_ptr<const Resolution> fresh = lookup(host, port);
+            refreshes.fetch_add(1, std::memory_order_relaxed);
+
+            std::unique_lock<std::shared_mutex> entriesLock(entriesMutex);
+            auto position = entries.find(host + ":" + std::to_string(port));
+            if (position == entries.end()) {
+                continue;
+            }
+            Entry& entry = *position->second;
+            if (fresh->addresses.empty() && !entry.current->addresses.empty()) {
+                // Keep serving the old records (stale once they expire) and try again soon
+                entry.refreshAt = fresh->expiresAt;
+                continue;
+            }
+            entry.current = fresh;
+            entry.refreshAt = refreshTime(*fresh);
+        }
+        lock.lock();
+    }
+}
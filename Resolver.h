@@ -0,0 +1,118 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include <sys/socket.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// IPv4 or IPv6 socket address as returned by the resolver
+struct SocketAddress {
+    struct sockaddr_storage storage{};
+    socklen_t length = 0;
+
+    int family() const { return storage.ss_family; }
+    const struct sockaddr* get() const { return reinterpret_cast<const struct sockaddr*>(&storage); }
+    std::string toString() const;
+};
+
+// All A and AAAA records of one name and how long they may be used
+struct Resolution {
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<SocketAddress> addresses;   // empty when the name did not resolve
+    Clock::time_point resolvedAt;
+    Clock::time_point expiresAt;
+    mutable std::atomic<uint32_t> next{0};   // rotates pick() across the records
+
+    // Next record in turn; the resolution must not be empty
+    const SocketAddress& pick() const;
+};
+
+struct ResolverConfig {
+    std::string hostsFile = "/etc/hosts";   // consulted before DNS; empty skips it
+    std::string nameserver;                 // "ip" or "ip:port" instead of resolv.conf's
+    std::chrono::seconds defaultTtl{30};    // names from the hosts file or other NSS sources
+    std::chrono::seconds minTtl{5};         // clamp DNS TTLs into [minTtl, maxTtl]
+    std::chrono::seconds maxTtl{3600};
+    std::chrono::seconds negativeTtl{5};    // how long a failed name is not asked again
+    std::chrono::seconds serveStale{300};   // keep using expired records while DNS is unreachable
+    std::chrono::seconds idleExpiry{600};   // stop refreshing names nobody asked for this long
+};
+
+struct ResolverStats {
+    uint64_t hits;
+    uint64_t misses;       // resolved on the caller's thread
+    uint64_t refreshes;    // resolved ahead of expiry by the refresher
+    uint64_t failures;
+    uint64_t staleServed;
+};
+
+// Caching resolver for backend names. Lookups are answered from memory; a
+// background thread re-resolves each name once three quarters of its TTL has
+// passed, so requests never wait on DNS after a name's first use. Names come
+// from the hosts file, then DNS (A and AAAA, with their TTLs), then the other
+// getaddrinfo sources.
+class Resolver {
+public:
+    explicit Resolver(ResolverConfig config = ResolverConfig());
+    ~Resolver();
+
+    Resolver(const Resolver&) = delete;
+    Resolver& operator=(const Resolver&) = delete;
+
+    // Replace the configuration; only before serving starts
+    void configure(const ResolverConfig& config);
+
+    // Records for host with port filled in; resolves on the calling thread only
+    // the first time a name is asked for. Never null; may hold no addresses.
+    std::shared_ptr<const Resolution> resolve(const std::string& host, uint16_t port);
+
+    // Resolve host now so the first request finds it cached
+    void warm(const std::string& host, uint16_t port);
+
+    ResolverStats stats() const;
+
+private:
+    using Clock = Resolution::Clock;
+
+    struct Entry {
+        std::string host;
+        uint16_t port;
+        std::shared_ptr<const Resolution> current;
+        Clock::time_point refreshAt;
+        std::atomic<int64_t> lastUsed;   // Clock ticks
+    };
+
+    ResolverConfig config;
+    mutable std::shared_mutex entriesMutex;
+    std::unordered_map<std::string, std::unique_ptr<Entry>> entries;   // "host:port" -> records
+
+    std::mutex refresherMutex;
+    std::condition_variable refresherWake;
+    bool stopping;
+    std::thread refresher;
+
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+    std::atomic<uint64_t> refreshes;
+    std::atomic<uint64_t> failures;
+    std::atomic<uint64_t> staleServed;
+
+    std::shared_ptr<Resolution> lookup(const std::string& host, uint16_t port);
+    bool lookupHostsFile(const std::string& host, uint16_t port, Resolution& result) const;
+    bool lookupDns(const std::string& host, uint16_t port, Resolution& result) const;
+    bool lookupSystem(const std::string& host, uint16_t port, Resolution& result) const;
+    Clock::time_point refreshTime(const Resolution& resolution) const;
+    void runRefresher();
+};
+
+#endif // RESOLVER_H
@@ -3,12 +3,10 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <cstring>
-#include <netdb.h>  // For gethostbyname()
 #include <arpa/inet.h>  // For inet_ntoa()
 #include "ThreadPool.h"
 #include <exception>  // Added this header
 #include <string>
-#include <sstream>
 #include<chrono>
 #include "Server.h"
 #include "Logger.h"
@@ -16,30 +14,97 @@
 #include <unordered_map>
 #include <mutex>
 #include "RequestException.h"
+#include "RequestArena.h"
 #include "Lrucache.h"
+#include "EventLoop.h"
+#include "Connection.h"
+#include "AsyncClient.h"
+#include "IoUring.h"
+#include "BackendPool.h"
+#include "HttpParser.h"
+#include "SpliceRelay.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <sys/epoll.h>
+#include <thread>
+#include <vector>
 
 
-// Rate limiter to prevent request flooding
-AdvancedRateLimiter globalRateLimiter;
+// Rate limits per route, with separate budgets for cache hits and backend fetches
+RateLimitPolicies rateLimits;
 
 
-LRUCache<std::string, std::string> cache(100);
+// Response cache, sharded by key so workers do not contend on a single lock.
+// Bounded by bytes rather than entries so a few large responses cannot push
+// out many small hot ones, and W-TinyLFU keeps a crawler walking unique paths
+// from flushing the hot set.
+static HttpCacheConfig responseCacheConfig() {
+    HttpCacheConfig config;
+    config.limits.maxBytes = 64 * 1024 * 1024;
+    config.limits.maxEntryBytes = 2 * 1024 * 1024;
+    config.shardCount = 16;
+    config.policy = EvictionPolicy::WTinyLFU;
+    return config;
+}
+HttpCache cache(responseCacheConfig());
 
 
 std::mutex rateLimiterMutex;     // Mutex for thread-safe rate limit checks
 
 
+// Active configuration, set once by startServer
+static ServerConfig serverConfig;
+
+// Client connection reuse counters
+static std::atomic<uint64_t> totalConnections{0};
+static std::atomic<uint64_t> totalKeepAliveRequests{0};
+
+// Function to get the active server configuration
+const ServerConfig& getServerConfig() {
+    return serverConfig;
+}
+
+// Function to send a whole buffer on a blocking socket
+static bool sendAll(int socket, std::string_view data) {
+    size_t offset = 0;
+    while (offset < data.size()) {
+        ssize_t sent = send(socket, data.data() + offset, data.size() - offset, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        offset += sent;
+    }
+    return true;
+}
+
+
 std::string generateErrorResponse(int statusCode, const std::string& message) {
-    std::stringstream response;
-    response << "HTTP/1.1 " << statusCode << " " 
-             << (statusCode == 429 ? "Too Many Requests" : 
-                 statusCode == 500 ? "Internal Server Error" : "Bad Request") 
-             << "\r\n"
-             << "Content-Type: text/plain\r\n"
-             << "Content-Length: " << message.length() << "\r\n"
-             << "\r\n"
-             << message;
-    return response.str();
+    const char* reason = statusCode == 429 ? "Too Many Requests" :
+                         statusCode == 500 ? "Internal Server Error" :
+                         statusCode == 502 ? "Bad Gateway" :
+                         statusCode == 503 ? "Service Unavailable" :
+                         statusCode == 504 ? "Gateway Timeout" :
+                         statusCode == 413 ? "Payload Too Large" :
+                         statusCode == 431 ? "Request Header Fields Too Large" : "Bad Request";
+
+    // Built in place: a stringstream costs several allocations per error page
+    std::string response;
+    response.reserve(96 + message.size());
+    response.append("HTTP/1.1 ").append(std::to_string(statusCode)).append(" ").append(reason).append("\r\n");
+    response.append("Content-Type: text/plain\r\n");
+    response.append("Content-Length: ").append(std::to_string(message.size())).append("\r\n");
+    response.append("\r\n");
+    response.append(message);
+    return response;
 }
 
 // Improve IP conversion to handle potential conversion errors
@@ -73,9 +138,11 @@ int createServerSocket(int port) {
         return -1;
     }
 
-    // Enable socket reuse to prevent "Address already in use" errors
+    // Enable socket reuse to prevent "Address already in use" errors.
+    // SO_REUSEPORT also lets every worker bind its own listener on the same port.
     int opt = 1;
-    if (setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+    if (setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0 ||
+        setsockopt(serverSocket, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
         logError("Socket option setting failed", strerror(errno));
         close(serverSocket);
         return -1;
@@ -104,110 +171,692 @@ bool bindSocket(int serverSocket, int port) {
     return true;
 }
 
-// Function to parse the HTTP request
-RequestInfo parseRequest(char* buffer) {
-    RequestInfo reqInfo;
-    char* method = strtok(buffer, " ");
-    char* path = strtok(NULL, " ");
-    char* version = strtok(NULL, "\r\n");
+// Keep-alive connections to the backend, shared by all workers
+BackendPool backendPool;
 
-    if (!method || !path || !version) {
-        std::cerr << "[DEBUG] Malformed request." << std::endl;
-        return reqInfo; // Return empty struct in case of failure
-    }
+// Backend addresses, resolved off the request path and cached for their DNS TTL
+Resolver resolver;
 
-    reqInfo.method = method;
-    reqInfo.path = path;
-    reqInfo.version = version;
+// Backends every request is balanced over
+UpstreamGroup upstreams;
 
-    // std::cout << "[DEBUG] Method: " << reqInfo.method << "\n Path: " << reqInfo.path << "\n Version: " << reqInfo.version << std::endl;
-    return reqInfo;
+// Function to get the key identifying the backend group in cache keys; all
+// members serve the same content, so a response from any of them may be reused
+const std::string& getBackendKey() {
+    return upstreams.name();
 }
 
-// Function to request the route from the backend
-std::string routeRequestToBackend(const std::string& method, const std::string& path) {
-    const std::string backendHost = "jsonplaceholder.typicode.com";  // Backend domain
-    const int backendPort = 80;  // HTTP port
-    std::string backendResponse;
+// Function to pick an address of the chosen backend from the resolver cache;
+// DNS is only consulted here the first time, the resolver refreshes it in the background
+bool resolveBackendAddress(const Upstream& upstream, SocketAddress& backendAddress) {
+    std::shared_ptr<const Resolution> resolution = resolver.resolve(upstream.host, upstream.port);
+    if (resolution->addresses.empty()) {
+        logError("DNS resolution failed", upstream.host);
+        return false;
+    }
+    backendAddress = resolution->pick();
+    return true;
+}
+
+BackendDeadline::BackendDeadline(const UpstreamConfig& config) {
+    Clock::time_point now = Clock::now();
+    totalEnd = config.totalTimeout.count() > 0 ? now + config.totalTimeout : Clock::time_point::max();
+    phaseEnd = totalEnd;
+    phaseStart = now;
+}
 
-    // Resolve the backend host to an IP address
-    struct hostent* backendHostEntry = gethostbyname(backendHost.c_str());
-    if (!backendHostEntry) {
-        perror("[DEBUG] DNS resolution failed");
-        return "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 21\r\n\r\nBackend Resolution Failed";
+void BackendDeadline::startPhase(std::chrono::milliseconds timeout) {
+    phaseStart = Clock::now();
+    phaseEnd = timeout.count() > 0 ? std::min(totalEnd, phaseStart + timeout) : totalEnd;
+}
+
+std::chrono::milliseconds BackendDeadline::remaining() const {
+    if (phaseEnd == Clock::time_point::max()) {
+        return std::chrono::milliseconds(0);
     }
+    auto left = std::chrono::ceil<std::chrono::milliseconds>(phaseEnd - Clock::now());
+    return std::max(left, std::chrono::milliseconds(1));
+}
+
+// Function to check whether a request may be sent again without changing its effect
+bool methodIsIdempotent(std::string_view method) {
+    return method == "GET" || method == "HEAD" || method == "OPTIONS" || method == "TRACE" ||
+           method == "PUT" || method == "DELETE";
+}
 
-    // Create a socket for communication
-    int backendSocket = socket(AF_INET, SOCK_STREAM, 0);
+// Function to start a non-blocking connect to the backend
+int openBackendSocket(const SocketAddress& backendAddress, bool& inProgress) {
+    int backendSocket = socket(backendAddress.family(), SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (backendSocket < 0) {
-        std::cerr << "[DEBUG] Failed to create socket for backend." << std::endl;
-        return "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 21\r\n\r\nBackend Connection Failed";
+        logError("Failed to create socket for backend", strerror(errno));
+        return -1;
     }
 
-    // Set up the backend address struct
-    struct sockaddr_in backendAddress{};
-    backendAddress.sin_family = AF_INET;
-    backendAddress.sin_port = htons(backendPort);
-    std::memcpy(&backendAddress.sin_addr.s_addr, backendHostEntry->h_addr, backendHostEntry->h_length);
+    // Requests are small and latency-bound; do not wait to coalesce them
+    int opt = 1;
+    setsockopt(backendSocket, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
 
-    // Connect to the backend
-    if (connect(backendSocket, (struct sockaddr*)&backendAddress, sizeof(backendAddress)) < 0) {
-        perror("[DEBUG] Backend connection failed");
+    int rc = connect(backendSocket, backendAddress.get(), backendAddress.length);
+    if (rc < 0 && errno != EINPROGRESS) {
+        logError("Backend connection failed", strerror(errno));
         close(backendSocket);
-        return "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 21\r\n\r\nBackend Connection Failed";
+        return -1;
+    }
+    inProgress = rc < 0;
+    return backendSocket;
+}
+
+// Function to check whether a client header only concerns the client's own connection
+// (RFC 9110 7.6.1), including the ones its Connection header names
+static bool isHopByHopHeader(const RequestInfo& request, std::string_view name) {
+    static constexpr std::string_view hopByHop[] = {
+        "Connection", "Keep-Alive", "Proxy-Connection", "Proxy-Authenticate", "Proxy-Authorization",
+        "TE", "Trailer", "Upgrade",
+        "Host",     // rewritten for the backend
+        "Expect"    // the body is already buffered; a 100 Continue would be taken for the response
+    };
+    for (std::string_view header : hopByHop) {
+        if (iequals(name, header)) {
+            return true;
+        }
+    }
+
+    std::string_view listed = request.header("Connection");
+    while (!listed.empty()) {
+        size_t comma = listed.find(',');
+        if (iequals(trim(listed.substr(0, comma)), name)) {
+            return true;
+        }
+        listed = comma == std::string_view::npos ? std::string_view() : listed.substr(comma + 1);
+    }
+    return false;
+}
+
+// Function to build the HTTP request for the backend in one allocation from `memory`.
+// The end-to-end client headers are forwarded as they came, and the body bytes
+// as framed (still chunk-encoded when chunked, so Transfer-Encoding stays)
+std::pmr::string buildBackendRequest(const Upstream& upstream, const RequestInfo& request,
+                                     std::pmr::memory_resource* memory) {
+    const std::string& host = upstream.port == 80 ? upstream.host : upstream.key;
+    size_t size = request.method.size() + request.path.size() + host.size() + 48 + request.body.size();
+    for (size_t i = 0; i < request.headerCount; ++i) {
+        size += request.headers[i].name.size() + request.headers[i].value.size() + 4;
+    }
+
+    std::pmr::string backendRequest(memory);
+    backendRequest.reserve(size);
+    backendRequest.append(request.method).append(" ").append(request.path).append(" HTTP/1.1\r\n");
+    backendRequest.append("Host: ").append(host).append("\r\n");
+    for (size_t i = 0; i < request.headerCount; ++i) {
+        const HttpHeader& header = request.headers[i];
+        if (!isHopByHopHeader(request, header.name)) {
+            backendRequest.append(header.name).append(": ").append(header.value).append("\r\n");
+        }
+    }
+    backendRequest.append("Connection: keep-alive\r\n\r\n");
+    backendRequest.append(request.body);
+    return backendRequest;
+}
+
+// Function to block until a non-blocking socket is ready (errors count as ready);
+// false with errno ETIMEDOUT once timeout passes, where zero waits forever
+static bool waitForSocket(int fd, short events, std::chrono::milliseconds timeout = std::chrono::milliseconds(0)) {
+    struct pollfd pfd{};
+    pfd.fd = fd;
+    pfd.events = events;
+    while (true) {
+        int rc = poll(&pfd, 1, timeout.count() > 0 ? static_cast<int>(timeout.count()) : -1);
+        if (rc > 0) {
+            return true;
+        }
+        if (rc == 0) {
+            errno = ETIMEDOUT;
+            return false;
+        }
+        if (errno != EINTR) {
+            return false;
+        }
     }
+}
 
-    // Build the HTTP request for the backend
-    std::string request = method + " " + path + " HTTP/1.1\r\n";
-    request += "Host: " + backendHost + "\r\n";
-    request += "Connection: close\r\n\r\n";
-    if (send(backendSocket, request.c_str(), request.size(), 0) < 0) {
-        perror("[DEBUG] Error sending request to backend");
+// Function to open a new backend connection, blocking until connected or the deadline
+static int connectToBackend(const Upstream& upstream, const BackendDeadline& deadline) {
+    SocketAddress backendAddress;
+    if (!resolveBackendAddress(upstream, backendAddress)) {
+        return -1;
+    }
+
+    bool inProgress = false;
+    int backendSocket = openBackendSocket(backendAddress, inProgress);
+    if (backendSocket < 0 || !inProgress) {
+        return backendSocket;
+    }
+
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (!waitForSocket(backendSocket, POLLOUT, deadline.remaining()) ||
+        getsockopt(backendSocket, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0) {
+        perror("[DEBUG] Backend connection failed");
         close(backendSocket);
-        return "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 21\r\n\r\nSend Failed";
+        return -1;
+    }
+    return backendSocket;
+}
+
+// Function to send the whole request on a non-blocking backend connection
+static bool sendToBackend(int backendSocket, std::string_view request, const BackendDeadline& deadline) {
+    size_t offset = 0;
+    while (offset < request.size()) {
+        ssize_t sent = send(backendSocket, request.data() + offset, request.size() - offset, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if ((errno == EAGAIN || errno == EWOULDBLOCK) && waitForSocket(backendSocket, POLLOUT, deadline.remaining())) {
+                continue;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("[DEBUG] Error sending request to backend");
+            return false;
+        }
+        offset += sent;
+    }
+    return true;
+}
+
+// Function to lease a connection to the chosen backend, connecting within the
+// connect timeout when none is idle, and send it the request. The deadline
+// then moves on to waiting for the first byte of the response.
+static SendStatus sendOnBackend(const Upstream& upstream, const RequestInfo& request,
+                                BackendDeadline& deadline, int& backendSocket, bool& reused) {
+    const UpstreamConfig& policy = upstreams.settings();
+
+    // Prefer an idle keep-alive connection over a new handshake
+    auto acquired = backendPool.acquire(upstream.key, backendSocket);
+    if (acquired == BackendPool::AcquireResult::Exhausted) {
+        return SendStatus::Exhausted;
+    }
+
+    reused = acquired == BackendPool::AcquireResult::Reused;
+    if (!reused) {
+        deadline.startPhase(policy.connectTimeout);
+        backendSocket = connectToBackend(upstream, deadline);
+        if (backendSocket < 0) {
+            backendPool.cancel(upstream.key);
+            return SendStatus::ConnectFailed;
+        }
+        backendPool.connected(upstream.key);
+        metrics.record(Stage::BackendConnect, deadline.phaseStarted());
+    }
+
+    deadline.startPhase(policy.firstByteTimeout);
+    char scratch[512];   // the request only lives for the send; a larger one spills to the heap
+    std::pmr::monotonic_buffer_resource memory(scratch, sizeof(scratch));
+    if (!sendToBackend(backendSocket, buildBackendRequest(upstream, request, &memory), deadline)) {
+        backendPool.release(upstream.key, backendSocket, false);
+        backendSocket = -1;
+        return SendStatus::SendFailed;
+    }
+    return SendStatus::Sent;
+}
+
+// Function to hedge a request whose backend has not started answering within
+// the hedge delay: it is sent to another backend as well, the connection that
+// answers first is kept and the other one closed
+static void hedgeIfSlow(UpstreamRequest& upstream, int& backendSocket, bool& reused,
+                        const RequestInfo& request, BackendDeadline& deadline) {
+    std::chrono::milliseconds delay = upstreams.hedgeDelay();
+    if (delay.count() == 0 || !methodIsIdempotent(request.method)) {
+        return;
+    }
+    std::chrono::milliseconds left = deadline.remaining();
+    if ((left.count() > 0 && left <= delay) ||
+        waitForSocket(backendSocket, POLLIN, delay) || errno != ETIMEDOUT || !upstreams.allowRetry()) {
+        return;
+    }
+
+    UpstreamRequest hedge = upstreams.choose(&*upstream);
+    if (&*hedge == &*upstream) {
+        return;   // nowhere else to send it
+    }
+    BackendDeadline hedgeDeadline = deadline;
+    int hedgeSocket = -1;
+    bool hedgeReused = false;
+    SendStatus sent = sendOnBackend(*hedge, request, hedgeDeadline, hedgeSocket, hedgeReused);
+    if (sent != SendStatus::Sent) {
+        if (sent != SendStatus::Exhausted) {
+            hedge.fail();
+        }
+        return;
+    }
+
+    struct pollfd sockets[2] = {{backendSocket, POLLIN, 0}, {hedgeSocket, POLLIN, 0}};
+    left = deadline.remaining();
+    while (poll(sockets, 2, left.count() > 0 ? static_cast<int>(left.count()) : -1) < 0 && errno == EINTR) {
+    }
+
+    bool hedgeWon = sockets[0].revents == 0 && sockets[1].revents != 0;
+    upstreams.countHedge(hedgeWon);
+    if (hedgeWon) {
+        backendPool.release(upstream->key, backendSocket, false);
+        upstream = std::move(hedge);
+        backendSocket = hedgeSocket;
+        reused = hedgeReused;
+        deadline = hedgeDeadline;
+    } else {
+        backendPool.release(hedge->key, hedgeSocket, false);
+    }
+}
+
+// Function to read one framed response on a backend connection the request was sent on.
+// Returns false when the exchange failed; the connection must then be discarded.
+static bool receiveFromBackend(int backendSocket, HttpResponseParser& parser, std::string& backendResponse,
+                               bool& reusable, BackendDeadline& deadline) {
+    // Receive until the parser has framed a complete response
+    char buffer[16384];
+    bool answered = false;
+    while (true) {
+        ssize_t bytesReceived = recv(backendSocket, buffer, sizeof(buffer), 0);
+        if (bytesReceived > 0) {
+            if (!answered) {
+                answered = true;
+                metrics.record(Stage::BackendFirstByte, deadline.phaseStarted());
+                deadline.startPhase(std::chrono::milliseconds(0));
+            }
+            size_t used = 0;
+            auto result = parser.feed(std::string_view(buffer, bytesReceived), used);
+            backendResponse.append(buffer, used);
+            if (result == HttpResponseParser::Result::Complete) {
+                // Bytes past the framed message mean the backend misbehaved; do not reuse it
+                reusable = parser.keepAlive() && used == static_cast<size_t>(bytesReceived);
+                return true;
+            }
+            if (result == HttpResponseParser::Result::Error) {
+                return false;
+            }
+            continue;
+        }
+        if (bytesReceived == 0) {
+            reusable = false;
+            return parser.finishOnEof() == HttpResponseParser::Result::Complete;
+        }
+        if ((errno == EAGAIN || errno == EWOULDBLOCK) && waitForSocket(backendSocket, POLLIN, deadline.remaining())) {
+            continue;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        perror("[DEBUG] Error receiving backend response");
+        return false;
+    }
+}
+
+// Function to check whether a failed attempt may be repeated on another backend
+bool mayRetryBackend(std::string_view method, int retries, const BackendDeadline& deadline) {
+    return methodIsIdempotent(method) && retries < upstreams.settings().maxRetries &&
+           !deadline.totalExpired() && upstreams.allowRetry();
+}
+
+// Function to request the route from the backend
+std::string routeRequestToBackend(const RequestInfo& request) {
+    std::string_view method = request.method;
+    BackendDeadline deadline(upstreams.settings());
+    UpstreamRequest upstream = upstreams.choose();
+    std::string backendResponse;
+    HttpResponseParser parser;
+    int retries = 0;
+    SendStatus sent;
+
+    while (true) {
+        int backendSocket = -1;
+        bool reused = false;
+        parser.reset(method == "HEAD");
+        sent = sendOnBackend(*upstream, request, deadline, backendSocket, reused);
+        if (sent == SendStatus::Exhausted) {
+            return generateErrorResponse(503, "Backend Connection Limit Reached");
+        }
+
+        if (sent == SendStatus::Sent) {
+            hedgeIfSlow(upstream, backendSocket, reused, request, deadline);
+            backendResponse.clear();
+            bool reusable = false;
+            if (receiveFromBackend(backendSocket, parser, backendResponse, reusable, deadline)) {
+                backendPool.release(upstream->key, backendSocket, reusable);
+                upstream.finish(parser.statusCode());
+                return backendResponse;
+            }
+            backendPool.release(upstream->key, backendSocket, false);
+        }
+
+        // The backend may close an idle keep-alive socket just as we reuse it; retry on another one
+        if (reused && parser.messageLength() == 0 && !deadline.expired()) {
+            continue;
+        }
+
+        const Upstream* failed = &*upstream;
+        upstream.fail();
+        if (!mayRetryBackend(method, retries, deadline)) {
+            break;
+        }
+        ++retries;
+        upstream = upstreams.choose(failed);
     }
 
-    // Receive the response from the backend
-    char buffer[4096] = {0};
-    int bytesReceived;
-    while ((bytesReceived = recv(backendSocket, buffer, sizeof(buffer) - 1, 0)) > 0) {
-        buffer[bytesReceived] = '\0';
-        backendResponse += buffer;
+    if (deadline.expired()) {
+        return generateErrorResponse(504, "Backend Timeout");
     }
+    if (sent == SendStatus::ConnectFailed) {
+        return generateErrorResponse(502, "Backend Connection Failed");
+    }
+    std::cerr << "[DEBUG] No response from backend." << std::endl;
+    return generateErrorResponse(502, "Invalid Response");
+}
+
+// Function to forward one response from a backend connection to a blocking
+// client socket while it arrives. The head is held back until it parses, so a
+// malformed response can still be answered with an error page. Bodies framed by
+// length or connection close that are too big to cache are moved with splice().
+// Returns false when the backend failed; the connection must then be discarded.
+static bool streamFromBackend(int backendSocket, int clientSocket, BackendRelay& relay, bool& reusable,
+                              BackendDeadline& deadline) {
+    HttpResponseParser& parser = relay.parser;
+    bool caching = relay.cacheable;
+    std::string outgoing;
+    SpliceRelay splice;
+    char buffer[16384];
+    bool answered = false;
+
+    while (true) {
+        if (!caching && parser.bodyIsOpaque()) {
+            size_t remaining = parser.bodyRemaining();
+            size_t before = remaining;
+            auto status = splice.pump(backendSocket, clientSocket, remaining);
+            parser.skipBody(before - remaining);
+
+            switch (status) {
+                case SpliceRelay::Status::Done:
+                    reusable = parser.keepAlive();
+                    return true;
+                case SpliceRelay::Status::WaitReadable:
+                    if (waitForSocket(backendSocket, POLLIN, deadline.remaining())) {
+                        continue;
+                    }
+                    return false;
+                case SpliceRelay::Status::WaitWritable:
+                    if (waitForSocket(clientSocket, POLLOUT)) {
+                        continue;
+                    }
+                    return false;
+                case SpliceRelay::Status::Eof:
+                    reusable = false;
+                    return parser.finishOnEof() == HttpResponseParser::Result::Complete;
+                default:
+                    perror("[DEBUG] Error relaying backend response");
+                    return false;
+            }
+        }
 
-    if (bytesReceived < 0) {
+        ssize_t bytesReceived = recv(backendSocket, buffer, sizeof(buffer), 0);
+        if (bytesReceived > 0) {
+            if (!answered) {
+                answered = true;
+                metrics.record(Stage::BackendFirstByte, deadline.phaseStarted());
+                deadline.startPhase(std::chrono::milliseconds(0));
+            }
+            size_t used = 0;
+            auto result = parser.feed(std::string_view(buffer, bytesReceived), used);
+            if (result == HttpResponseParser::Result::Error) {
+                return false;
+            }
+
+            std::string_view bytes(buffer, used);
+            if (caching) {
+                caching = responseFitsCache(parser);
+                if (caching) {
+                    relay.cacheCopy.append(bytes);
+                } else {
+                    std::string().swap(relay.cacheCopy);
+                }
+            }
+
+            outgoing.append(bytes);
+            if (parser.headersComplete()) {
+                if (!sendAll(clientSocket, outgoing)) {
+                    relay.status = BackendRelay::Status::Interrupted;
+                    return false;
+                }
+                relay.clientStarted = true;
+                outgoing.clear();
+            }
+
+            if (result == HttpResponseParser::Result::Complete) {
+                // Bytes past the framed message mean the backend misbehaved; do not reuse it
+                reusable = parser.keepAlive() && used == static_cast<size_t>(bytesReceived);
+                return true;
+            }
+            continue;
+        }
+        if (bytesReceived == 0) {
+            reusable = false;
+            return parser.finishOnEof() == HttpResponseParser::Result::Complete;
+        }
+        if ((errno == EAGAIN || errno == EWOULDBLOCK) && waitForSocket(backendSocket, POLLIN, deadline.remaining())) {
+            continue;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
         perror("[DEBUG] Error receiving backend response");
+        return false;
     }
+}
+
+// Function to name the budget a rate limited request ran out of
+const char* rateLimitMessage(RateLimitPolicies::Charge charge) {
+    return charge == RateLimitPolicies::Charge::CacheHit ? "Cache hit rate limit exceeded"
+                                                         : "Backend rate limit exceeded";
+}
 
-    if (backendResponse.empty()) {
-        backendResponse = "HTTP/1.1 502 Bad Gateway\r\nContent-Length: 15\r\n\r\nInvalid Response";
+// Function to refresh a stale cache entry off the request path; finishes the
+// fetch on key that HttpCache::lookup handed to the caller
+void revalidateInBackground(const RequestInfo& request, std::string_view key) {
+    static ThreadPool revalidationPool(2);
+
+    // The request views die with the client's buffer; keep a copy of what Vary may look at
+    std::string raw;
+    raw.append(request.method).append(" ").append(request.path).append(" HTTP/1.1\r\n");
+    for (size_t i = 0; i < request.headerCount; ++i) {
+        raw.append(request.headers[i].name).append(": ").append(request.headers[i].value).append("\r\n");
+    }
+    raw.append("\r\n");
+
+    revalidationPool.addTask([raw = std::move(raw), key = std::string(key)]() {
+        HttpRequestParser parser;
+        RequestInfo copy;
+        if (parser.parse(raw, copy) == HttpRequestParser::Result::Complete) {
+            auto backendStart = MetricsRegistry::Clock::now();
+            std::string response = routeRequestToBackend(copy);
+            metrics.record(Stage::BackendTotal, backendStart);
+            cache.store(copy, key, std::move(response));
+        }
+        cache.finishFetch(key);
+    });
+}
+
+// Function to stream the backend's response for a request straight to the client
+static void relayFromBackend(int clientSocket, const RequestInfo& request, BackendRelay& relay) {
+    std::string_view method = request.method;
+    BackendDeadline deadline(upstreams.settings());
+    UpstreamRequest upstream = upstreams.choose();
+    int retries = 0;
+    SendStatus sent;
+
+    while (true) {
+        int backendSocket = -1;
+        bool reused = false;
+        relay.parser.reset(method == "HEAD");
+        relay.cacheCopy.clear();
+        sent = sendOnBackend(*upstream, request, deadline, backendSocket, reused);
+        if (sent == SendStatus::Exhausted) {
+            relay.errorStatus = 503;
+            relay.errorMessage = "Backend Connection Limit Reached";
+            return;
+        }
+
+        if (sent == SendStatus::Sent) {
+            hedgeIfSlow(upstream, backendSocket, reused, request, deadline);
+            bool reusable = false;
+            if (streamFromBackend(backendSocket, clientSocket, relay, reusable, deadline)) {
+                backendPool.release(upstream->key, backendSocket, reusable);
+                upstream.finish(relay.parser.statusCode());
+                relay.status = BackendRelay::Status::Relayed;
+                return;
+            }
+
+            backendPool.release(upstream->key, backendSocket, false);
+            if (relay.clientStarted || relay.status == BackendRelay::Status::Interrupted) {
+                // A client that went away says nothing about the backend
+                if (relay.status != BackendRelay::Status::Interrupted) {
+                    upstream.fail();
+                }
+                relay.status = BackendRelay::Status::Interrupted;
+                return;
+            }
+        }
+
+        // The backend may close an idle keep-alive socket just as we reuse it; retry on another one
+        if (reused && relay.parser.messageLength() == 0 && !deadline.expired()) {
+            continue;
+        }
+
+        // Nothing reached the client yet, so another backend may still answer
+        const Upstream* failed = &*upstream;
+        upstream.fail();
+        if (!mayRetryBackend(method, retries, deadline)) {
+            break;
+        }
+        ++retries;
+        upstream = upstreams.choose(failed);
+    }
+
+    if (deadline.expired()) {
+        relay.errorStatus = 504;
+        relay.errorMessage = "Backend Timeout";
+    } else if (sent == SendStatus::ConnectFailed) {
+        relay.errorStatus = 502;
+        relay.errorMessage = "Backend Connection Failed";
+    } else {
         std::cerr << "[DEBUG] No response from backend." << std::endl;
+        relay.errorStatus = 502;
+        relay.errorMessage = "Invalid Response";
     }
+}
 
-    close(backendSocket);
-    return backendResponse;
+
+// Function to check whether a response carries its own framing, so the
+// client connection can stay open after it
+bool responseIsSelfDelimited(const std::string& response, bool headRequest) {
+    // Reused by the thread so the parser's head buffer is not allocated again for every hit
+    thread_local HttpResponseParser framing;
+    framing.reset(headRequest);
+    size_t used = 0;
+    return framing.feed(response, used) == HttpResponseParser::Result::Complete &&
+           used == response.size() && !framing.delimitedByClose();
 }
 
+// Function to check whether the response being streamed can still be cached whole
+bool responseFitsCache(const HttpResponseParser& parser) {
+    size_t expected = parser.messageLength();
+    if (parser.bodyIsOpaque() && parser.bodyRemaining() != SIZE_MAX) {
+        expected += parser.bodyRemaining();
+    }
+    return expected <= getServerConfig().maxCacheableSize;
+}
 
-// Function to handle client requests
-void handleClient(int clientSocket, struct sockaddr_in clientAddress, auto waitingTimeStart) {
+// Function to account a closed client connection and the requests it carried
+void recordConnection(const std::string& clientIP, int requestsServed, long connectionTime) {
+    totalConnections.fetch_add(1, std::memory_order_relaxed);
+    totalKeepAliveRequests.fetch_add(requestsServed, std::memory_order_relaxed);
+    logConnection(clientIP, requestsServed, connectionTime);
+}
 
-    // Buffer to store incoming request data
+// Function to read until a complete request is buffered (pipelined bytes stay in pending)
+static ReadStatus readNextRequest(int clientSocket, std::string& pending, HttpRequestParser& parser,
+                                  RequestInfo& reqInfo, std::chrono::milliseconds idleTimeout) {
     char buffer[4096];
+    while (true) {
+        auto parseStart = MetricsRegistry::Clock::now();
+        auto result = parser.parse(pending, reqInfo);
+        if (result == HttpRequestParser::Result::Complete) {
+            metrics.record(Stage::Parse, parseStart);
+            return ReadStatus::Complete;
+        }
+        if (result == HttpRequestParser::Result::Error) {
+            return ReadStatus::Malformed;
+        }
 
-    // waiting time finished as the request is started processing
-    auto waitingTimeFinished = std::chrono::high_resolution_clock::now();
-    auto waitingTime = std::chrono::duration_cast<std::chrono::milliseconds>(waitingTimeFinished - waitingTimeStart ).count();
-
-    // processing time start 
-    auto processingTimeStart = std::chrono::high_resolution_clock::now();
+        struct pollfd pfd{};
+        pfd.fd = clientSocket;
+        pfd.events = POLLIN;
+        int ready = poll(&pfd, 1, static_cast<int>(idleTimeout.count()));
+        if (ready == 0) {
+            return ReadStatus::TimedOut;
+        }
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return ReadStatus::Error;
+        }
 
-    // get the client IP address
-    std::string clientIP = getClientIP(clientAddress);
+        int bytesReceived = recv(clientSocket, buffer, sizeof(buffer), 0);
+        if (bytesReceived > 0) {
+            pending.append(buffer, bytesReceived);
+        } else if (bytesReceived == 0) {
+            return ReadStatus::Closed;
+        } else if (errno != EINTR) {
+            return ReadStatus::Error;
+        }
+    }
+}
 
+// Function to serve one buffered request; returns whether the connection may be reused
+static bool serveRequest(int clientSocket, const struct sockaddr_in& clientAddress, const std::string& clientIP,
+                         const RequestInfo& reqInfo, RequestArena& arena,
+                         long waitingTime, std::chrono::high_resolution_clock::time_point processingTimeStart) {
     try {
-        // Rate Limiting: Prevent excessive requests from a single IP
-        if (!globalRateLimiter.allowRequest(clientIP)) {
+        // reqInfo views into the connection's buffer, which is untouched until the request is served
+        std::string_view method = reqInfo.method;
+        std::string_view path = reqInfo.path;
+        bool keepAlive = reqInfo.keepAlive;
+        bool headRequest = reqInfo.method == "HEAD";
+
+        // The metrics page is served by the proxy itself, outside the rate limits
+        if (isMetricsRequest(reqInfo)) {
+            if (!sendAll(clientSocket, generateMetricsResponse())) {
+                throw std::runtime_error("Failed to send metrics");
+            }
+            long processingTime = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::high_resolution_clock::now() - processingTimeStart
+            ).count();
+            logRequest(clientIP, method, path, 200, waitingTime, processingTime, processingTime + waitingTime,
+                       "Served Metrics");
+            return keepAlive;
+        }
+
+        // Check if request is in cache to avoid unnecessary backend calls
+        std::pmr::string cacheKey = HttpCache::primaryKey(reqInfo.method, getBackendKey(), reqInfo.path,
+                                                          arena.resource());
+        auto lookupStart = MetricsRegistry::Clock::now();
+        HttpCache::Lookup cached = cache.lookup(reqInfo, cacheKey);
+        metrics.record(Stage::CacheLookup, lookupStart);
+        metrics.count(cached.response ? Counter::CacheHits : Counter::CacheMisses);
+        if (cached.revalidate) {
+            revalidateInBackground(reqInfo, cacheKey);
+        }
+
+        // Rate Limiting: hits and backend fetches draw on separate budgets of the route's policy
+        auto charge = cached.response ? RateLimitPolicies::Charge::CacheHit : RateLimitPolicies::Charge::BackendFetch;
+        if (!rateLimits.allow(rateLimits.match(reqInfo.method, reqInfo.path), charge, clientAddress)) {
             // Send 429 Too Many Requests response
             std::string ratelimitResponse = generateErrorResponse(
                 429, 
@@ -215,7 +864,10 @@ void handleClient(int clientSocket, struct sockaddr_in clientAddress, auto waiti
             );
             
             // Attempt to send rate limit response, ignore send errors
-            send(clientSocket, ratelimitResponse.c_str(), ratelimitResponse.length(), 0);
+            metrics.count(Counter::RateLimited);
+            auto sendStart = MetricsRegistry::Clock::now();
+            send(clientSocket, ratelimitResponse.c_str(), ratelimitResponse.length(), MSG_NOSIGNAL);
+            metrics.record(Stage::Send, sendStart);
             
             // end processing time 
             auto processingTimeEnd = std::chrono::high_resolution_clock::now();
@@ -230,58 +882,34 @@ void handleClient(int clientSocket, struct sockaddr_in clientAddress, auto waiti
                 "N/A", 
                 429, 
                 waitingTime, processingTime , processingTime + waitingTime, 
-                "IP rate limit exceeded"
+                rateLimitMessage(charge)
             );
-            // Close socket and exit function
-            close(clientSocket);
-            return;
-        }
 
-        
-        // Receive HTTP request with robust error handling
-        int bytesReceived = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
-        
-        // Handle connection errors or client disconnection
-        if (bytesReceived <= 0) {
-            if (bytesReceived == 0) {
-                auto processingTimeEnd = std::chrono::high_resolution_clock::now();
-                long processingTime = std::chrono::duration_cast<std::chrono::milliseconds>(
-                processingTimeEnd - processingTimeStart
-            ).count();
-                logRequest(clientIP, "DISCONNECT", "N/A", 499, waitingTime, processingTime, waitingTime + processingTime , "Client Closed Connection");
-            } else {
-                auto processingTimeEnd = std::chrono::high_resolution_clock::now();
-                long processingTime = std::chrono::duration_cast<std::chrono::milliseconds>(processingTimeEnd - processingTimeStart).count();
-                logRequest(clientIP, "ERROR", "N/A", 500,waitingTime, processingTime, waitingTime + processingTime, "Socket Receive Error");
-                perror("Error receiving client data");
-            }
-            close(clientSocket);
-            return;
+            // The request was read whole, so the connection stays usable
+            return keepAlive;
         }
 
-        // Null-terminate received data for safe string processing
-        buffer[bytesReceived] = '\0';
-
-        // Parse the HTTP request with comprehensive validation
-        RequestInfo reqInfo = parseRequest(buffer);
-        
-        // Validate parsed request
-        if (reqInfo.method.empty() || reqInfo.path.empty() || reqInfo.version.empty()) {
-            auto processingTimeEnd = std::chrono::high_resolution_clock::now();
-            long processingTime = std::chrono::duration_cast<std::chrono::milliseconds>(
-                processingTimeEnd - processingTimeStart
-            ).count();
-            throw RequestException("Invalid Request Format", 400 , waitingTime , processingTime );
+        // Concurrent misses for one key share a single backend fetch: the
+        // first one fetches, the rest wait for it and look the key up again
+        FetchGuard fetch{cacheKey, false};
+        if (!cached.response && HttpCache::requestAllowsLookup(reqInfo) && HttpCache::requestAllowsStore(reqInfo)) {
+            fetch.leader = cache.beginFetchOrWait(cacheKey, serverConfig.coalesceTimeout);
+            lookupStart = MetricsRegistry::Clock::now();
+            cached = cache.lookup(reqInfo, cacheKey);
+            metrics.record(Stage::CacheLookup, lookupStart);
+            if (cached.revalidate) {
+                revalidateInBackground(reqInfo, cacheKey);
+            }
         }
-
-        // Check if request is in cache to avoid unnecessary backend calls
-        std::string cachedResponse;
-        if (cache.get(reqInfo.path, cachedResponse)) {
+        CachedResponse cachedResponse = std::move(cached.response);
+        if (cachedResponse) {
 
             // Cache hit: Send cached response
-            if (send(clientSocket, cachedResponse.c_str(), cachedResponse.size(), 0) < 0) {
+            auto sendStart = MetricsRegistry::Clock::now();
+            if (!sendAll(clientSocket, *cachedResponse)) {
                 throw std::runtime_error("Failed to send cached response");
             }
+            metrics.record(Stage::Send, sendStart);
 
             // Log cache hit with performance metrics
             auto processingTimeEnd = std::chrono::high_resolution_clock::now();
@@ -290,9 +918,9 @@ void handleClient(int clientSocket, struct sockaddr_in clientAddress, auto waiti
             ).count();
             
             logRequest(
-                inet_ntoa(clientAddress.sin_addr), 
-                reqInfo.method, 
-                reqInfo.path, 
+                clientIP, 
+                method, 
+                path, 
                 200, 
                 waitingTime, 
                 processingTime, 
@@ -300,72 +928,78 @@ void handleClient(int clientSocket, struct sockaddr_in clientAddress, auto waiti
                 "Served from Cache"
             );
 
-            close(clientSocket);
-            return;
+            return keepAlive && responseIsSelfDelimited(*cachedResponse, headRequest);
         }
 
-        // Route request to backend if not in cache
-        std::string backendResponse = routeRequestToBackend(reqInfo.method, reqInfo.path);
+        // Stream the backend response to the client as it arrives
+        BackendRelay relay;
+        relay.cacheable = HttpCache::requestAllowsStore(reqInfo);
+        auto backendStart = MetricsRegistry::Clock::now();
+        relayFromBackend(clientSocket, reqInfo, relay);
+        metrics.record(Stage::BackendTotal, backendStart);
 
-        if (backendResponse.empty()) {
-            // Backend returned empty response
-            auto processingTimeEnd = std::chrono::high_resolution_clock::now();
-            long processingTime = std::chrono::duration_cast<std::chrono::milliseconds>(
-                processingTimeEnd - processingTimeStart
-            ).count();
-            throw RequestException("Backend Error", 500 , waitingTime , processingTime);
-        }
+        auto processingTimeEnd = std::chrono::high_resolution_clock::now();
+        long processingTime = std::chrono::duration_cast<std::chrono::milliseconds>(
+            processingTimeEnd - processingTimeStart
+        ).count();
 
-        // Cache the backend response for future requests
-        cache.put(reqInfo.path, backendResponse);
+        if (relay.status == BackendRelay::Status::Failed) {
+            throw RequestException(relay.errorMessage, relay.errorStatus, waitingTime, processingTime);
+        }
+        if (relay.status == BackendRelay::Status::Interrupted) {
+            // Part of the response is already out; the only way to signal the error is to close
+            logRequest(clientIP, method, path, 502, waitingTime, processingTime, processingTime + waitingTime,
+                       "Backend Response Interrupted");
+            return false;
+        }
 
-        // Send backend response to client
-        if (send(clientSocket, backendResponse.c_str(), backendResponse.size(), 0) < 0) {
-            throw std::runtime_error("Failed to send backend response");
+        // Cache the backend response if HTTP allows it and it was small enough to keep
+        if (!relay.cacheCopy.empty()) {
+            cache.store(reqInfo, cacheKey, std::move(relay.cacheCopy));
         }
 
         // Log successful backend request
-        auto processingTimeEnd = std::chrono::high_resolution_clock::now();
-        long processingTime = std::chrono::duration_cast<std::chrono::milliseconds>(
-            processingTimeEnd - processingTimeStart
-        ).count();
-        
         logRequest(
-            inet_ntoa(clientAddress.sin_addr), 
-            reqInfo.method, 
-            reqInfo.path, 
-            200, 
+            clientIP, 
+            method, 
+            path, 
+            relay.parser.statusCode(), 
             waitingTime, 
             processingTime, 
             processingTime + waitingTime, 
             "Served from Backend"
         );
+
+        // A response delimited by EOF forces the client connection to close as well
+        return keepAlive && !relay.parser.delimitedByClose();
+    }
+    catch (const RequestException& e) {
+        // Handle specific request-related exceptions
+        std::string errorResponse = generateErrorResponse(e.getStatusCode(), e.what());
+        auto sendStart = MetricsRegistry::Clock::now();
+        send(clientSocket, errorResponse.c_str(), errorResponse.size(), MSG_NOSIGNAL);
+        metrics.record(Stage::Send, sendStart);
+
+        // Log the error with corrected function calls
+        logRequest(
+            clientIP, 
+            "CLIENT_ERROR",       // Use a more descriptive method name
+            "N/A", 
+            e.getStatusCode(), 
+            e.getWaitingTime(),   
+            e.getProcessingTime(),
+            e.getTotalTime(),   
+            e.what()
+        );
     }
-   catch (const RequestException& e) {
-    // Handle specific request-related exceptions
-    std::string errorResponse = generateErrorResponse(e.getStatusCode(), e.what());
-    send(clientSocket, errorResponse.c_str(), errorResponse.size(), 0);
-
-    // Log the error with corrected function calls
-    logRequest(
-        inet_ntoa(clientAddress.sin_addr), 
-        "CLIENT_ERROR",       // Use a more descriptive method name
-        "N/A", 
-        e.getStatusCode(), 
-        e.getWaitingTime(),   
-        e.getProcessingTime(),
-        e.getTotalTime(),   
-        e.what()
-    );
-}
     catch (const std::exception& e) {
         // Catch any unexpected exceptions
         std::string errorResponse = generateErrorResponse(500, "Internal Server Error");
-        send(clientSocket, errorResponse.c_str(), errorResponse.size(), 0);
+        send(clientSocket, errorResponse.c_str(), errorResponse.size(), MSG_NOSIGNAL);
         
         // Log unexpected errors
         logRequest(
-            inet_ntoa(clientAddress.sin_addr), 
+            clientIP, 
             "FATAL", 
             "N/A", 
             500, 
@@ -376,45 +1010,154 @@ void handleClient(int clientSocket, struct sockaddr_in clientAddress, auto waiti
         );
     }
 
+    // Errors always end the connection
+    return false;
+}
+
+// Function to handle client requests
+void handleClient(int clientSocket, struct sockaddr_in clientAddress, auto waitingTimeStart) {
+    const ServerConfig& config = getServerConfig();
+
+    // waiting time finished as the request is started processing
+    auto waitingTimeFinished = std::chrono::high_resolution_clock::now();
+    auto waitingTime = std::chrono::duration_cast<std::chrono::milliseconds>(waitingTimeFinished - waitingTimeStart ).count();
+    metrics.record(Stage::QueueWait, waitingTimeFinished - waitingTimeStart);
+
+    // get the client IP address
+    std::string clientIP = getClientIP(clientAddress);
+
+    std::string pending;      // Received bytes not served yet; may hold pipelined requests
+    HttpRequestParser parser;
+    RequestInfo reqInfo;
+    RequestArena arena;       // Scratch memory of the request being served
+    int requestsServed = 0;
+
+    // Serve requests in order on the same socket until the client or a limit closes it
+    while (true) {
+        // processing time start 
+        auto processingTimeStart = std::chrono::high_resolution_clock::now();
+
+        ReadStatus status = readNextRequest(clientSocket, pending, parser, reqInfo, config.keepAliveTimeout);
+
+        if (status != ReadStatus::Complete) {
+            // An idle keep-alive connection closing between requests is not an error
+            bool betweenRequests = requestsServed > 0 && pending.empty();
+            long processingTime = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::high_resolution_clock::now() - processingTimeStart
+            ).count();
+
+            if (status == ReadStatus::Malformed) {
+                std::string errorResponse = generateErrorResponse(parser.errorStatus(), "Invalid Request Format");
+                send(clientSocket, errorResponse.c_str(), errorResponse.size(), MSG_NOSIGNAL);
+                logRequest(clientIP, "CLIENT_ERROR", "N/A", parser.errorStatus(), waitingTime, processingTime, waitingTime + processingTime, "Invalid Request Format");
+            } else if (status == ReadStatus::Error) {
+                logRequest(clientIP, "ERROR", "N/A", 500, waitingTime, processingTime, waitingTime + processingTime, "Socket Receive Error");
+                perror("Error receiving client data");
+            } else if (!betweenRequests) {
+                logRequest(clientIP, "DISCONNECT", "N/A", 499, waitingTime, processingTime, waitingTime + processingTime,
+                           status == ReadStatus::TimedOut ? "Client Request Timeout" : "Client Closed Connection");
+            }
+            break;
+        }
+
+        // Pipelined requests are answered one at a time, in the order they arrived
+        if (requestsServed > 0) {
+            processingTimeStart = std::chrono::high_resolution_clock::now();
+        }
+        bool keepAlive = serveRequest(clientSocket, clientAddress, clientIP, reqInfo, arena,
+                                      waitingTime, processingTimeStart);
+        ++requestsServed;
+
+        // reqInfo views into pending stay valid until the request is consumed here
+        pending.erase(0, reqInfo.length);
+        parser.reset();
+        arena.reset();
+
+        // Only the first request waited in the pool queue
+        waitingTime = 0;
+
+        if (!keepAlive || requestsServed >= config.maxKeepAliveRequests) {
+            break;
+        }
+    }
+
+    long connectionTime = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::high_resolution_clock::now() - waitingTimeFinished
+    ).count();
+    recordConnection(clientIP, requestsServed, connectionTime);
+
     // Ensure socket is always closed, even if an exception occurs
     close(clientSocket);
 }
 
-// Function to initialize the server
-void startServer(int port) {
-    // Validate port range
-    if (port < 1024 || port > 65535) {
-        logError("Invalid port", "Port must be between 1024 and 65535");
-        throw std::invalid_argument("Invalid port number");
+// Admission control of the thread pool's accept queue; only set in that model
+static std::unique_ptr<LoadShedder> shedder;
+
+// Function to answer a connection that will not be served with 503 and close it
+static void shedConnection(int clientSocket, struct sockaddr_in clientAddress, long waitingTime,
+                           const char* reason) {
+    std::string response = generateErrorResponse(503, "Server overloaded, please retry later");
+    send(clientSocket, response.data(), response.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+    close(clientSocket);
+    logRequest(getClientIP(clientAddress), "SHED", "N/A", 503, waitingTime, 0, waitingTime, reason);
+}
+
+// An accepted connection waiting in the thread pool's queue; a connection
+// that waited too long in the queue is shed instead of served late
+struct QueuedConnection {
+    int clientSocket;
+    struct sockaddr_in clientAddress;
+    std::chrono::high_resolution_clock::time_point waitingTimeStart;
+
+    long waitingTime() const {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::high_resolution_clock::now() - waitingTimeStart).count();
     }
 
-    // Create server socket
-    int serverSocket = createServerSocket(port);
-    if (serverSocket == -1) {
-        logError("Server initialization failed", "Could not create socket");
-        return;
+    void operator()() const {
+        if (shedder->shedAtDequeue(std::chrono::high_resolution_clock::now() - waitingTimeStart)) {
+            shedConnection(clientSocket, clientAddress, waitingTime(), "Shed from Accept Queue");
+            return;
+        }
+        handleClient(clientSocket, clientAddress, waitingTimeStart);
     }
+};
 
-    // Bind socket
-    if (!bindSocket(serverSocket, port)) {
-        close(serverSocket);
-        return;
+// Function to queue a connection under DropOldest without ever waiting: while
+// the queue is full, the longest-waiting connection is taken out and refused
+static void displaceOldest(ThreadPool& pool, Task& task) {
+    Task oldest;
+    while (!pool.tryAddTask(task)) {
+        if (!pool.tryTakeOldest(oldest)) {
+            continue;   // a worker emptied the queue meanwhile; there is room now
+        }
+        // Every task the acceptor queues is a QueuedConnection
+        const QueuedConnection* connection = oldest.target<QueuedConnection>();
+        shedConnection(connection->clientSocket, connection->clientAddress, connection->waitingTime(),
+                       "Displaced by Newer Connection");
+        shedder->recordDisplaced();
     }
+}
 
-    // Start listening with improved backlog
-    if (listen(serverSocket, SOMAXCONN) < 0) {
-        logError("Listen failed", strerror(errno));
-        close(serverSocket);
-        return;
+// Function to run the periodic upkeep the event loops do on a timer; the
+// thread pool has no loop to hang it on, so a thread of its own does it
+static void runHousekeeping(const std::atomic<bool>& stopping, std::chrono::seconds interval) {
+    while (!stopping.load(std::memory_order_relaxed)) {
+        std::this_thread::sleep_for(interval);
+        backendPool.reapIdle();
+        rateLimits.reapStaleEntries(8);
     }
+}
 
-    // Determine thread pool size based on available cores
-    int cores = getNumberOfCores();
-    ThreadPool pool(cores);
-    setupLogger();
+// Function to run the blocking accept loop that feeds the thread pool
+static void runThreadPoolServer(int serverSocket, int workers) {
+    // The accept queue is bounded; what happens past the bound is up to the shedding policy
+    shedder = std::make_unique<LoadShedder>(serverConfig.loadShedding);
+    ThreadPool pool(workers, serverConfig.loadShedding.queueCapacity);
 
-    std::cout << "[INFO] Server started successfully on port " << port 
-              << " with " << cores << " worker threads" << std::endl;
+    // Idle backend connections and idle clients' rate limit buckets are expired off the request path
+    std::atomic<bool> stopping{false};
+    std::thread housekeeping(runHousekeeping, std::cref(stopping), std::chrono::seconds(5));
 
     // Main server loop with signal handling considerations
     while (true) {
@@ -441,13 +1184,487 @@ void startServer(int port) {
         }
 
         // Add client handling task to thread pool
-        pool.addTask([clientSocket, clientAddress, waitingTimeStart]() {
-            handleClient(clientSocket, clientAddress, waitingTimeStart);
-        });
+        Task task(QueuedConnection{clientSocket, clientAddress, waitingTimeStart});
+        if (!pool.tryAddTask(task)) {
+            switch (shedder->admitOverflow()) {
+                case LoadShedder::Overflow::Reject:
+                    shedConnection(clientSocket, clientAddress, 0, "Accept Queue Full");
+                    break;
+                case LoadShedder::Overflow::DisplaceOldest:
+                    displaceOldest(pool, task);
+                    break;
+                case LoadShedder::Overflow::Wait:
+                    pool.addTask(std::move(task));
+                    break;
+            }
+        }
     }
 
     // Graceful shutdown (though this will rarely be reached in practice)
     pool.shutdown();
+    stopping.store(true, std::memory_order_relaxed);
+    housekeeping.join();
+}
+
+// Number of connections accepted by each worker, reported periodically
+static std::unique_ptr<std::atomic<uint64_t>[]> shardAcceptCounts;
+static size_t shardCount = 0;
+
+// Function to snapshot the per-shard accept counters
+std::vector<uint64_t> getShardAcceptCounts() {
+    std::vector<uint64_t> counts(shardCount);
+    for (size_t i = 0; i < shardCount; ++i) {
+        counts[i] = shardAcceptCounts[i].load(std::memory_order_relaxed);
+    }
+    return counts;
+}
+
+// Function to log the accept distribution across shards
+static void logShardAcceptCounts() {
+    std::string counts;
+    for (uint64_t count : getShardAcceptCounts()) {
+        counts += (counts.empty() ? "" : ", ") + std::to_string(count);
+    }
+    spdlog::info("Accepted connections per shard: [{}]", counts);
+}
+
+// Function to create, bind and start listening on a server socket
+static int createListener(int port) {
+    int serverSocket = createServerSocket(port);
+    if (serverSocket == -1) {
+        return -1;
+    }
+    if (!bindSocket(serverSocket, port)) {
+        return -1;  // bindSocket already closed the socket
+    }
+    if (listen(serverSocket, SOMAXCONN) < 0) {
+        logError("Listen failed", strerror(errno));
+        close(serverSocket);
+        return -1;
+    }
+    return serverSocket;
+}
+
+// Function to pin the calling thread to a single CPU
+static bool pinThreadToCpu(int cpu) {
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(cpu, &cpuSet);
+    int rc = pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+    if (rc != 0) {
+        logError("Failed to pin worker to CPU " + std::to_string(cpu), strerror(rc));
+        return false;
+    }
+    return true;
+}
+
+// Function to hand an accepted connection to the handler of the configured IO model
+static void startConnection(EventLoop& loop, int clientSocket, const struct sockaddr_in& clientAddress) {
+    auto acceptedAt = std::chrono::high_resolution_clock::now();
+    if (serverConfig.ioModel != IoModel::EventLoop) {
+        handleClientAsync(loop, clientSocket, clientAddress, acceptedAt).detach();
+        return;
+    }
+    auto connection = std::make_shared<ClientConnection>(loop, clientSocket, clientAddress, acceptedAt);
+    connection->start();
+}
+
+// Function to accept every pending connection on a listener owned by this loop
+static void acceptConnections(EventLoop& loop, int serverSocket, std::atomic<uint64_t>& acceptCount) {
+    while (true) {
+        struct sockaddr_in clientAddress;
+        socklen_t clientAddressLen = sizeof(clientAddress);
+
+        int clientSocket = accept4(serverSocket, (struct sockaddr*)&clientAddress,
+                                   &clientAddressLen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (clientSocket < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EMFILE || errno == ENFILE) {
+                logError("Accept failed", "Too many open file descriptors");
+            } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                logError("Accept failed", strerror(errno));
+            }
+            return;
+        }
+
+        acceptCount.fetch_add(1, std::memory_order_relaxed);
+        startConnection(loop, clientSocket, clientAddress);
+    }
+}
+
+// Multishot accept on a listener owned by this loop: one submission keeps
+// posting a completion per accepted connection until the kernel ends it
+struct MultishotAccept final : IoUring::Completion {
+    EventLoop& loop;
+    IoUring& uring;
+    int serverSocket;
+    std::atomic<uint64_t>& acceptCount;
+
+    MultishotAccept(EventLoop& loop, IoUring& uring, int serverSocket, std::atomic<uint64_t>& acceptCount)
+        : loop(loop), uring(uring), serverSocket(serverSocket), acceptCount(acceptCount) {}
+
+    void arm() {
+        struct io_uring_sqe request{};
+        request.opcode = IORING_OP_ACCEPT;
+        request.fd = serverSocket;
+        request.ioprio = IORING_ACCEPT_MULTISHOT;
+        request.accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+        uring.queue(request, this);
+    }
+
+    void complete(int32_t result, uint32_t flags) override {
+        if (result >= 0) {
+            // Completions of one multishot share no address buffer; ask for the peer instead
+            struct sockaddr_in clientAddress{};
+            socklen_t clientAddressLen = sizeof(clientAddress);
+            getpeername(result, (struct sockaddr*)&clientAddress, &clientAddressLen);
+            acceptCount.fetch_add(1, std::memory_order_relaxed);
+            startConnection(loop, result, clientAddress);
+        } else if (result == -EMFILE || result == -ENFILE) {
+            logError("Accept failed", "Too many open file descriptors");
+        } else if (result != -EAGAIN && result != -EINTR) {
+            logError("Accept failed", strerror(-result));
+        }
+
+        if (!(flags & IORING_CQE_F_MORE)) {
+            // Back off after an error instead of spinning on the same failure
+            if (result < 0) {
+                loop.runAfter(std::chrono::milliseconds(100), [this]() { arm(); });
+            } else {
+                arm();
+            }
+        }
+    }
+};
+
+// Function to log the keep-alive pool counters
+static void logBackendPoolStats() {
+    BackendPool::Stats stats = backendPool.stats();
+    spdlog::info("Backend pool: hits={} misses={} opened={} closed={} healthCheckFailures={} exhausted={}",
+                 stats.hits, stats.misses, stats.opened, stats.closed,
+                 stats.healthCheckFailures, stats.exhausted);
+}
+
+// Function to log response cache occupancy for capacity planning
+static void logCacheStats() {
+    CacheStats stats = cache.stats();
+    spdlog::info("Response cache: bytes={} entries={} evictions={} rejected={}",
+                 stats.bytes, stats.entries, stats.evictions, stats.rejected);
+}
+
+// Function to log how many client IPs the rate limiter tracks
+static void logRateLimiterStats() {
+    RateLimiterStats stats = rateLimits.stats();
+    spdlog::info("Rate limiter: trackedIPs={} evicted={} expired={}",
+                 stats.trackedIPs, stats.evicted, stats.expired);
+}
+
+// Function to log how often backend names were answered from the resolver cache
+static void logResolverStats() {
+    ResolverStats stats = resolver.stats();
+    spdlog::info("Resolver: hits={} misses={} refreshes={} failures={} staleServed={}",
+                 stats.hits, stats.misses, stats.refreshes, stats.failures, stats.staleServed);
+}
+
+// Function to log the load, latency and health of each backend in the group
+static void logUpstreamStats() {
+    for (const UpstreamStats& stats : upstreams.stats()) {
+        spdlog::info("Upstream {}: outstanding={} ewmaMs={:.1f} requests={} failures={} ejected={}",
+                     stats.key, stats.outstanding, stats.ewmaMs, stats.requests, stats.failures, stats.ejected);
+    }
+    UpstreamGroupStats group = upstreams.groupStats();
+    spdlog::info("Upstream retries={} retriesDenied={} hedges={} hedgesWon={} percentileMs={:.1f}",
+                 group.retries, group.retriesDenied, group.hedges, group.hedgesWon, group.percentileMs);
+}
+
+// Function to log how many requests each client connection carried on average
+static void logKeepAliveStats() {
+    uint64_t connections = totalConnections.load(std::memory_order_relaxed);
+    uint64_t requests = totalKeepAliveRequests.load(std::memory_order_relaxed);
+    spdlog::info("Client keep-alive: connections={} requests={} requestsPerConnection={:.2f}",
+                 connections, requests, connections ? static_cast<double>(requests) / connections : 0.0);
+}
+
+// Function to check whether a request asks for the metrics page
+bool isMetricsRequest(const RequestInfo& request) {
+    return !serverConfig.metricsPath.empty() && request.method == "GET" && request.path == serverConfig.metricsPath;
+}
+
+// Function to build the metrics page: the request path metrics, then the
+// counters the shared components keep, read at scrape time
+std::string generateMetricsResponse() {
+    MetricsPage page;
+    metrics.render(page);
+
+    BackendPool::Stats pool = backendPool.stats();
+    page.describe("proxy_backend_pool_leases_total", "counter", "Backend connections leased, by whether one was idle.");
+    page.sample("proxy_backend_pool_leases_total", "result=\"reused\"", pool.hits);
+    page.sample("proxy_backend_pool_leases_total", "result=\"new\"", pool.misses);
+    page.describe("proxy_backend_pool_opened_total", "counter", "Backend connections established.");
+    page.sample("proxy_backend_pool_opened_total", "", pool.opened);
+    page.describe("proxy_backend_pool_closed_total", "counter", "Backend connections closed.");
+    page.sample("proxy_backend_pool_closed_total", "", pool.closed);
+    page.describe("proxy_backend_pool_exhausted_total", "counter", "Leases refused at the per-backend limit.");
+    page.sample("proxy_backend_pool_exhausted_total", "", pool.exhausted);
+
+    CacheStats cached = cache.stats();
+    page.describe("proxy_cache_bytes", "gauge", "Bytes held by the response cache.");
+    page.sample("proxy_cache_bytes", "", static_cast<uint64_t>(cached.bytes));
+    page.describe("proxy_cache_entries", "gauge", "Responses held by the response cache.");
+    page.sample("proxy_cache_entries", "", static_cast<uint64_t>(cached.entries));
+    page.describe("proxy_cache_evictions_total", "counter", "Responses dropped or refused to make room.");
+    page.sample("proxy_cache_evictions_total", "", cached.evictions);
+
+    ResolverStats dns = resolver.stats();
+    page.describe("proxy_resolver_lookups_total", "counter", "Backend name lookups, by how they were answered.");
+    page.sample("proxy_resolver_lookups_total", "result=\"hit\"", dns.hits);
+    page.sample("proxy_resolver_lookups_total", "result=\"miss\"", dns.misses);
+    page.sample("proxy_resolver_lookups_total", "result=\"stale\"", dns.staleServed);
+
+    std::vector<UpstreamStats> backends = upstreams.stats();
+    page.describe("proxy_upstream_outstanding", "gauge", "Requests in flight to each backend.");
+    for (const UpstreamStats& stats : backends) {
+        page.sample("proxy_upstream_outstanding", "backend=\"" + stats.key + "\"", static_cast<uint64_t>(stats.outstanding));
+    }
+    page.describe("proxy_upstream_requests_total", "counter", "Requests sent to each backend.");
+    for (const UpstreamStats& stats : backends) {
+        page.sample("proxy_upstream_requests_total", "backend=\"" + stats.key + "\"", stats.requests);
+    }
+    page.describe("proxy_upstream_failures_total", "counter", "Requests to each backend that failed.");
+    for (const UpstreamStats& stats : backends) {
+        page.sample("proxy_upstream_failures_total", "backend=\"" + stats.key + "\"", stats.failures);
+    }
+    page.describe("proxy_upstream_ejected", "gauge", "Whether each backend is out of rotation.");
+    for (const UpstreamStats& stats : backends) {
+        page.sample("proxy_upstream_ejected", "backend=\"" + stats.key + "\"", static_cast<uint64_t>(stats.ejected));
+    }
+    UpstreamGroupStats group = upstreams.groupStats();
+    page.describe("proxy_upstream_retries_total", "counter", "Requests repeated on another backend.");
+    page.sample("proxy_upstream_retries_total", "", group.retries);
+    page.describe("proxy_upstream_hedges_total", "counter", "Requests hedged to a second backend.");
+    page.sample("proxy_upstream_hedges_total", "", group.hedges);
+    page.describe("proxy_upstream_hedges_won_total", "counter", "Hedges that answered before the first backend.");
+    page.sample("proxy_upstream_hedges_won_total", "", group.hedgesWon);
+
+    page.describe("proxy_client_connections_total", "counter", "Client connections closed.");
+    page.sample("proxy_client_connections_total", "", totalConnections.load(std::memory_order_relaxed));
+
+    if (shedder) {
+        LoadShedder::Stats shed = shedder->stats();
+        page.describe("proxy_load_shed_total", "counter", "Client connections answered 503 by the accept queue.");
+        page.sample("proxy_load_shed_total", "stage=\"accept\"", shed.rejected);
+        page.sample("proxy_load_shed_total", "stage=\"displaced\"", shed.displaced);
+        page.sample("proxy_load_shed_total", "stage=\"dequeue\"", shed.dropped);
+    }
+
+    AccessLogStats accessLog = accessLogStats();
+    page.describe("proxy_access_log_records_total", "counter", "Access log records, by what became of them.");
+    page.sample("proxy_access_log_records_total", "result=\"written\"", accessLog.written);
+    page.sample("proxy_access_log_records_total", "result=\"dropped\"", accessLog.dropped);
+    page.sample("proxy_access_log_records_total", "result=\"sampled_out\"", accessLog.sampledOut);
+    page.describe("proxy_access_log_write_errors_total", "counter", "Access log batches that failed to write.");
+    page.sample("proxy_access_log_write_errors_total", "", accessLog.writeErrors);
+
+    std::string& body = page.text();
+    std::string response = "HTTP/1.1 200 OK\r\n"
+                           "Content-Type: text/plain; version=0.0.4\r\n"
+                           "Cache-Control: no-store\r\n"
+                           "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                           "\r\n";
+    return response.append(body);
+}
+
+// Function to log how many access log records were written, dropped or sampled out
+static void logAccessLogStats() {
+    AccessLogStats stats = accessLogStats();
+    spdlog::info("Access log: written={} dropped={} sampledOut={} writeErrors={}",
+                 stats.written, stats.dropped, stats.sampledOut, stats.writeErrors);
+}
+
+// Function to re-arm the periodic accept distribution and pool report
+static void scheduleAcceptReport(EventLoop& loop, std::chrono::seconds interval) {
+    loop.runAfter(interval, [&loop, interval]() {
+        logShardAcceptCounts();
+        logBackendPoolStats();
+        logCacheStats();
+        logRateLimiterStats();
+        logResolverStats();
+        logUpstreamStats();
+        logKeepAliveStats();
+        logAccessLogStats();
+        scheduleAcceptReport(loop, interval);
+    });
+}
+
+// Function to re-arm the periodic health check of idle backend connections
+static void scheduleIdleReap(EventLoop& loop, std::chrono::seconds interval) {
+    loop.runAfter(interval, [&loop, interval]() {
+        backendPool.reapIdle();
+        rateLimits.reapStaleEntries(8);
+        scheduleIdleReap(loop, interval);
+    });
+}
+
+// Function to run one epoll reactor per worker thread
+static void runEventLoopServer(int serverSocket, int workers, const ServerConfig& config) {
+    shardCount = static_cast<size_t>(workers);
+    shardAcceptCounts = std::make_unique<std::atomic<uint64_t>[]>(shardCount);
+
+    int cores = getNumberOfCores();
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < workers; ++i) {
+        threads.emplace_back([i, serverSocket, cores, &config]() {
+            int cpu = i % cores;
+            if (config.pinWorkers) {
+                pinThreadToCpu(cpu);
+            }
+
+            // In sharded mode every worker owns a SO_REUSEPORT listener and the kernel
+            // spreads connections across them; otherwise all loops share one socket.
+            int listener = serverSocket;
+            if (config.shardedListeners && i > 0) {
+                listener = createListener(config.port);
+                if (listener == -1) {
+                    logError("Listener shard failed", "Worker " + std::to_string(i) + " is not accepting");
+                    return;
+                }
+            }
+
+            // accept4 must never block a reactor
+            int flags = fcntl(listener, F_GETFL, 0);
+            if (flags < 0 || fcntl(listener, F_SETFL, flags | O_NONBLOCK) < 0) {
+                logError("Failed to make listener non-blocking", strerror(errno));
+                return;
+            }
+
+            if (config.shardedListeners && config.pinWorkers) {
+                // Prefer connections whose packets arrive on the CPU this shard runs on
+                setsockopt(listener, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu));
+            }
+
+            EventLoop loop;
+            std::atomic<uint64_t>& acceptCount = shardAcceptCounts[i];
+
+            // A worker whose ring cannot be set up keeps serving through epoll
+            std::unique_ptr<IoUring> uring;
+            std::unique_ptr<MultishotAccept> acceptor;
+            if (config.ioModel == IoModel::IoUring) {
+                try {
+                    uring = std::make_unique<IoUring>(config.uringEntries, config.uringBufferCount,
+                                                      config.uringBufferSize);
+                    uring->attach(loop);
+                } catch (const std::exception& e) {
+                    logError("io_uring setup failed, worker " + std::to_string(i) + " uses epoll", e.what());
+                }
+            }
+
+            if (uring) {
+                acceptor = std::make_unique<MultishotAccept>(loop, *uring, listener, acceptCount);
+                acceptor->arm();
+            } else {
+                // A shared listener uses EPOLLEXCLUSIVE so only one loop wakes per connection
+                uint32_t listenEvents = config.shardedListeners ? EPOLLIN : EPOLLIN | EPOLLEXCLUSIVE;
+                loop.add(listener, listenEvents, [&loop, listener, &acceptCount](uint32_t) {
+                    acceptConnections(loop, listener, acceptCount);
+                });
+            }
+
+            if (i == 0 && config.acceptReportInterval.count() > 0) {
+                scheduleAcceptReport(loop, config.acceptReportInterval);
+            }
+            if (i == 0) {
+                scheduleIdleReap(loop, std::chrono::seconds(5));
+            }
+
+            loop.run();
+
+            if (listener != serverSocket) {
+                close(listener);
+            }
+        });
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+// Function to initialize the server with default settings
+void startServer(int port) {
+    ServerConfig config;
+    config.port = port;
+    startServer(config);
+}
+
+// Function to initialize the server
+void startServer(const ServerConfig& config) {
+    serverConfig = config;
+    rateLimits.configure(config.defaultRateLimit, config.rateLimitRules);
+    resolver.configure(config.dns);
+    upstreams.configure(config.upstream);
+    int port = config.port;
+
+    // Validate port range
+    if (port < 1024 || port > 65535) {
+        logError("Invalid port", "Port must be between 1024 and 65535");
+        throw std::invalid_argument("Invalid port number");
+    }
+
+    // Create server socket
+    int serverSocket = createServerSocket(port);
+    if (serverSocket == -1) {
+        logError("Server initialization failed", "Could not create socket");
+        return;
+    }
+
+    // Bind socket
+    if (!bindSocket(serverSocket, port)) {
+        close(serverSocket);
+        return;
+    }
+
+    // Start listening with improved backlog
+    if (listen(serverSocket, SOMAXCONN) < 0) {
+        logError("Listen failed", strerror(errno));
+        close(serverSocket);
+        return;
+    }
+
+    // The first request should not wait on DNS
+    for (const std::unique_ptr<Upstream>& upstream : upstreams.members()) {
+        resolver.warm(upstream->host, upstream->port);
+    }
+
+    // Determine worker count based on available cores
+    int cores = config.workerThreads > 0 ? config.workerThreads : getNumberOfCores();
+    setupLogger();
+    setupAccessLog(config.accessLog);
+
+    // Kernels without io_uring (or with it disabled) get the same handlers on epoll
+    std::string uringUnsupported;
+    if (serverConfig.ioModel == IoModel::IoUring && !IoUring::supported(uringUnsupported)) {
+        logError("io_uring unavailable, falling back to epoll", uringUnsupported);
+        serverConfig.ioModel = IoModel::Coroutine;
+    }
+
+    std::cout << "[INFO] Server started successfully on port " << port 
+              << " with " << cores << " worker threads ("
+              << (serverConfig.ioModel == IoModel::ThreadPool ? "thread pool" :
+                  serverConfig.ioModel == IoModel::IoUring ? "coroutines on io_uring" :
+                  serverConfig.ioModel == IoModel::Coroutine ? "coroutines on epoll event loops" :
+                  config.shardedListeners ? "epoll event loops, SO_REUSEPORT listener per worker" :
+                  "epoll event loops")
+              << ")" << std::endl;
+
+    if (serverConfig.ioModel != IoModel::ThreadPool) {
+        runEventLoopServer(serverSocket, cores, serverConfig);
+    } else {
+        runThreadPoolServer(serverSocket, cores);
+    }
+
     close(serverSocket);
     std::cout << "[INFO] Server shutdown complete." << std::endl;
-}
\ No newline at end of file
+}
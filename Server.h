@@ -2,16 +2,156 @@
 #define SERVER_H
 
 #include <netinet/in.h>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
 #include <string>
+#include <string_view>
+#include <vector>
+#include "AccessLog.h"
+#include "BackendPool.h"
+#include "HttpCache.h"
+#include "HttpParser.h"
+#include "LoadShedder.h"
+#include "Lrucache.h"
+#include "Metrics.h"
+#include "RateLimitPolicy.h"
+#include "Resolver.h"
+#include "Upstream.h"
 
+// I/O model used to serve client connections
+enum class IoModel {
+    ThreadPool,   // blocking accept loop handing each socket to the ThreadPool
+    EventLoop,    // non-blocking, edge-triggered epoll reactor with one loop per core
+    Coroutine,    // the epoll reactors, with each connection served by a coroutine
+    IoUring       // Coroutine, with accept and socket I/O submitted through io_uring
+};
+
+// Runtime configuration of the proxy
+struct ServerConfig {
+    int port = 8080;
+    IoModel ioModel = IoModel::EventLoop;
+    int workerThreads = 0;   // 0 means one worker per CPU core
+
+    // Client keep-alive
+    std::chrono::milliseconds keepAliveTimeout{5000};   // idle time allowed between requests
+    int maxKeepAliveRequests = 1000;                    // requests served before closing a connection
+
+    // Backend responses are streamed to the client; only those up to this size are also cached
+    size_t maxCacheableSize = 1024 * 1024;
+
+    // Backends requests are forwarded to, and how they are balanced
+    UpstreamConfig upstream;
+
+    // Backend name resolution
+    ResolverConfig dns;
+
+    // Concurrent misses for one cached key wait this long for the request fetching it
+    std::chrono::milliseconds coalesceTimeout{5000};
+
+    // Request and connection lines, written by a background thread
+    AccessLogConfig accessLog;
+
+    // Path answered with the Prometheus metrics page instead of being proxied; empty disables it
+    std::string metricsPath = "/metrics";
+
+    // Rate limits, applied once the request is parsed and the cache consulted
+    RateLimitRule defaultRateLimit;
+    std::vector<RateLimitRule> rateLimitRules;   // per method and path prefix
+
+    // Thread pool model only: bound on accepted connections waiting for a worker, and what to shed
+    LoadShedderConfig loadShedding;
+
+    // Event loop and coroutine models only
+    bool shardedListeners = false;   // bind one SO_REUSEPORT listener per worker
+    bool pinWorkers = false;         // pin worker i to CPU (i % cores)
+    std::chrono::seconds acceptReportInterval{60};  // log per-shard accept counts; 0 disables
+
+    // io_uring model only; falls back to Coroutine on kernels without support
+    unsigned uringEntries = 256;         // submission queue size per worker
+    unsigned uringBufferCount = 512;     // provided receive buffers per worker
+    size_t uringBufferSize = 16 * 1024;
+};
+
+// Shared state used by every worker
+extern RateLimitPolicies rateLimits;
+extern HttpCache cache;
+extern BackendPool backendPool;
+extern Resolver resolver;
+extern UpstreamGroup upstreams;
+
+// Outcome of streaming one backend response to a client
+struct BackendRelay {
+    enum class Status {
+        Relayed,       // the whole response reached the client
+        Failed,        // nothing reached the client; answer with errorStatus instead
+        Interrupted    // the response broke off midway; the client connection must close
+    };
+
+    Status status = Status::Failed;
+    int errorStatus = 502;
+    std::string errorMessage = "Invalid Response";
+    HttpResponseParser parser;    // Framing and status code of the relayed response
+    std::string cacheCopy;        // The whole response, when it fit maxCacheableSize
+    bool clientStarted = false;   // Some bytes were already sent to the client
+    bool cacheable = true;        // Keep cacheCopy; false when the request forbids storing
+};
+
+// Outcome of waiting for the next request on a client connection
+enum class ReadStatus { Complete, Closed, TimedOut, Error, Malformed };
+
+// Outcome of putting a request on a backend connection
+enum class SendStatus { Sent, Exhausted, ConnectFailed, SendFailed };
+
+// Ends the fetch a request took on its cache key, however serving it ends
+struct FetchGuard {
+    std::string_view key;
+    bool leader;
+
+    ~FetchGuard() {
+        if (leader) {
+            cache.finishFetch(key);
+        }
+    }
+};
 
-// structure of the request 
-struct RequestInfo {
-    std::string method;
-    std::string path;
-    std::string version;
+// Deadlines of one request to the backends. The total deadline spans every
+// attempt; each attempt moves through phases (connect, then first byte, then
+// the rest of the response) whose own timeouts are capped by the total.
+class BackendDeadline {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit BackendDeadline(const UpstreamConfig& config);
+
+    // Start a phase that may last `timeout`; zero leaves only the total deadline
+    void startPhase(std::chrono::milliseconds timeout);
+
+    // Time left in the current phase: zero when unbounded, at least 1 ms otherwise
+    std::chrono::milliseconds remaining() const;
+
+    bool expired() const { return Clock::now() >= phaseEnd; }
+    bool totalExpired() const { return Clock::now() >= totalEnd; }
+
+    Clock::time_point phaseStarted() const { return phaseStart; }
+
+private:
+    Clock::time_point totalEnd;
+    Clock::time_point phaseStart;
+    Clock::time_point phaseEnd;
 };
 
+// Function to check whether a request may be sent again without changing its effect
+bool methodIsIdempotent(std::string_view method);
+
+// Function to check whether a failed attempt may be repeated on another backend;
+// takes a token from the retry budget when it may
+bool mayRetryBackend(std::string_view method, int retries, const BackendDeadline& deadline);
+
+// Function to get the active server configuration
+const ServerConfig& getServerConfig();
+
 // Function to get the number of CPU cores
 int getNumberOfCores();
 
@@ -21,19 +161,59 @@ int createServerSocket(int port);
 // Function to bind the server socket
 bool bindSocket(int serverSocket, int port);
 
-// Function to parse HTTP request
-RequestInfo parseRequest(char* buffer);
+// Function to build an HTTP error response
+std::string generateErrorResponse(int statusCode, const std::string& message);
+
+// Function to check whether a request asks for the metrics page
+bool isMetricsRequest(const RequestInfo& request);
+
+// Function to build the metrics page response, merging every thread's metrics
+std::string generateMetricsResponse();
+
+// Function to convert the client address to a printable IP
+std::string getClientIP(struct sockaddr_in clientAddress);
+
+// Function to pick an address of the chosen backend from the resolver cache
+bool resolveBackendAddress(const Upstream& upstream, SocketAddress& backendAddress);
+
+// Function to get the key identifying the backend group in cache keys
+const std::string& getBackendKey();
+
+// Function to start a non-blocking connect to the backend
+int openBackendSocket(const SocketAddress& backendAddress, bool& inProgress);
+
+// Function to build the HTTP request sent to the backend, in `memory`
+std::pmr::string buildBackendRequest(const Upstream& upstream, const RequestInfo& request,
+                                     std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+// Function to check whether a response is framed by length or chunking
+bool responseIsSelfDelimited(const std::string& response, bool headRequest);
+
+// Function to check whether the response being streamed can still be cached whole
+bool responseFitsCache(const HttpResponseParser& parser);
+
+// Function to account a closed client connection and the requests it carried
+void recordConnection(const std::string& clientIP, int requestsServed, long connectionTime);
 
 // Function to handle client requests
-std::string routeRequestToBackend(const std::string& method, const std::string& path);
+std::string routeRequestToBackend(const RequestInfo& request);
+
+// Function to name the budget a rate limited request ran out of
+const char* rateLimitMessage(RateLimitPolicies::Charge charge);
+
+// Function to refresh a stale cache entry off the request path; finishes the
+// fetch on key that HttpCache::lookup handed to the caller
+void revalidateInBackground(const RequestInfo& request, std::string_view key);
 
 
 // function to handle client req
 void handleClient(int clientSocket, struct sockaddr_in clientAddress , auto start );
 
+// Function to get the number of connections accepted by each event loop worker
+std::vector<uint64_t> getShardAcceptCounts();
+
 // function to start the server
 void startServer(int port);
-
-// function to request the backend
+void startServer(const ServerConfig& config);
 
 #endif // SERVER_H
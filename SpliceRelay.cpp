@@ -0,0 +1,63 @@
+#include "SpliceRelay.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+
+// Largest single splice() into the pipe; the default pipe holds 64KB
+static constexpr size_t spliceChunk = 64 * 1024;
+
+SpliceRelay::SpliceRelay() : pipeFds{-1, -1}, buffered(0) {}
+
+SpliceRelay::~SpliceRelay() {
+    if (pipeFds[0] >= 0) {
+        close(pipeFds[0]);
+        close(pipeFds[1]);
+    }
+}
+
+// Drain the pipe into the destination first, then refill it from the source
+SpliceRelay::Status SpliceRelay::pump(int from, int to, size_t& remaining) {
+    if (pipeFds[0] < 0 && pipe2(pipeFds, O_NONBLOCK | O_CLOEXEC) < 0) {
+        pipeFds[0] = pipeFds[1] = -1;
+        return Status::Error;
+    }
+
+    while (true) {
+        while (buffered > 0) {
+            ssize_t moved = splice(pipeFds[0], nullptr, to, nullptr, buffered,
+                                   SPLICE_F_MOVE | SPLICE_F_NONBLOCK | SPLICE_F_MORE);
+            if (moved < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    return Status::WaitWritable;
+                }
+                if (errno == EINTR) {
+                    continue;
+                }
+                return Status::Error;
+            }
+            buffered -= moved;
+            remaining -= moved;
+        }
+
+        if (remaining == 0) {
+            return Status::Done;
+        }
+
+        ssize_t moved = splice(from, nullptr, pipeFds[1], nullptr, std::min(remaining, spliceChunk),
+                               SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (moved > 0) {
+            buffered = moved;
+            continue;
+        }
+        if (moved == 0) {
+            return Status::Eof;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return Status::WaitReadable;
+        }
+        if (errno != EINTR) {
+            return Status::Error;
+        }
+    }
+}
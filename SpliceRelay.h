@@ -0,0 +1,37 @@
+#ifndef SPLICERELAY_H
+#define SPLICERELAY_H
+
+#include <cstddef>
+
+// Zero-copy socket-to-socket forwarding through a kernel pipe with splice().
+// Relayed bytes never enter user space; the pipe is created on first use and
+// kept for the lifetime of the relay, so one relay serves many responses.
+class SpliceRelay {
+public:
+    enum class Status {
+        Done,           // `remaining` reached zero
+        WaitReadable,   // the source has no data yet
+        WaitWritable,   // the destination cannot take more yet
+        Eof,            // the source closed; everything read was delivered
+        Error
+    };
+
+    SpliceRelay();
+    ~SpliceRelay();
+
+    SpliceRelay(const SpliceRelay&) = delete;
+    SpliceRelay& operator=(const SpliceRelay&) = delete;
+
+    // Move up to `remaining` bytes from `from` to `to`; `remaining` is reduced
+    // by the bytes delivered to `to`, which may be fewer than were read
+    Status pump(int from, int to, size_t& remaining);
+
+    // Bytes read from the source but not yet delivered
+    size_t pending() const { return buffered; }
+
+private:
+    int pipeFds[2];
+    size_t buffered;
+};
+
+#endif // SPLICERELAY_H
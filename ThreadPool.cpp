@@ -3,62 +3,296 @@
 #include <stdexcept>
 #include <exception>
 
+// Empty polls of every queue before an idle worker parks
+static constexpr int spinRounds = 64;
+
+// Worker of the pool the current thread belongs to, if any
+static thread_local const void* currentPool = nullptr;
+static thread_local size_t currentWorker = 0;
+
+ThreadPool::InjectionQueue::InjectionQueue(size_t capacity)
+    : cells(std::make_unique<Cell[]>(capacity)), mask(capacity - 1), enqueuePosition(0), dequeuePosition(0) {
+    for (size_t i = 0; i < capacity; ++i) {
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+// Claim the slot at the tail; a slot is free when its sequence equals the position
+bool ThreadPool::InjectionQueue::push(Task& task) {
+    size_t position = enqueuePosition.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &cells[position & mask];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+        if (difference == 0) {
+            if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            return false;  // Full
+        } else {
+            position = enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+    cell->task = std::move(task);
+    cell->sequence.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+// Claim the slot at the head; it holds a task once its sequence is position + 1
+bool ThreadPool::InjectionQueue::pop(Task& task) {
+    size_t position = dequeuePosition.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &cells[position & mask];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+        if (difference == 0) {
+            if (dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            return false;  // Empty
+        } else {
+            position = dequeuePosition.load(std::memory_order_relaxed);
+        }
+    }
+    task = std::move(cell->task);
+    cell->sequence.store(position + mask + 1, std::memory_order_release);
+    return true;
+}
+
+ThreadPool::WorkDeque::WorkDeque(size_t capacity)
+    : slots(std::make_unique<std::atomic<Task*>[]>(capacity)),
+      mask(static_cast<int64_t>(capacity) - 1), top(0), bottom(0) {}
+
+// Owner only
+bool ThreadPool::WorkDeque::push(Task* task) {
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+    if (b - t > mask) {
+        return false;  // Full
+    }
+    slots[b & mask].store(task, std::memory_order_relaxed);
+    bottom.store(b + 1, std::memory_order_release);  // Publishes the task to thieves
+    return true;
+}
+
+// Owner only; races thieves for the last task
+Task* ThreadPool::WorkDeque::pop() {
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+    if (t > b) {
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Task* task = slots[b & mask].load(std::memory_order_relaxed);
+    if (t == b) {
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            task = nullptr;  // A thief took it
+        }
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return task;
+}
+
+// Any thread
+Task* ThreadPool::WorkDeque::steal() {
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+    if (t >= b) {
+        return nullptr;
+    }
+    Task* task = slots[t & mask].load(std::memory_order_relaxed);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return nullptr;  // Lost the race to the owner or another thief
+    }
+    return task;
+}
+
+// Ring slots for at least `capacity` tasks
+static size_t ringSize(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    return size;
+}
+
 // Constructor to initialize the thread pool
-ThreadPool::ThreadPool(int numThreads) 
-    : isShutdown(false), numThreads(numThreads) {
+ThreadPool::ThreadPool(int numThreads, size_t queueCapacity)
+    : injected(ringSize(queueCapacity)), isShutdown(false), sleepers(0), wakeups(0), numThreads(numThreads) {
     for (int i = 0; i < numThreads; ++i) {
-        threads.emplace_back([this]() {
-            while (true) {
-                std::function<void()> task;
-                {
-                    std::unique_lock<std::mutex> lock(queueMutex);
-                    taskAvailable.wait(lock, [this]() { return isShutdown || !taskQueue.empty(); });
-                    if (isShutdown && taskQueue.empty()) {
-                        return; // Exit thread if shutdown and no tasks are available
-                    }
-                    task = std::move(taskQueue.front());
-                    taskQueue.pop();
-                }
-                try {
-                    task();
-                } catch (const std::exception &e) {
-                    std::cerr << "Task exception: " << e.what() << std::endl;
-                } catch (...) {
-                    std::cerr << "Task threw an unknown exception." << std::endl;
-                }
-            }
-        });
+        workers.push_back(std::make_unique<Worker>());
+    }
+    for (int i = 0; i < numThreads; ++i) {
+        threads.emplace_back([this, i]() { workerLoop(static_cast<size_t>(i)); });
     }
 }
 
 // Destructor to shut down the pool gracefully
 ThreadPool::~ThreadPool() {
-    shutdown();
+    if (!isShutdown.load()) {
+        shutdown();
+    }
+}
+
+// Add a new task: onto the caller's own deque when a worker of this pool
+// submits it, otherwise through the injection queue
+void ThreadPool::addTask(Task task) {
+    if (isShutdown.load(std::memory_order_acquire)) {
+        throw std::runtime_error("Cannot add tasks to a shutting down ThreadPool.");
+    }
+
+    if (currentPool == this) {
+        Worker& worker = *workers[currentWorker];
+        std::unique_ptr<Task> local;
+        if (worker.spareTasks.empty()) {
+            local = std::make_unique<Task>(std::move(task));
+        } else {
+            local = std::move(worker.spareTasks.back());
+            worker.spareTasks.pop_back();
+            *local = std::move(task);
+        }
+        if (worker.deque.push(local.get())) {
+            local.release();
+            wakeOne();
+            return;
+        }
+        task = std::move(*local);
+        recycle(worker, std::move(local));
+    }
+
+    while (!injected.push(task)) {
+        std::this_thread::yield();  // Back-pressure: every slot is taken
+    }
+    wakeOne();
+}
+
+bool ThreadPool::tryAddTask(Task& task) {
+    if (isShutdown.load(std::memory_order_acquire)) {
+        throw std::runtime_error("Cannot add tasks to a shutting down ThreadPool.");
+    }
+    if (!injected.push(task)) {
+        return false;
+    }
+    wakeOne();
+    return true;
+}
+
+bool ThreadPool::tryTakeOldest(Task& task) {
+    return injected.pop(task);
+}
+
+// Wake a parked worker, if any; the fence pairs with the one in workerLoop so
+// either the worker sees the new task or this sees the worker asleep
+void ThreadPool::wakeOne() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers.load(std::memory_order_relaxed) > 0) {
+        wakeups.fetch_add(1, std::memory_order_release);
+        wakeups.notify_one();
+    }
+}
+
+// Keep an emptied task node for the worker's next local push
+void ThreadPool::recycle(Worker& worker, std::unique_ptr<Task> node) {
+    if (worker.spareTasks.size() < dequeCapacity) {
+        worker.spareTasks.push_back(std::move(node));   // within the reserved capacity
+    }
+}
+
+// Take a task that was queued on a deque; the calling worker keeps its node,
+// so nodes stolen from another deque move to the thief's spares
+bool ThreadPool::adopt(Worker& worker, Task* queued, Task& task) {
+    if (queued == nullptr) {
+        return false;
+    }
+    std::unique_ptr<Task> node(queued);
+    task = std::move(*node);
+    recycle(worker, std::move(node));
+    return true;
+}
+
+// Own deque first, then the injection queue, then steal from the others
+bool ThreadPool::findTask(size_t index, Task& task) {
+    Worker& self = *workers[index];
+    if (adopt(self, self.deque.pop(), task) || injected.pop(task)) {
+        return true;
+    }
+    for (size_t offset = 1; offset < workers.size(); ++offset) {
+        if (adopt(self, workers[(index + offset) % workers.size()]->deque.steal(), task)) {
+            return true;
+        }
+    }
+    return false;
 }
 
-// Add a new task to the queue
-void ThreadPool::addTask(std::function<void()> task) {
-    {
-        std::lock_guard<std::mutex> lock(queueMutex);
-        if (isShutdown) {
-            throw std::runtime_error("Cannot add tasks to a shutting down ThreadPool.");
+// Run a task; an exception must not take the worker down
+static void runTask(Task& task) {
+    try {
+        task();
+    } catch (const std::exception &e) {
+        std::cerr << "Task exception: " << e.what() << std::endl;
+    } catch (...) {
+        std::cerr << "Task threw an unknown exception." << std::endl;
+    }
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    currentPool = this;
+    currentWorker = index;
+
+    int idleRounds = 0;
+    while (true) {
+        Task task;
+        if (findTask(index, task)) {
+            idleRounds = 0;
+            runTask(task);
+            continue;
         }
-        taskQueue.push(std::move(task));
+
+        if (isShutdown.load(std::memory_order_acquire)) {
+            return; // Exit thread if shutdown and no tasks are available
+        }
+
+        if (++idleRounds < spinRounds) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // Park: announce it, look once more, then sleep until a submission bumps wakeups
+        uint32_t seen = wakeups.load(std::memory_order_acquire);
+        sleepers.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (findTask(index, task)) {
+            sleepers.fetch_sub(1, std::memory_order_relaxed);
+            idleRounds = 0;
+            runTask(task);
+            continue;
+        }
+        if (!isShutdown.load(std::memory_order_acquire)) {
+            wakeups.wait(seen, std::memory_order_acquire);
+        }
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+        idleRounds = 0;
     }
-    taskAvailable.notify_one();
 }
 
 // Shutdown the thread pool
 void ThreadPool::shutdown() {
-    {
-        std::lock_guard<std::mutex> lock(queueMutex);
-        if (isShutdown) {
-            std::cerr << "ThreadPool is already shutting down!" << std::endl;
-            return;
-        }
-        isShutdown = true;
+    if (isShutdown.exchange(true)) {
+        std::cerr << "ThreadPool is already shutting down!" << std::endl;
+        return;
     }
-    taskAvailable.notify_all(); // Wake up all threads to allow them to exit
+
+    // Wake up all threads to allow them to exit
+    wakeups.fetch_add(1, std::memory_order_release);
+    wakeups.notify_all();
 
     // Wait for all threads to finish execution
     for (auto& thread : threads) {
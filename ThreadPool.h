@@ -1,35 +1,195 @@
 #ifndef THREADPOOL_H
 #define THREADPOOL_H
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
 #include <vector>
-#include <queue>
 #include <thread>
-#include <mutex>
-#include <condition_variable>
-#include <functional>
 
+// Move-only void() callable. Callables up to inlineSize bytes are stored in
+// place, so queueing a typical task lambda does not allocate.
+class Task {
+public:
+    static constexpr size_t inlineSize = 48;
+
+    Task() = default;
+
+    template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Task>>>
+    Task(F&& function) {
+        using Callable = std::decay_t<F>;
+        if constexpr (sizeof(Callable) <= inlineSize && alignof(Callable) <= alignof(std::max_align_t) &&
+                      std::is_nothrow_move_constructible_v<Callable>) {
+            new (storage) Callable(std::forward<F>(function));
+            ops = &inlineOps<Callable>;
+        } else {
+            new (storage) Callable*(new Callable(std::forward<F>(function)));
+            ops = &heapOps<Callable>;
+        }
+    }
+
+    Task(Task&& other) noexcept : ops(other.ops) {
+        if (ops) {
+            ops->relocate(other.storage, storage);
+            other.ops = nullptr;
+        }
+    }
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            ops = other.ops;
+            if (ops) {
+                ops->relocate(other.storage, storage);
+                other.ops = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    ~Task() { reset(); }
+
+    explicit operator bool() const { return ops != nullptr; }
+    void operator()() { ops->invoke(storage); }
+
+    // The stored callable if it is a Callable, else null (like std::function::target)
+    template <typename Callable>
+    Callable* target() {
+        if (ops == &inlineOps<Callable>) {
+            return static_cast<Callable*>(static_cast<void*>(storage));
+        }
+        if (ops == &heapOps<Callable>) {
+            return *static_cast<Callable**>(static_cast<void*>(storage));
+        }
+        return nullptr;
+    }
+
+private:
+    struct Ops {
+        void (*invoke)(void* storage);
+        void (*relocate)(void* from, void* to);   // move into `to` and destroy `from`
+        void (*destroy)(void* storage);
+    };
+
+    template <typename Callable>
+    static constexpr Ops inlineOps = {
+        [](void* storage) { (*static_cast<Callable*>(storage))(); },
+        [](void* from, void* to) {
+            new (to) Callable(std::move(*static_cast<Callable*>(from)));
+            static_cast<Callable*>(from)->~Callable();
+        },
+        [](void* storage) { static_cast<Callable*>(storage)->~Callable(); }
+    };
+
+    template <typename Callable>
+    static constexpr Ops heapOps = {
+        [](void* storage) { (**static_cast<Callable**>(storage))(); },
+        [](void* from, void* to) { new (to) Callable*(*static_cast<Callable**>(from)); },
+        [](void* storage) { delete *static_cast<Callable**>(storage); }
+    };
+
+    void reset() {
+        if (ops) {
+            ops->destroy(storage);
+            ops = nullptr;
+        }
+    }
+
+    alignas(std::max_align_t) unsigned char storage[inlineSize];
+    const Ops* ops = nullptr;
+};
+
+// Work-stealing thread pool.
+// Tasks from outside the pool (the acceptor) go through a bounded lock-free
+// injection queue; tasks a worker submits go on its own Chase-Lev deque, which
+// it pops LIFO while idle workers steal FIFO from the other end. A worker out
+// of work spins briefly, then parks until a submission wakes it.
 class ThreadPool {
 public:
-    // Constructor that takes the number of threads
-    explicit ThreadPool(int numThreads);
+    // Constructor that takes the number of threads and the bound on tasks
+    // waiting in the injection queue (rounded up to a power of two)
+    explicit ThreadPool(int numThreads, size_t queueCapacity = 4096);
 
     // Destructor
     ~ThreadPool();
 
-    // Method to add a task to the queue
-    void addTask(std::function<void()> task);
+    // Method to add a task to the queue; waits while the injection queue is full
+    void addTask(Task task);
 
-    // Method to shut down the pool gracefully
+    // Queue the task unless the injection queue is full; task is left untouched on failure
+    bool tryAddTask(Task& task);
+
+    // Take the longest-waiting task back out of the injection queue without
+    // running it; false when the queue is empty
+    bool tryTakeOldest(Task& task);
+
+    // Method to shut down the pool gracefully; queued tasks still run
     void shutdown();
 
 private:
+    // Bounded multi-producer multi-consumer ring (Vyukov). A slot belongs to
+    // whoever claimed its sequence number, so tasks are stored by value.
+    class InjectionQueue {
+    public:
+        explicit InjectionQueue(size_t capacity);
+        bool push(Task& task);
+        bool pop(Task& task);
+
+    private:
+        struct Cell {
+            std::atomic<size_t> sequence;
+            Task task;
+        };
 
-    std::queue<std::function<void()>> taskQueue;  // Queue to hold tasks
-    std::mutex queueMutex;                       // Mutex to protect task queue
-    std::condition_variable taskAvailable;       // Condition variable for task notification
+        std::unique_ptr<Cell[]> cells;
+        size_t mask;
+        alignas(64) std::atomic<size_t> enqueuePosition;
+        alignas(64) std::atomic<size_t> dequeuePosition;
+    };
+
+    // Chase-Lev deque: only the owner pushes and pops at the bottom; any
+    // thread may steal from the top
+    class WorkDeque {
+    public:
+        explicit WorkDeque(size_t capacity);
+        bool push(Task* task);
+        Task* pop();
+        Task* steal();
+
+    private:
+        std::unique_ptr<std::atomic<Task*>[]> slots;
+        int64_t mask;
+        alignas(64) std::atomic<int64_t> top;
+        alignas(64) std::atomic<int64_t> bottom;
+    };
+
+    static constexpr size_t dequeCapacity = 1024;
+
+    // Deque slots hold pointers, so a thief never copies a task a push may be
+    // overwriting; the nodes they point to are recycled instead of freed
+    struct alignas(64) Worker {
+        WorkDeque deque{dequeCapacity};
+        std::vector<std::unique_ptr<Task>> spareTasks;   // owner thread only; at most dequeCapacity
+        Worker() { spareTasks.reserve(dequeCapacity); }
+    };
+
+    InjectionQueue injected;
+    std::vector<std::unique_ptr<Worker>> workers;
     std::vector<std::thread> threads;            // Vector of worker threads
-    bool isShutdown;                             // Flag to indicate shutdown
+    std::atomic<bool> isShutdown;                // Flag to indicate shutdown
+    std::atomic<int> sleepers;                   // Workers parked on wakeups
+    std::atomic<uint32_t> wakeups;               // Bumped to wake parked workers
     int numThreads;                              // Number of threads
+
+    void workerLoop(size_t index);
+    bool findTask(size_t index, Task& task);
+    static bool adopt(Worker& worker, Task* queued, Task& task);
+    static void recycle(Worker& worker, std::unique_ptr<Task> node);
+    void wakeOne();
 };
 
 #endif // THREADPOOL_H
@@ -1,100 +1,209 @@
 #include "TokenBucket.h"
+#include <arpa/inet.h>
 #include <algorithm>
+#include <cstring>
 #include <iostream>
 
+IPAddress toIPAddress(const struct sockaddr_in& address) {
+    IPAddress bytes{};
+    bytes[10] = 0xff;
+    bytes[11] = 0xff;
+    std::memcpy(bytes.data() + 12, &address.sin_addr, 4);
+    return bytes;
+}
+
+IPAddress toIPAddress(const struct sockaddr_in6& address) {
+    IPAddress bytes;
+    std::memcpy(bytes.data(), &address.sin6_addr, bytes.size());
+    return bytes;
+}
+
+// Fixed-point cost of one token: nanoseconds of refill at `rate` tokens per second
+static int64_t tokenCost(double rate) {
+    return rate > 0 ? std::max<int64_t>(static_cast<int64_t>(1e9 / rate), 1) : INT64_MAX / 4;
+}
+
+// Refill time that fills a bucket of `capacity` tokens, saturating instead of overflowing
+static int64_t burstOf(int64_t cost, int capacity) {
+    if (capacity <= 0) {
+        return 0;
+    }
+    return cost <= INT64_MAX / 4 / capacity ? cost * capacity : INT64_MAX / 4;
+}
+
+// Fixed-point cost of `tokens` tokens; 0 tokens are always granted
+static int64_t scaledCost(int64_t cost, double tokens) {
+    double scaled = static_cast<double>(cost) * std::max(tokens, 0.0);
+    return scaled < static_cast<double>(INT64_MAX / 4) ? static_cast<int64_t>(scaled) : INT64_MAX / 4;
+}
+
 AdvancedRateLimiter::AdvancedRateLimiter(
-    int globalMaxTokens, 
-    double globalRefillRate, 
-    int perIPMaxTokens, 
+    int globalMaxTokens,
+    double globalRefillRate,
+    int perIPMaxTokens,
     double perIPRefillRate,
-    std::chrono::seconds windowDuration
-) : 
-    globalCapacity(globalMaxTokens),
-    globalRefillRate(globalRefillRate),
-    globalTokens(globalMaxTokens),
-    perIPCapacity(perIPMaxTokens),
-    perIPTokenRefillRate(perIPRefillRate),
+    std::chrono::seconds windowDuration,
+    size_t shardCount,
+    size_t maxTrackedIPs
+) :
+    globalTokenCost(tokenCost(globalRefillRate)),
+    globalBurst(burstOf(globalTokenCost, globalMaxTokens)),
+    globalEmptyAt(nowNs() - globalBurst),   // Start full
+    shards(std::make_unique<Shard[]>(std::max<size_t>(shardCount, 1))),
+    shardCount(std::max<size_t>(shardCount, 1)),
+    shardCapacity(std::max<size_t>((maxTrackedIPs + this->shardCount - 1) / this->shardCount, 1)),
+    reapCursor(0),
+    perIPTokenCost(tokenCost(perIPRefillRate)),
+    perIPBurst(burstOf(perIPTokenCost, perIPMaxTokens)),
     trackingWindow(windowDuration)
 {
-    globalLastRefillTime = std::chrono::steady_clock::now();
 }
 
-bool AdvancedRateLimiter::allowRequest(const std::string& clientIP) {
-    std::lock_guard<std::mutex> lock(mtx);
-
-    auto now = std::chrono::steady_clock::now();
-
-    // Refill global tokens
-    refillGlobalTokens();
+bool AdvancedRateLimiter::allowRequest(const IPAddress& clientIP, double tokens) {
+    int64_t now = nowNs();
 
     // Check global rate limit first
-    if (!consumeGlobalTokens()) {
+    if (!consumeGlobalTokens(now, scaledCost(globalTokenCost, tokens))) {
         return false;
     }
 
-    // Find or create IP bucket
-    auto& ipBucket = ipBuckets[clientIP];
+    Shard& shard = shardFor(clientIP);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+
+    // Amortized reaping: every request retires a couple of idle clients from its shard
+    expire(shard, now, 2);
 
-    // Refill IP-specific tokens
-    refillIPTokens(ipBucket);
+    // Find or create IP bucket; a new client starts with a full bucket
+    auto [position, inserted] = shard.ipBuckets.try_emplace(clientIP, IPBucket{now - perIPBurst, now, 0, {}});
+    IPBucket& ipBucket = position->second;
+    if (inserted) {
+        ipBucket.recency = shard.recency.insert(shard.recency.end(), clientIP);
+
+        // Over the cap: forget the least recently seen client
+        if (shard.ipBuckets.size() > shardCapacity) {
+            shard.ipBuckets.erase(shard.recency.front());
+            shard.recency.pop_front();
+            shard.evicted++;
+        }
+    } else {
+        shard.recency.splice(shard.recency.end(), shard.recency, ipBucket.recency);
+    }
+    ipBucket.lastSeen = now;
 
     // Check if IP has tokens
-    if (ipBucket.tokens >= 1.0) {
-        ipBucket.tokens -= 1.0;
+    if (consumeIPTokens(ipBucket, now, scaledCost(perIPTokenCost, tokens))) {
         ipBucket.consecutiveBlocks = 0;  // Reset block counter on successful request
         return true;
     }
 
     // Implement progressive slowdown
     ipBucket.consecutiveBlocks++;
-    
+
     // Exponential backoff: more consecutive blocks = longer block time
     if (ipBucket.consecutiveBlocks > 3) {
-        std::cerr << "IP " << clientIP << " is being rate limited aggressively." << std::endl;
+        static const uint8_t mappedPrefix[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+        bool ipv4 = std::memcmp(clientIP.data(), mappedPrefix, sizeof(mappedPrefix)) == 0;
+        char ipStr[INET6_ADDRSTRLEN];
+        if (inet_ntop(ipv4 ? AF_INET : AF_INET6, clientIP.data() + (ipv4 ? 12 : 0), ipStr, sizeof(ipStr)) != nullptr) {
+            std::cerr << "IP " << ipStr << " is being rate limited aggressively." << std::endl;
+        }
         return false;
     }
 
     return false;
 }
 
-void AdvancedRateLimiter::refillGlobalTokens() {
-    auto now = std::chrono::steady_clock::now();
-    double timeElapsed = std::chrono::duration<double>(now - globalLastRefillTime).count();
+bool AdvancedRateLimiter::allowRequest(const std::string& clientIP, double tokens) {
+    struct sockaddr_in ipv4{};
+    if (inet_pton(AF_INET, clientIP.c_str(), &ipv4.sin_addr) == 1) {
+        return allowRequest(toIPAddress(ipv4), tokens);
+    }
+    IPAddress address{};
+    inet_pton(AF_INET6, clientIP.c_str(), address.data());
+    return allowRequest(address, tokens);
+}
 
-    globalTokens += timeElapsed * globalRefillRate;
-    if (globalTokens > globalCapacity) globalTokens = globalCapacity;
+int64_t AdvancedRateLimiter::nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
-    globalLastRefillTime = now;
+// Lock-free: take the tokens by moving emptyAt forward, retrying if another thread got there first
+bool AdvancedRateLimiter::consumeGlobalTokens(int64_t now, int64_t cost) {
+    int64_t emptyAt = globalEmptyAt.load(std::memory_order_relaxed);
+    while (true) {
+        // Refill, capped at capacity
+        int64_t start = std::max(emptyAt, now - globalBurst);
+        if (now - start < cost) {
+            return false;
+        }
+        if (globalEmptyAt.compare_exchange_weak(emptyAt, start + cost, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
 }
 
-bool AdvancedRateLimiter::consumeGlobalTokens() {
-    if (globalTokens >= 1.0) {
-        globalTokens -= 1.0;
-        return true;
+bool AdvancedRateLimiter::consumeIPTokens(IPBucket& bucket, int64_t now, int64_t cost) {
+    int64_t start = std::max(bucket.emptyAt, now - perIPBurst);
+    if (now - start < cost) {
+        return false;
     }
-    return false;
+    bucket.emptyAt = start + cost;
+    return true;
 }
 
-void AdvancedRateLimiter::refillIPTokens(IPBucket& bucket) {
-    auto now = std::chrono::steady_clock::now();
-    double timeElapsed = std::chrono::duration<double>(now - bucket.lastRefillTime).count();
+size_t AdvancedRateLimiter::IPAddressHash::operator()(const IPAddress& address) const {
+    // FNV-1a over the 16 address bytes
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (uint8_t byte : address) {
+        hash = (hash ^ byte) * 0x100000001b3ULL;
+    }
+    return static_cast<size_t>(hash);
+}
 
-    bucket.tokens += timeElapsed * perIPTokenRefillRate;
-    if (bucket.tokens > perIPCapacity) bucket.tokens = perIPCapacity;
+AdvancedRateLimiter::Shard& AdvancedRateLimiter::shardFor(const IPAddress& clientIP) {
+    // High bits of a multiplicative mix, so the table inside the shard still sees varied low bits
+    uint64_t hash = IPAddressHash()(clientIP) * 0x9E3779B97F4A7C15ULL;
+    return shards[(hash >> 32) % shardCount];
+}
 
-    bucket.lastRefillTime = now;
+// Drop up to `limit` clients idle for longer than the tracking window; they sit
+// at the front of the recency list, so this stops at the first active one
+void AdvancedRateLimiter::expire(Shard& shard, int64_t now, size_t limit) {
+    int64_t window = std::chrono::duration_cast<std::chrono::nanoseconds>(trackingWindow).count();
+    while (limit-- > 0 && !shard.recency.empty()) {
+        auto oldest = shard.ipBuckets.find(shard.recency.front());
+        if (now - oldest->second.lastSeen <= window) {
+            return;
+        }
+        shard.ipBuckets.erase(oldest);
+        shard.recency.pop_front();
+        shard.expired++;
+    }
 }
 
 void AdvancedRateLimiter::cleanupStaleEntries() {
-    std::lock_guard<std::mutex> lock(mtx);
-    auto now = std::chrono::steady_clock::now();
-
-    // Remove entries older than tracking window
-    for (auto it = ipBuckets.begin(); it != ipBuckets.end(); ) {
-        if (now - it->second.lastRefillTime > trackingWindow) {
-            it = ipBuckets.erase(it);
-        } else {
-            ++it;
-        }
+    reapStaleEntries(shardCount);
+}
+
+void AdvancedRateLimiter::reapStaleEntries(size_t shardBudget) {
+    int64_t now = nowNs();
+
+    // Remove entries older than tracking window, one shard at a time
+    for (size_t i = 0; i < std::min(shardBudget, shardCount); ++i) {
+        Shard& shard = shards[reapCursor.fetch_add(1, std::memory_order_relaxed) % shardCount];
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        expire(shard, now, SIZE_MAX);
     }
-}
\ No newline at end of file
+}
+
+RateLimiterStats AdvancedRateLimiter::stats() const {
+    RateLimiterStats total;
+    for (size_t i = 0; i < shardCount; ++i) {
+        std::lock_guard<std::mutex> lock(shards[i].mtx);
+        total.trackedIPs += shards[i].ipBuckets.size();
+        total.evicted += shards[i].evicted;
+        total.expired += shards[i].expired;
+    }
+    return total;
+}
@@ -2,11 +2,39 @@
 #ifndef TOKEN_BUCKET_H
 #define TOKEN_BUCKET_H
 
+#include <netinet/in.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <list>
 #include <unordered_map>
 #include <mutex>
 #include <chrono>
+#include <memory>
 #include <string>
 
+// Binary client address; IPv4 is stored as an IPv4-mapped IPv6 address
+using IPAddress = std::array<uint8_t, 16>;
+
+IPAddress toIPAddress(const struct sockaddr_in& address);
+IPAddress toIPAddress(const struct sockaddr_in6& address);
+
+// Occupancy counters of the per-IP table
+struct RateLimiterStats {
+    size_t trackedIPs = 0;
+    uint64_t evicted = 0;   // dropped to stay under maxTrackedIPs
+    uint64_t expired = 0;   // dropped after trackingWindow without a request
+};
+
+// Token buckets are kept in fixed point as the steady-clock instant (ns) at which
+// the bucket was empty: tokens = (now - emptyAt) / tokenCost, capped at capacity.
+// Taking a token moves emptyAt forward by tokenCost, so the token count and its
+// refill time live in one integer and the global bucket is a single atomic.
+//
+// Each shard keeps its clients in least-recently-seen order, so idle ones are
+// reaped from the cold end a few at a time as requests arrive, and the table
+// never holds more than maxTrackedIPs: the least recently seen client is
+// forgotten first (and starts over with a full bucket if it returns).
 class AdvancedRateLimiter {
 public:
     // Constructor with configurable parameters
@@ -15,42 +43,70 @@ public:
         double globalRefillRate = 10.0,// Global token refill rate
         int perIPMaxTokens = 100,       // Max requests per IP
         double perIPRefillRate = 2.0,  // Token refill rate per IP
-        std::chrono::seconds windowDuration = std::chrono::seconds(60) // Tracking window
+        std::chrono::seconds windowDuration = std::chrono::seconds(60), // Tracking window
+        size_t shardCount = 64,         // Independent locks over the per-IP table
+        size_t maxTrackedIPs = 100000   // Hard cap on per-IP buckets
     );
 
-    // Check if a request from a specific IP is allowed
-    bool allowRequest(const std::string& clientIP);
+    // Check if a request from a specific IP is allowed; it takes `tokens`
+    // from both the global and the per-IP bucket
+    bool allowRequest(const IPAddress& clientIP, double tokens = 1.0);
+    bool allowRequest(const struct sockaddr_in& clientAddress, double tokens = 1.0) {
+        return allowRequest(toIPAddress(clientAddress), tokens);
+    }
+    bool allowRequest(const std::string& clientIP, double tokens = 1.0);
 
     // Clear old entries to prevent memory leaks
     void cleanupStaleEntries();
 
+    // Clear old entries in the next `shardBudget` shards; call periodically
+    void reapStaleEntries(size_t shardBudget);
+
+    RateLimiterStats stats() const;
+
 private:
     // Global rate limiting parameters
-    int globalCapacity;
-    double globalRefillRate;
-    double globalTokens;
-    std::chrono::steady_clock::time_point globalLastRefillTime;
+    int64_t globalTokenCost;      // ns of refill per token
+    int64_t globalBurst;          // ns of refill that fill the bucket
+    std::atomic<int64_t> globalEmptyAt;
 
     // Per-IP rate limiting structure
     struct IPBucket {
-        double tokens;
-        std::chrono::steady_clock::time_point lastRefillTime;
+        int64_t emptyAt;
+        int64_t lastSeen;
         int consecutiveBlocks;  // Track consecutive blocking to implement progressive slowdown
+        std::list<IPAddress>::iterator recency;
+    };
+
+    struct IPAddressHash {
+        size_t operator()(const IPAddress& address) const;
+    };
+
+    // One lock and table per shard; aligned so neighbouring locks do not share a cache line
+    struct alignas(64) Shard {
+        mutable std::mutex mtx;
+        std::unordered_map<IPAddress, IPBucket, IPAddressHash> ipBuckets;
+        std::list<IPAddress> recency;   // Least recently seen first
+        uint64_t evicted = 0;
+        uint64_t expired = 0;
     };
 
-    // Containers for tracking
-    std::unordered_map<std::string, IPBucket> ipBuckets;
-    std::mutex mtx;
+    std::unique_ptr<Shard[]> shards;
+    size_t shardCount;
+    size_t shardCapacity;               // maxTrackedIPs split across shards
+    std::atomic<size_t> reapCursor;
 
     // Configuration parameters
-    int perIPCapacity;
-    double perIPTokenRefillRate;
+    int64_t perIPTokenCost;
+    int64_t perIPBurst;
     std::chrono::seconds trackingWindow;
 
     // Internal methods for token management
-    void refillGlobalTokens();
-    bool consumeGlobalTokens();
-    void refillIPTokens(IPBucket& bucket);
+    static int64_t nowNs();
+    bool consumeGlobalTokens(int64_t now, int64_t cost);
+    bool consumeIPTokens(IPBucket& bucket, int64_t now, int64_t cost);
+    Shard& shardFor(const IPAddress& clientIP);
+    void expire(Shard& shard, int64_t now, size_t limit);
 };
 
-#endif // TOKEN_BUCKET_H
\ No newline at end of file
+#endif // TOKEN_BUCKET_H
@@ -0,0 +1,340 @@
+#include "Upstream.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+Upstream::Upstream(UpstreamServer server)
+    : host(std::move(server.host)),
+      port(server.port),
+      key(host + ":" + std::to_string(port)),
+      outstanding(0),
+      ewmaMs(0),
+      ejectedUntil(0),
+      requests(0),
+      failures(0),
+      consecutiveFailures(0),
+      ejections(0) {}
+
+bool Upstream::ejected(Clock::time_point now) const {
+    return ejectedUntil.load(std::memory_order_relaxed) > now.time_since_epoch().count();
+}
+
+UpstreamRequest::UpstreamRequest(UpstreamGroup& group, Upstream& upstream)
+    : group(&group), upstream(&upstream), startedAt(Upstream::Clock::now()) {
+    upstream.outstanding.fetch_add(1, std::memory_order_relaxed);
+    upstream.requests.fetch_add(1, std::memory_order_relaxed);
+}
+
+UpstreamRequest::UpstreamRequest(UpstreamRequest&& other) noexcept
+    : group(other.group), upstream(other.upstream), startedAt(other.startedAt) {
+    other.upstream = nullptr;
+}
+
+UpstreamRequest& UpstreamRequest::operator=(UpstreamRequest&& other) noexcept {
+    if (this != &other) {
+        if (upstream) {
+            upstream->outstanding.fetch_sub(1, std::memory_order_relaxed);
+        }
+        group = other.group;
+        upstream = other.upstream;
+        startedAt = other.startedAt;
+        other.upstream = nullptr;
+    }
+    return *this;
+}
+
+UpstreamRequest::~UpstreamRequest() {
+    if (upstream) {
+        upstream->outstanding.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+void UpstreamRequest::finish(int statusCode) {
+    end(statusCode < 502 || statusCode > 504);
+}
+
+void UpstreamRequest::fail() {
+    end(false);
+}
+
+void UpstreamRequest::end(bool success) {
+    if (!upstream) {
+        return;
+    }
+    Upstream* finished = upstream;
+    upstream = nullptr;
+    finished->outstanding.fetch_sub(1, std::memory_order_relaxed);
+    group->record(*finished, success, Upstream::Clock::now() - startedAt);
+}
+
+// Most retries banked from deposits, so a long healthy spell cannot fund a retry storm
+static constexpr int64_t maxRetryTokens = 100 * 1000;
+
+UpstreamGroup::UpstreamGroup(const UpstreamConfig& config)
+    : nextIndex(0),
+      retryTokens(0),
+      reserveTokenCost(0),
+      reserveEmptyAt(0),
+      latencyQuantileMs(0),
+      latencySamples(0),
+      retries(0),
+      retriesDenied(0),
+      hedges(0),
+      hedgesWon(0) {
+    configure(config);
+}
+
+void UpstreamGroup::configure(const UpstreamConfig& newConfig) {
+    config = newConfig;
+    if (config.servers.empty()) {
+        config.servers = UpstreamConfig().servers;
+    }
+    upstreams.clear();
+    for (const UpstreamServer& server : config.servers) {
+        upstreams.push_back(std::make_unique<Upstream>(server));
+    }
+    groupName = config.name.empty() ? upstreams.front()->key : config.name;
+
+    retryTokens.store(0, std::memory_order_relaxed);
+    reserveTokenCost = config.minRetriesPerSecond > 0
+        ? std::chrono::duration_cast<Upstream::Clock::duration>(std::chrono::seconds(1)).count() / config.minRetriesPerSecond
+        : 0;
+    reserveEmptyAt.store(0, std::memory_order_relaxed);
+    latencyQuantileMs.store(0, std::memory_order_relaxed);
+    latencySamples.store(0, std::memory_order_relaxed);
+}
+
+UpstreamRequest UpstreamGroup::choose(const Upstream* avoid) {
+    Upstream::Clock::time_point now = Upstream::Clock::now();
+    if (!avoid) {
+        // Every first attempt pays into the retry budget
+        int64_t deposit = static_cast<int64_t>(config.retryBudget * 1000);
+        int64_t tokens = retryTokens.load(std::memory_order_relaxed);
+        while (tokens < maxRetryTokens &&
+               !retryTokens.compare_exchange_weak(tokens, std::min(tokens + deposit, maxRetryTokens),
+                                                  std::memory_order_relaxed)) {
+        }
+    }
+    if (upstreams.size() == 1) {
+        return UpstreamRequest(*this, *upstreams.front());
+    }
+    switch (config.policy) {
+        case BalancePolicy::RoundRobin:
+            return UpstreamRequest(*this, pickRoundRobin(now, avoid));
+        case BalancePolicy::LeastOutstanding:
+            return UpstreamRequest(*this, pickLeastOutstanding(now, avoid));
+        case BalancePolicy::TwoChoicesEwma:
+        default:
+            return UpstreamRequest(*this, pickTwoChoices(now, avoid));
+    }
+}
+
+bool UpstreamGroup::allowRetry() {
+    int64_t tokens = retryTokens.load(std::memory_order_relaxed);
+    while (tokens >= 1000) {
+        if (retryTokens.compare_exchange_weak(tokens, tokens - 1000, std::memory_order_relaxed)) {
+            retries.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    // Low traffic deposits too little to retry at all; allow a few per second regardless
+    if (reserveTokenCost > 0) {
+        int64_t now = Upstream::Clock::now().time_since_epoch().count();
+        int64_t burst = reserveTokenCost * config.minRetriesPerSecond;
+        int64_t emptyAt = reserveEmptyAt.load(std::memory_order_relaxed);
+        while (true) {
+            int64_t taken = std::max(emptyAt, now - burst) + reserveTokenCost;
+            if (taken > now) {
+                break;
+            }
+            if (reserveEmptyAt.compare_exchange_weak(emptyAt, taken, std::memory_order_relaxed)) {
+                retries.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+    }
+    retriesDenied.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+std::chrono::milliseconds UpstreamGroup::hedgeDelay() const {
+    if (!config.hedging || latencySamples.load(std::memory_order_relaxed) < config.hedgeMinSamples) {
+        return std::chrono::milliseconds(0);
+    }
+    double delayMs = std::max<double>(latencyQuantileMs.load(std::memory_order_relaxed),
+                                      std::max<int64_t>(1, config.minHedgeDelay.count()));
+    return std::chrono::milliseconds(static_cast<int64_t>(std::ceil(delayMs)));
+}
+
+void UpstreamGroup::countHedge(bool won) {
+    hedges.fetch_add(1, std::memory_order_relaxed);
+    if (won) {
+        hedgesWon.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// Function to tell whether a backend may take a request right now
+bool UpstreamGroup::available(const Upstream& upstream, Upstream::Clock::time_point now,
+                              const Upstream* avoid) const {
+    return &upstream != avoid && !upstream.ejected(now);
+}
+
+// Function to take the next backend in turn, skipping ejected ones
+Upstream& UpstreamGroup::pickRoundRobin(Upstream::Clock::time_point now, const Upstream* avoid) {
+    size_t count = upstreams.size();
+    size_t start = nextIndex.fetch_add(1, std::memory_order_relaxed) % count;
+    for (size_t i = 0; i < count; ++i) {
+        Upstream& candidate = *upstreams[(start + i) % count];
+        if (available(candidate, now, avoid)) {
+            return candidate;
+        }
+    }
+    return avoid && !avoid->ejected(now) ? const_cast<Upstream&>(*avoid) : *upstreams[start];
+}
+
+// Function to take the backend with the fewest requests in flight; the scan
+// starts at a rotating index so ties do not all land on the first backend
+Upstream& UpstreamGroup::pickLeastOutstanding(Upstream::Clock::time_point now, const Upstream* avoid) {
+    size_t count = upstreams.size();
+    size_t start = nextIndex.fetch_add(1, std::memory_order_relaxed) % count;
+    Upstream* best = nullptr;
+    int bestOutstanding = 0;
+    for (size_t i = 0; i < count; ++i) {
+        Upstream& candidate = *upstreams[(start + i) % count];
+        if (!available(candidate, now, avoid)) {
+            continue;
+        }
+        int inFlight = candidate.outstanding.load(std::memory_order_relaxed);
+        if (!best || inFlight < bestOutstanding) {
+            best = &candidate;
+            bestOutstanding = inFlight;
+        }
+    }
+    if (best) {
+        return *best;
+    }
+    return avoid && !avoid->ejected(now) ? const_cast<Upstream&>(*avoid) : *upstreams[start];
+}
+
+// Function to take the cheaper of two distinct random backends. The cost is
+// the latency EWMA scaled by the requests already queued on the backend, so a
+// slow backend and a busy one are both avoided; a backend without a sample
+// yet costs only its queue and gets tried early.
+Upstream& UpstreamGroup::pickTwoChoices(Upstream::Clock::time_point now, const Upstream* avoid) {
+    thread_local std::minstd_rand random(std::random_device{}());
+    size_t count = upstreams.size();
+    size_t first = random() % count;
+    size_t second = random() % (count - 1);
+    if (second >= first) {
+        ++second;
+    }
+    Upstream& a = *upstreams[first];
+    Upstream& b = *upstreams[second];
+    bool aAvailable = available(a, now, avoid);
+    bool bAvailable = available(b, now, avoid);
+    if (!aAvailable && !bAvailable) {
+        return pickLeastOutstanding(now, avoid);
+    }
+    if (!aAvailable || !bAvailable) {
+        return aAvailable ? a : b;
+    }
+    auto cost = [](const Upstream& upstream) {
+        return (upstream.ewmaMs.load(std::memory_order_relaxed) + 1.0) *
+               (upstream.outstanding.load(std::memory_order_relaxed) + 1);
+    };
+    return cost(b) < cost(a) ? b : a;
+}
+
+// Function to fold one outcome into a backend's latency EWMA and passive health
+void UpstreamGroup::record(Upstream& upstream, bool success, std::chrono::nanoseconds latency) {
+    Upstream::Clock::time_point now = Upstream::Clock::now();
+    if (latency > config.slowResponse) {
+        success = false;
+    }
+    // A failure that came back fast must not make the backend look attractive
+    double sampleMs = std::chrono::duration<double, std::milli>(
+        success ? latency : std::max<std::chrono::nanoseconds>(latency, config.slowResponse)).count();
+
+    if (success) {
+        observeLatency(sampleMs);
+    }
+
+    std::lock_guard<std::mutex> lock(upstream.healthMutex);
+    // Time-decayed average: the longer since the previous sample, the less it counts
+    double ewma = sampleMs;
+    if (upstream.lastSample != Upstream::Clock::time_point()) {
+        double elapsedMs = std::chrono::duration<double, std::milli>(now - upstream.lastSample).count();
+        double decayMs = std::max<double>(1.0, config.ewmaDecay.count());
+        double weight = std::exp(-elapsedMs / decayMs);
+        ewma = upstream.ewmaMs.load(std::memory_order_relaxed) * weight + sampleMs * (1.0 - weight);
+    }
+    upstream.lastSample = now;
+    upstream.ewmaMs.store(ewma, std::memory_order_relaxed);
+
+    if (success) {
+        upstream.consecutiveFailures = 0;
+        upstream.ejections = 0;
+        return;
+    }
+    upstream.failures.fetch_add(1, std::memory_order_relaxed);
+    if (++upstream.consecutiveFailures < config.maxFailures || upstream.ejected(now)) {
+        return;
+    }
+
+    size_t ejectedNow = std::count_if(upstreams.begin(), upstreams.end(),
+                                      [now](const std::unique_ptr<Upstream>& member) { return member->ejected(now); });
+    if ((ejectedNow + 1) * 100 > upstreams.size() * static_cast<size_t>(std::max(0, config.maxEjectedPercent)) ||
+        ejectedNow + 1 >= upstreams.size()) {
+        return;   // keep the rest of the group in rotation even if it is unhealthy
+    }
+
+    std::chrono::milliseconds period = std::min(config.baseEjection * (upstream.ejections + 1), config.maxEjection);
+    upstream.ejectedUntil.store((now + period).time_since_epoch().count(), std::memory_order_relaxed);
+    upstream.ejections++;
+    upstream.consecutiveFailures = 0;
+    logError("Backend ejected for " + std::to_string(period.count()) + " ms", upstream.key);
+}
+
+// Function to move the latency percentile estimate toward one sample: up by
+// p x step when the sample is above it, down by (1 - p) x step otherwise, so it
+// settles where a fraction p of samples falls below. Relative steps make it
+// converge alike for microsecond and second latencies; large ones while the
+// first samples come in let it find the right scale quickly.
+void UpstreamGroup::observeLatency(double latencyMs) {
+    int seen = latencySamples.load(std::memory_order_relaxed);
+    if (seen < config.hedgeMinSamples) {
+        seen = latencySamples.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+    double step = std::max(0.02, 1.0 / std::max(seen, 1));
+    double percentile = std::clamp(config.hedgePercentile, 0.0, 1.0);
+    double estimate = latencyQuantileMs.load(std::memory_order_relaxed);
+    double next = estimate <= 0 ? latencyMs
+                : latencyMs > estimate ? estimate * (1 + step * percentile)
+                : estimate * (1 - step * (1 - percentile));
+    // Losing the race to another sample only skips this step
+    latencyQuantileMs.compare_exchange_strong(estimate, next, std::memory_order_relaxed);
+}
+
+std::vector<UpstreamStats> UpstreamGroup::stats() const {
+    Upstream::Clock::time_point now = Upstream::Clock::now();
+    std::vector<UpstreamStats> result;
+    for (const std::unique_ptr<Upstream>& upstream : upstreams) {
+        result.push_back(UpstreamStats{upstream->key,
+                                       upstream->outstanding.load(std::memory_order_relaxed),
+                                       upstream->ewmaMs.load(std::memory_order_relaxed),
+                                       upstream->requests.load(std::memory_order_relaxed),
+                                       upstream->failures.load(std::memory_order_relaxed),
+                                       upstream->ejected(now)});
+    }
+    return result;
+}
+
+UpstreamGroupStats UpstreamGroup::groupStats() const {
+    return UpstreamGroupStats{retries.load(std::memory_order_relaxed),
+                              retriesDenied.load(std::memory_order_relaxed),
+                              hedges.load(std::memory_order_relaxed),
+                              hedgesWon.load(std::memory_order_relaxed),
+                              latencyQuantileMs.load(std::memory_order_relaxed)};
+}
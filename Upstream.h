@@ -0,0 +1,198 @@
+#ifndef UPSTREAM_H
+#define UPSTREAM_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// How a request picks the backend that serves it
+enum class BalancePolicy {
+    RoundRobin,
+    LeastOutstanding,   // fewest requests in flight
+    TwoChoicesEwma      // better of two random backends by latency EWMA x (in flight + 1)
+};
+
+struct UpstreamServer {
+    std::string host;
+    uint16_t port = 80;
+};
+
+struct UpstreamConfig {
+    std::string name;   // identity of the group in cache keys; defaults to the first server
+    std::vector<UpstreamServer> servers{{"jsonplaceholder.typicode.com", 80}};
+    BalancePolicy policy = BalancePolicy::TwoChoicesEwma;
+    std::chrono::milliseconds ewmaDecay{10000};   // time for an old latency sample to fade to 1/e
+
+    // Passive health: consecutive failed requests eject a backend for a while
+    int maxFailures = 5;
+    std::chrono::milliseconds slowResponse{10000};    // slower responses count as failures
+    std::chrono::milliseconds baseEjection{10000};    // grows with each ejection in a row
+    std::chrono::milliseconds maxEjection{300000};
+    int maxEjectedPercent = 50;                       // never eject more of the group than this
+
+    // Deadlines of one request to the group; 0 disables one
+    std::chrono::milliseconds connectTimeout{2000};
+    std::chrono::milliseconds firstByteTimeout{15000};   // from the request being sent
+    std::chrono::milliseconds totalTimeout{60000};       // the whole exchange, retries included
+
+    // Idempotent requests that fail before anything reached the client are
+    // retried on another backend while retries stay under retryBudget of all
+    // requests, plus a floor of minRetriesPerSecond
+    int maxRetries = 2;
+    double retryBudget = 0.2;
+    int minRetriesPerSecond = 10;
+
+    // Hedging: an idempotent request still unanswered at the group's
+    // hedgePercentile latency is also sent to another backend; the first to
+    // answer is used and the other cancelled. Hedges draw on the retry budget.
+    bool hedging = false;
+    double hedgePercentile = 0.95;
+    std::chrono::milliseconds minHedgeDelay{5};
+    int hedgeMinSamples = 100;   // latencies seen before the percentile is trusted
+};
+
+struct UpstreamStats {
+    std::string key;
+    int outstanding;
+    double ewmaMs;
+    uint64_t requests;
+    uint64_t failures;
+    bool ejected;
+};
+
+struct UpstreamGroupStats {
+    uint64_t retries;
+    uint64_t retriesDenied;   // over budget
+    uint64_t hedges;
+    uint64_t hedgesWon;       // the hedge answered first
+    double percentileMs;      // estimated hedgePercentile latency
+};
+
+// One backend of the group and the load and health it has shown
+class Upstream {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit Upstream(UpstreamServer server);
+
+    const std::string host;
+    const uint16_t port;
+    const std::string key;   // "host:port"; also names its BackendPool connections
+
+private:
+    friend class UpstreamGroup;
+    friend class UpstreamRequest;
+
+    std::atomic<int> outstanding;
+    std::atomic<double> ewmaMs;
+    std::atomic<int64_t> ejectedUntil;   // Clock ticks; 0 when in rotation
+    std::atomic<uint64_t> requests;
+    std::atomic<uint64_t> failures;
+
+    std::mutex healthMutex;              // Serializes outcome bookkeeping
+    Clock::time_point lastSample;
+    int consecutiveFailures;
+    int ejections;                       // In a row, without a success in between
+
+    bool ejected(Clock::time_point now) const;
+};
+
+class UpstreamGroup;
+
+// A request in flight to one backend. It reports the outcome when finished;
+// dropping it unfinished (the client went away, the pool was exhausted)
+// only ends it.
+class UpstreamRequest {
+public:
+    UpstreamRequest() = default;
+    UpstreamRequest(UpstreamGroup& group, Upstream& upstream);
+    UpstreamRequest(UpstreamRequest&& other) noexcept;
+    UpstreamRequest& operator=(UpstreamRequest&& other) noexcept;
+    ~UpstreamRequest();
+
+    explicit operator bool() const { return upstream != nullptr; }
+    Upstream& operator*() const { return *upstream; }
+    Upstream* operator->() const { return upstream; }
+
+    // The backend answered; gateway errors (502-504) still count against it
+    void finish(int statusCode);
+
+    // The backend could not be reached or broke off
+    void fail();
+
+private:
+    UpstreamGroup* group = nullptr;
+    Upstream* upstream = nullptr;
+    Upstream::Clock::time_point startedAt;
+
+    void end(bool success);
+};
+
+// Backends serving the same origin. Requests are spread by the configured
+// policy over the backends in rotation; ones that keep failing or answer
+// slower than slowResponse are ejected for a growing period, but never more
+// than maxEjectedPercent of the group, and never all of it.
+class UpstreamGroup {
+public:
+    explicit UpstreamGroup(const UpstreamConfig& config = UpstreamConfig());
+
+    // Replace the backends; only before serving starts
+    void configure(const UpstreamConfig& config);
+
+    const std::string& name() const { return groupName; }
+    const std::vector<std::unique_ptr<Upstream>>& members() const { return upstreams; }
+
+    const UpstreamConfig& settings() const { return config; }
+
+    // Pick a backend for a request; retries and hedges pass the backend to
+    // stay away from, which is only chosen again when no other is in rotation
+    UpstreamRequest choose(const Upstream* avoid = nullptr);
+
+    // Take a token from the retry budget for a retry or hedge; false when spent
+    bool allowRetry();
+
+    // Wait before hedging a request; zero while hedging is off or too few
+    // latencies were seen
+    std::chrono::milliseconds hedgeDelay() const;
+
+    void countHedge(bool won);
+
+    std::vector<UpstreamStats> stats() const;
+    UpstreamGroupStats groupStats() const;
+
+private:
+    friend class UpstreamRequest;
+
+    UpstreamConfig config;
+    std::string groupName;
+    std::vector<std::unique_ptr<Upstream>> upstreams;
+    std::atomic<uint64_t> nextIndex;
+
+    // Retry budget in thousandths of a retry: requests deposit, retries withdraw
+    std::atomic<int64_t> retryTokens;
+    // Floor of minRetriesPerSecond, kept as the instant (Clock ticks) the reserve was empty
+    int64_t reserveTokenCost;
+    std::atomic<int64_t> reserveEmptyAt;
+
+    // Streaming estimate of the hedgePercentile latency
+    std::atomic<double> latencyQuantileMs;
+    std::atomic<int> latencySamples;
+
+    std::atomic<uint64_t> retries;
+    std::atomic<uint64_t> retriesDenied;
+    std::atomic<uint64_t> hedges;
+    std::atomic<uint64_t> hedgesWon;
+
+    bool available(const Upstream& upstream, Upstream::Clock::time_point now, const Upstream* avoid) const;
+    Upstream& pickRoundRobin(Upstream::Clock::time_point now, const Upstream* avoid);
+    Upstream& pickLeastOutstanding(Upstream::Clock::time_point now, const Upstream* avoid);
+    Upstream& pickTwoChoices(Upstream::Clock::time_point now, const Upstream* avoid);
+    void observeLatency(double latencyMs);
+    void record(Upstream& upstream, bool success, std::chrono::nanoseconds latency);
+};
+
+#endif // UPSTREAM_H
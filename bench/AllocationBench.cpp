@@ -0,0 +1,176 @@
+// Heap allocations and time per request for the steps that build request
+// scratch: parsing, the cache key, a cache hit, the backend request and a
+// coroutine frame. Each step is run with the request's arena (or the block
+// pool, for frames) and, where there is one, with the plain heap it replaced.
+//
+// usage: AllocationBench [requests]
+#include "Coroutine.h"
+#include "HttpCache.h"
+#include "HttpParser.h"
+#include "RequestArena.h"
+#include "Server.h"
+#include "Upstream.h"
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <string_view>
+
+// Every operator new in the process, so a step that allocates shows up
+static std::atomic<uint64_t> allocations{0};
+
+void* operator new(size_t bytes) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(bytes)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t bytes, std::align_val_t alignment) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    size_t align = static_cast<size_t>(alignment);
+    if (void* memory = std::aligned_alloc(align, (bytes + align - 1) / align * align)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { std::free(memory); }
+
+static constexpr std::string_view clientRequest =
+    "GET /posts/1?include=comments HTTP/1.1\r\n"
+    "Host: localhost:8080\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:128.0) Gecko/20100101 Firefox/128.0\r\n"
+    "Accept: application/json\r\n"
+    "Accept-Encoding: gzip, deflate\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n";
+
+static constexpr std::string_view backendResponse =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: application/json\r\n"
+    "Cache-Control: max-age=3600\r\n"
+    "Content-Length: 2\r\n"
+    "\r\n"
+    "{}";
+
+struct Result {
+    double allocationsPerRequest;
+    double nanosecondsPerRequest;
+};
+
+// Function to run `step` once to warm up, then `requests` times counting allocations
+template <typename Step>
+static Result measure(size_t requests, Step step) {
+    step();
+    uint64_t allocationsBefore = allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < requests; ++i) {
+        step();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint64_t allocated = allocations.load() - allocationsBefore;
+    return {static_cast<double>(allocated) / requests, seconds * 1e9 / requests};
+}
+
+// Lazily started coroutine like Async, but with frames from the heap, as before the block pool
+struct HeapFrame {
+    struct promise_type {
+        HeapFrame get_return_object() { return {std::coroutine_handle<promise_type>::from_promise(*this)}; }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_value(int) {}
+        void unhandled_exception() { std::terminate(); }
+    };
+    std::coroutine_handle<promise_type> handle;
+};
+
+// A frame holding a socket buffer the way the coroutine connection handlers do
+static HeapFrame receiveOnHeap(int fill) {
+    volatile char buffer[8192];
+    buffer[0] = static_cast<char>(fill);
+    co_return buffer[0];
+}
+
+static Async<int> receiveOnPool(int fill) {
+    volatile char buffer[8192];
+    buffer[0] = static_cast<char>(fill);
+    co_return buffer[0];
+}
+
+static void print(const char* step, Result result) {
+    std::printf("%-34s %8.2f allocs %10.1f ns\n", step, result.allocationsPerRequest, result.nanosecondsPerRequest);
+}
+
+int main(int argc, char* argv[]) {
+    size_t requests = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    if (requests == 0) {
+        requests = 1;
+    }
+
+    HttpRequestParser parser;
+    RequestInfo request;
+    RequestArena arena;
+    Upstream upstream(UpstreamServer{"jsonplaceholder.typicode.com", 80});
+
+    parser.parse(clientRequest, request);
+    HttpCache cache(HttpCacheConfig{});
+    cache.store(request, HttpCache::primaryKey(request.method, upstream.key, request.path),
+                std::string(backendResponse));
+
+    std::printf("%zu requests, %zu byte request head\n", requests, clientRequest.size());
+
+    print("parse request", measure(requests, [&]() {
+        parser.reset();
+        parser.parse(clientRequest, request);
+    }));
+
+    print("cache key, heap", measure(requests, [&]() {
+        std::pmr::string key = HttpCache::primaryKey(request.method, upstream.key, request.path);
+    }));
+    print("cache key, arena", measure(requests, [&]() {
+        {
+            std::pmr::string key = HttpCache::primaryKey(request.method, upstream.key, request.path,
+                                                         arena.resource());
+        }
+        arena.reset();
+    }));
+
+    print("cache hit (key in arena)", measure(requests, [&]() {
+        {
+            std::pmr::string key = HttpCache::primaryKey(request.method, upstream.key, request.path,
+                                                         arena.resource());
+            HttpCache::Lookup hit = cache.lookup(request, key);
+            if (!hit.response) {
+                std::abort();
+            }
+        }
+        arena.reset();
+    }));
+
+    print("backend request, heap", measure(requests, [&]() {
+        std::pmr::string backendRequest = buildBackendRequest(upstream, request);
+    }));
+    print("backend request, arena", measure(requests, [&]() {
+        {
+            std::pmr::string backendRequest = buildBackendRequest(upstream, request, arena.resource());
+        }
+        arena.reset();
+    }));
+
+    print("coroutine frame, heap", measure(requests, [&]() {
+        HeapFrame frame = receiveOnHeap(1);
+        frame.handle.resume();
+        frame.handle.destroy();
+    }));
+    print("coroutine frame, block pool", measure(requests, [&]() { receiveOnPool(1).detach(); }));
+    return 0;
+}
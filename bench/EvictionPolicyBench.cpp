@@ -0,0 +1,91 @@
+// Hit ratio of the LRU and W-TinyLFU eviction policies on synthetic traces:
+// a Zipf-popular key set alone, and the same keys interleaved with a crawler
+// walking unique paths that are never requested again.
+//
+// usage: EvictionPolicyBench [capacity] [requests]
+#include "Lrucache.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+static constexpr size_t popularKeys = 20000;
+
+struct TraceResult {
+    double hitRatio;          // over every request
+    double popularHitRatio;   // over requests for the popular keys only
+};
+
+// Function to replay a trace through a cache, filling it on every miss
+static TraceResult replay(EvictionPolicy policy, size_t capacity, const std::vector<std::string>& trace,
+                          const std::vector<bool>& popular) {
+    CacheLimits limits;
+    limits.maxEntries = capacity;
+    LRUCache<std::string, std::string> cache(limits, policy);
+
+    size_t hits = 0, popularRequests = 0, popularHits = 0;
+    std::string value;
+    for (size_t i = 0; i < trace.size(); ++i) {
+        bool hit = cache.get(trace[i], value);
+        if (!hit) {
+            cache.put(trace[i], "response");
+        }
+        hits += hit;
+        popularRequests += popular[i];
+        popularHits += hit && popular[i];
+    }
+    return {100.0 * hits / trace.size(), popularRequests ? 100.0 * popularHits / popularRequests : 0.0};
+}
+
+// Function to build a trace; scanShare of the requests go to unique paths
+static void buildTrace(size_t requests, double scanShare, std::vector<std::string>& trace,
+                       std::vector<bool>& popular) {
+    // Zipf(0.9) over the popular keys, drawn through its cumulative distribution
+    std::vector<double> cumulative(popularKeys);
+    double sum = 0;
+    for (size_t rank = 0; rank < popularKeys; ++rank) {
+        sum += 1.0 / std::pow(rank + 1.0, 0.9);
+        cumulative[rank] = sum;
+    }
+
+    std::mt19937_64 random(42);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    size_t scanned = 0;
+    trace.clear();
+    popular.clear();
+    for (size_t i = 0; i < requests; ++i) {
+        if (uniform(random) < scanShare) {
+            trace.push_back("/crawl/" + std::to_string(scanned++));
+            popular.push_back(false);
+        } else {
+            size_t rank = std::lower_bound(cumulative.begin(), cumulative.end(), uniform(random) * sum) -
+                          cumulative.begin();
+            trace.push_back("/posts/" + std::to_string(rank));
+            popular.push_back(true);
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t capacity = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000;
+    size_t requests = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000000;
+
+    std::printf("capacity %zu entries, %zu requests, %zu popular keys\n", capacity, requests, popularKeys);
+    std::printf("%-22s %14s %14s %20s\n", "trace", "LRU hit %", "W-TinyLFU hit %", "popular hit % (LRU/W)");
+    std::vector<std::string> trace;
+    std::vector<bool> popular;
+    for (double scanShare : {0.0, 1.0 / 3, 2.0 / 3}) {
+        buildTrace(requests, scanShare, trace, popular);
+        TraceResult lru = replay(EvictionPolicy::LRU, capacity, trace, popular);
+        TraceResult tinyLfu = replay(EvictionPolicy::WTinyLFU, capacity, trace, popular);
+        char name[32];
+        std::snprintf(name, sizeof(name), "zipf + %.0f%% scan", scanShare * 100);
+        std::printf("%-22s %14.1f %14.1f %12.1f / %5.1f\n", name, lru.hitRatio, tinyLfu.hitRatio,
+                    lru.popularHitRatio, tinyLfu.popularHitRatio);
+    }
+    return 0;
+}
@@ -0,0 +1,75 @@
+// Throughput of ShardedLRUCache under concurrent lookups, by shard count.
+// One shard is the old single-mutex cache; more shards should scale with threads.
+//
+// usage: LruShardingBench [threads] [operations per thread]
+#include "Lrucache.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+static constexpr size_t keyCount = 10000;
+static constexpr size_t cacheCapacity = 8192;   // a little under the key set, so puts evict
+
+// Function to step a thread's xorshift generator
+static uint64_t nextRandom(uint64_t& state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// Function to run the mixed workload on one cache and return million operations per second
+static double run(size_t shardCount, int threads, size_t operations, const std::vector<std::string>& keys) {
+    ShardedLRUCache<std::string, std::string> cache(cacheCapacity, shardCount);
+    std::string value(512, 'x');
+    for (size_t i = 0; i < cacheCapacity; ++i) {
+        cache.put(keys[i], value);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&cache, &keys, &value, operations, t]() {
+            uint64_t state = 0x9E3779B97F4A7C15ull * (t + 1);
+            std::string found;
+            for (size_t i = 0; i < operations; ++i) {
+                uint64_t random = nextRandom(state);
+                // Half the lookups go to the hottest 1% of keys, like popular pages
+                size_t key = (random & 1) ? (random >> 8) % (keyCount / 100) : (random >> 8) % keyCount;
+                if ((random >> 4) % 10 == 0) {
+                    cache.put(keys[key], value);
+                } else {
+                    cache.get(keys[key], found);
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return threads * operations / seconds / 1e6;
+}
+
+int main(int argc, char* argv[]) {
+    int threads = argc > 1 ? std::atoi(argv[1]) : static_cast<int>(std::thread::hardware_concurrency());
+    size_t operations = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000000;
+    if (threads <= 0) {
+        threads = 4;
+    }
+
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < keyCount; ++i) {
+        keys.push_back("GET localhost:80/posts/" + std::to_string(i));
+    }
+
+    std::printf("%d threads, %zu operations each, 90%% get / 10%% put\n", threads, operations);
+    for (size_t shards : {1, 4, 16, 64}) {
+        std::printf("%3zu shards: %6.2f M ops/s\n", shards, run(shards, threads, operations, keys));
+    }
+    return 0;
+}
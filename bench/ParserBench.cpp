@@ -0,0 +1,210 @@
+// Time per request of HttpRequestParser against the parsing it replaced:
+// findRequestLength rescanning the buffer after every read, then a copy of
+// the request split up by strtok in parseRequest. Requests arrive in one
+// buffer, split over several reads, or pipelined several to a buffer.
+//
+// usage: ParserBench [requests]
+#include "HttpParser.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+// Local copy of the request framing and parsing before HttpRequestParser
+namespace baseline {
+
+struct RequestInfo {
+    std::string method;
+    std::string path;
+    std::string version;
+};
+
+// Strip leading and trailing spaces/tabs
+static std::string_view trim(std::string_view value) {
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) value.remove_suffix(1);
+    return value;
+}
+
+// Case-insensitive ASCII comparison
+static bool iequals(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Case-insensitive substring search
+static bool icontains(std::string_view haystack, std::string_view needle) {
+    if (needle.size() > haystack.size()) return false;
+    for (size_t i = 0; i + needle.size() <= haystack.size(); ++i) {
+        if (iequals(haystack.substr(i, needle.size()), needle)) return true;
+    }
+    return false;
+}
+
+// Locate the end of the first request so pipelined requests can be split apart
+static size_t findRequestLength(std::string_view buffer, bool& keepAlive) {
+    size_t headEnd = buffer.find("\r\n\r\n");
+    if (headEnd == std::string_view::npos) {
+        return 0;
+    }
+    headEnd += 4;
+
+    std::string_view head = buffer.substr(0, headEnd - 2);
+    size_t lineEnd = head.find("\r\n");
+    std::string_view requestLine = head.substr(0, lineEnd);
+    bool http11 = requestLine.size() >= 8 && requestLine.substr(requestLine.size() - 8) == "HTTP/1.1";
+
+    size_t bodyLength = 0;
+    bool connectionClose = false;
+    bool connectionKeepAlive = false;
+    bool chunkedBody = false;
+
+    size_t pos = lineEnd + 2;
+    while (pos < head.size()) {
+        size_t next = head.find("\r\n", pos);
+        std::string_view line = head.substr(pos, next - pos);
+        pos = next + 2;
+
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos) {
+            continue;
+        }
+        std::string_view name = trim(line.substr(0, colon));
+        std::string_view value = trim(line.substr(colon + 1));
+
+        if (iequals(name, "Content-Length")) {
+            std::from_chars(value.data(), value.data() + value.size(), bodyLength);
+        } else if (iequals(name, "Transfer-Encoding")) {
+            chunkedBody = icontains(value, "chunked");
+        } else if (iequals(name, "Connection")) {
+            connectionClose = icontains(value, "close");
+            connectionKeepAlive = icontains(value, "keep-alive");
+        }
+    }
+
+    if (buffer.size() - headEnd < bodyLength) {
+        return 0;
+    }
+
+    keepAlive = !chunkedBody && (http11 ? !connectionClose : connectionKeepAlive);
+    return headEnd + bodyLength;
+}
+
+// Function to parse the HTTP request
+static RequestInfo parseRequest(char* buffer) {
+    RequestInfo reqInfo;
+    char* method = strtok(buffer, " ");
+    char* path = strtok(NULL, " ");
+    char* version = strtok(NULL, "\r\n");
+
+    if (!method || !path || !version) {
+        return reqInfo;
+    }
+
+    reqInfo.method = method;
+    reqInfo.path = path;
+    reqInfo.version = version;
+    return reqInfo;
+}
+
+} // namespace baseline
+
+static constexpr std::string_view clientRequest =
+    "GET /posts/1?include=comments HTTP/1.1\r\n"
+    "Host: localhost:8080\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:128.0) Gecko/20100101 Firefox/128.0\r\n"
+    "Accept: application/json\r\n"
+    "Accept-Encoding: gzip, deflate\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n";
+
+static constexpr size_t readSize = 64;       // bytes per read when a request is split
+static constexpr size_t pipelineDepth = 8;   // requests per buffer when pipelined
+
+// Checked after the runs, so the parsed fields are not optimized away
+static size_t parsedBytes = 0;
+
+// Function to frame and parse every request in pending the way the old worker loop did
+static void parseBaseline(std::string& pending) {
+    bool keepAlive = false;
+    while (size_t requestLength = baseline::findRequestLength(pending, keepAlive)) {
+        std::string request = pending.substr(0, requestLength);
+        pending.erase(0, requestLength);
+        baseline::RequestInfo reqInfo = baseline::parseRequest(request.data());
+        parsedBytes += reqInfo.method.size() + reqInfo.path.size() + keepAlive;
+    }
+}
+
+// Function to parse every complete request in pending with HttpRequestParser; like
+// the parser, reqInfo belongs to the connection and is reused between requests
+static void parseCurrent(HttpRequestParser& parser, RequestInfo& reqInfo, std::string& pending) {
+    while (parser.parse(pending, reqInfo) == HttpRequestParser::Result::Complete) {
+        parsedBytes += reqInfo.method.size() + reqInfo.path.size() + reqInfo.keepAlive;
+        pending.erase(0, reqInfo.length);
+        parser.reset();
+    }
+}
+
+// Function to deliver `input` in reads of `chunk` bytes, calling `parse` after each, and return ns per request
+template <typename Parse>
+static double run(size_t requests, std::string_view input, size_t chunk, size_t requestsPerInput, Parse parse) {
+    std::string pending;
+    pending.reserve(input.size());
+    size_t rounds = requests / requestsPerInput;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < rounds; ++round) {
+        for (size_t offset = 0; offset < input.size(); offset += chunk) {
+            pending.append(input.substr(offset, chunk));
+            parse(pending);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return seconds * 1e9 / (rounds * requestsPerInput);
+}
+
+int main(int argc, char* argv[]) {
+    size_t requests = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    requests = std::max(requests - requests % pipelineDepth, pipelineDepth);
+
+    std::string pipelined;
+    for (size_t i = 0; i < pipelineDepth; ++i) {
+        pipelined.append(clientRequest);
+    }
+
+    struct Scenario {
+        const char* name;
+        std::string_view input;
+        size_t chunk;
+        size_t requestsPerInput;
+    };
+    const Scenario scenarios[] = {
+        {"one buffer", clientRequest, clientRequest.size(), 1},
+        {"split", clientRequest, readSize, 1},
+        {"pipelined", pipelined, pipelined.size(), pipelineDepth},
+    };
+
+    std::printf("%zu requests, %zu byte request head, %zu byte reads when split, %zu per pipelined buffer\n",
+                requests, clientRequest.size(), readSize, pipelineDepth);
+    HttpRequestParser parser;
+    RequestInfo reqInfo;
+    for (const Scenario& scenario : scenarios) {
+        double old = run(requests, scenario.input, scenario.chunk, scenario.requestsPerInput,
+                         [](std::string& pending) { parseBaseline(pending); });
+        double current = run(requests, scenario.input, scenario.chunk, scenario.requestsPerInput,
+                             [&](std::string& pending) { parseCurrent(parser, reqInfo, pending); });
+        std::printf("%-12s strtok %7.1f ns/request   HttpRequestParser %7.1f ns/request   (%.1fx)\n",
+                    scenario.name, old, current, old / current);
+    }
+    return parsedBytes == 0;
+}
@@ -0,0 +1,65 @@
+// Decisions per second of AdvancedRateLimiter with several threads checking
+// requests from many clients at once. One shard puts every client behind a
+// single lock, as before the table was sharded; buckets are large enough
+// that every request is allowed, so only the bookkeeping is measured.
+//
+// usage: RateLimiterBench [threads] [requests per thread]
+#include "TokenBucket.h"
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+static constexpr size_t clientCount = 4096;
+
+// Function to run `check` for every request on every thread and return million decisions per second
+template <typename Check>
+static double run(int threads, size_t requests, Check check) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&check, requests, t]() {
+            for (size_t i = 0; i < requests; ++i) {
+                check((i * 7 + t) % clientCount);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return threads * requests / seconds / 1e6;
+}
+
+int main(int argc, char* argv[]) {
+    int threads = argc > 1 ? std::atoi(argv[1]) : static_cast<int>(std::thread::hardware_concurrency());
+    size_t requests = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 400000;
+    if (threads <= 0) {
+        threads = 4;
+    }
+
+    std::vector<struct sockaddr_in> addresses(clientCount);
+    std::vector<std::string> addressStrings(clientCount);
+    for (size_t i = 0; i < clientCount; ++i) {
+        addresses[i].sin_family = AF_INET;
+        addresses[i].sin_addr.s_addr = htonl(0x0a000000 + static_cast<uint32_t>(i));
+        char text[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &addresses[i].sin_addr, text, sizeof(text));
+        addressStrings[i] = text;
+    }
+
+    std::printf("%d threads, %zu requests each, %zu clients\n", threads, requests, clientCount);
+    for (size_t shards : {1, 64}) {
+        AdvancedRateLimiter binary(1 << 30, 1e9, 1 << 30, 1e9, std::chrono::seconds(60), shards);
+        double binaryRate = run(threads, requests, [&](size_t client) { binary.allowRequest(addresses[client]); });
+
+        AdvancedRateLimiter text(1 << 30, 1e9, 1 << 30, 1e9, std::chrono::seconds(60), shards);
+        double textRate = run(threads, requests, [&](size_t client) { text.allowRequest(addressStrings[client]); });
+
+        std::printf("%2zu shards: sockaddr %6.2f M/s   string %6.2f M/s\n", shards, binaryRate, textRate);
+    }
+    return 0;
+}
@@ -0,0 +1,157 @@
+// Task throughput of the work-stealing ThreadPool, and heap allocations per
+// submitted task, for tasks submitted from outside the pool (as the acceptor
+// does) and from its own workers (onto their deques). The mutex-guarded
+// std::queue of std::function it replaced runs alongside as the baseline.
+//
+// usage: ThreadPoolBench [tasks]
+#include "ThreadPool.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// Every operator new in the process, so a submission that allocates shows up
+static std::atomic<uint64_t> allocations{0};
+
+void* operator new(size_t bytes) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(bytes)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+
+// Local copy of the pool before work stealing: one queue behind one mutex
+namespace baseline {
+
+class ThreadPool {
+public:
+    explicit ThreadPool(int numThreads) : isShutdown(false) {
+        for (int i = 0; i < numThreads; ++i) {
+            threads.emplace_back([this]() {
+                while (true) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lock(queueMutex);
+                        taskAvailable.wait(lock, [this]() { return isShutdown || !taskQueue.empty(); });
+                        if (isShutdown && taskQueue.empty()) {
+                            return;
+                        }
+                        task = std::move(taskQueue.front());
+                        taskQueue.pop();
+                    }
+                    try {
+                        task();
+                    } catch (const std::exception& e) {
+                        std::cerr << "Task exception: " << e.what() << std::endl;
+                    }
+                }
+            });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            isShutdown = true;
+        }
+        taskAvailable.notify_all();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    void addTask(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            if (isShutdown) {
+                throw std::runtime_error("Cannot add tasks to a shutting down ThreadPool.");
+            }
+            taskQueue.push(std::move(task));
+        }
+        taskAvailable.notify_one();
+    }
+
+private:
+    std::queue<std::function<void()>> taskQueue;
+    std::mutex queueMutex;
+    std::condition_variable taskAvailable;
+    std::vector<std::thread> threads;
+    bool isShutdown;
+};
+
+} // namespace baseline
+
+struct Result {
+    double tasksPerSecond;
+    double allocationsPerTask;
+};
+
+// Function to run `tasks` small tasks on a new pool, submitted from outside
+// or, when nested, by tasks already running on it in batches of 64
+template <typename Pool, typename... PoolArgs>
+static Result run(size_t tasks, bool nested, PoolArgs... poolArgs) {
+    std::atomic<size_t> done{0};
+    Pool pool(poolArgs...);
+
+    // Warm up, so the pool's own start-up allocations are not counted
+    pool.addTask([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+    while (done.load() < 1) {
+        std::this_thread::yield();
+    }
+    done = 0;
+
+    uint64_t allocationsBefore = allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    if (nested) {
+        constexpr size_t batch = 64;
+        for (size_t submitted = 0; submitted < tasks; submitted += batch) {
+            pool.addTask([&pool, &done, batch]() {
+                for (size_t i = 0; i < batch; ++i) {
+                    pool.addTask([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+                }
+            });
+        }
+    } else {
+        for (size_t i = 0; i < tasks; ++i) {
+            pool.addTask([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+        }
+    }
+    while (done.load(std::memory_order_relaxed) < tasks) {
+        std::this_thread::yield();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint64_t allocated = allocations.load() - allocationsBefore;
+    return {tasks / seconds, static_cast<double>(allocated) / tasks};
+}
+
+int main(int argc, char* argv[]) {
+    size_t tasks = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    tasks -= tasks % 64;
+
+    std::printf("%zu tasks\n", tasks);
+    for (int threads : {1, 2, 4}) {
+        for (bool nested : {false, true}) {
+            Result queue = run<baseline::ThreadPool>(tasks, nested, threads);
+            Result stealing = run<ThreadPool>(tasks, nested, threads, size_t{4096});
+            std::printf("%d workers, %-12s mutex queue %6.2f M tasks/s (%.3f allocs/task)   "
+                        "work stealing %6.2f M tasks/s (%.3f allocs/task)\n",
+                        threads, nested ? "from workers" : "external",
+                        queue.tasksPerSecond / 1e6, queue.allocationsPerTask,
+                        stealing.tasksPerSecond / 1e6, stealing.allocationsPerTask);
+        }
+    }
+    return 0;
+}
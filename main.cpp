@@ -1,9 +1,73 @@
 #include "Server.h"
 #include<iostream>
+#include <string>
 
-int main() {
-    int port = 8080;
-    std::cout << "[DEBUG] Starting server on port " << port << "..." << std::endl;
-    startServer(port);
+int main(int argc, char* argv[]) {
+    ServerConfig config;
+    config.port = 8080;
+
+    // --backend=host[:port] may repeat; the first one replaces the default backend
+    bool defaultBackend = true;
+
+    // --io=threadpool falls back to the blocking accept + ThreadPool model; --io=coroutine
+    // serves each connection with a coroutine on the epoll loops, and --io=uring does
+    // the same through io_uring where the kernel supports it
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--io=threadpool") {
+            config.ioModel = IoModel::ThreadPool;
+        } else if (arg == "--io=epoll") {
+            config.ioModel = IoModel::EventLoop;
+        } else if (arg == "--io=coroutine") {
+            config.ioModel = IoModel::Coroutine;
+        } else if (arg == "--io=uring") {
+            config.ioModel = IoModel::IoUring;
+        } else if (arg == "--reuseport") {
+            config.shardedListeners = true;
+        } else if (arg == "--pin-cpus") {
+            config.pinWorkers = true;
+        } else if (arg.rfind("--workers=", 0) == 0) {
+            config.workerThreads = std::stoi(arg.substr(10));
+        } else if (arg.rfind("--queue=", 0) == 0) {
+            config.loadShedding.queueCapacity = std::stoul(arg.substr(8));
+        } else if (arg == "--shed=block") {
+            config.loadShedding.policy = ShedPolicy::Block;
+        } else if (arg == "--shed=reject") {
+            config.loadShedding.policy = ShedPolicy::RejectNew;
+        } else if (arg == "--shed=drop-oldest") {
+            config.loadShedding.policy = ShedPolicy::DropOldest;
+        } else if (arg == "--shed=codel") {
+            config.loadShedding.policy = ShedPolicy::CoDel;
+        } else if (arg.rfind("--backend=", 0) == 0) {
+            std::string backend = arg.substr(10);
+            UpstreamServer server{backend, 80};
+            size_t colon = backend.rfind(':');
+            if (colon != std::string::npos && backend.find(':') == colon) {
+                server.host = backend.substr(0, colon);
+                server.port = static_cast<uint16_t>(std::stoi(backend.substr(colon + 1)));
+            }
+            if (defaultBackend) {
+                config.upstream.servers.clear();
+                defaultBackend = false;
+            }
+            config.upstream.servers.push_back(server);
+        } else if (arg == "--balance=round-robin") {
+            config.upstream.policy = BalancePolicy::RoundRobin;
+        } else if (arg == "--balance=least-outstanding") {
+            config.upstream.policy = BalancePolicy::LeastOutstanding;
+        } else if (arg == "--balance=p2c") {
+            config.upstream.policy = BalancePolicy::TwoChoicesEwma;
+        } else if (arg == "--hedge") {
+            config.upstream.hedging = true;
+        } else if (arg.rfind("--first-byte-timeout=", 0) == 0) {
+            config.upstream.firstByteTimeout = std::chrono::milliseconds(std::stoi(arg.substr(21)));
+        } else if (arg.rfind("--access-log-sample=", 0) == 0) {
+            // Keep one in N successful requests in the access log
+            config.accessLog.sampleEvery = static_cast<unsigned>(std::stoul(arg.substr(20)));
+        }
+    }
+
+    std::cout << "[DEBUG] Starting server on port " << config.port << "..." << std::endl;
+    startServer(config);
     return 0;
 }